@@ -0,0 +1,1218 @@
+/*
+ * core_bench.cpp
+ *
+ *  Created on: 15 okt. 2026
+ *      Author: mikaelr
+ */
+
+#include "StateChart.h"
+
+#include <benchmark/benchmark.h>
+
+#include <initializer_list>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * Cost of the statechart core: event dispatch, transitions as a function
+ * of chart depth and width, bubbling with and without the dispatch cache,
+ * orthogonal regions, history, local transitions, transition payloads,
+ * choices, parent access, active state queries, queue throughput, event
+ * types, restarting an FSM and the memory used by each instance.
+ *
+ * Run 'make bench-json' to get the results as JSON for regression tracking.
+ */
+namespace
+{
+
+/**
+ * A small chart shaped like the one in fsm_test2.cpp. state1 is the parent
+ * of state2, state3 is a separate root.
+ */
+class TestStyleFsm;
+
+struct TestStyleDesc
+{
+    enum class StateId
+    {
+        state1,
+        state2,
+        state3,
+        stateIdNo
+    };
+    enum class Event
+    {
+        ignore,
+        toggle,
+    };
+    using Fsm = TestStyleFsm;
+    static void setupStates(FsmSetup<TestStyleDesc>& sc);
+};
+
+class TestStyleFsm : public FsmBase<TestStyleDesc>
+{
+  public:
+    long handled = 0;
+};
+
+template <TestStyleDesc::StateId id>
+class TestStyleState : public StateBase<TestStyleDesc, id>
+{
+  public:
+    using SId = TestStyleDesc::StateId;
+    using EId = TestStyleDesc::Event;
+    explicit TestStyleState(StateArgs& args)
+        : StateBase<TestStyleDesc, id>(args)
+    {
+    }
+
+    bool event(EId ev)
+    {
+        this->fsm().handled++;
+        if (ev == EId::toggle)
+            this->transition(id == SId::state2 ? SId::state3 : SId::state2);
+        return true;
+    }
+};
+
+void
+TestStyleDesc::setupStates(FsmSetup<TestStyleDesc>& sc)
+{
+    sc.addState<TestStyleState<StateId::state1>>();
+    sc.addState<TestStyleState<StateId::state2>,
+                TestStyleState<StateId::state1>>();
+    sc.addState<TestStyleState<StateId::state3>>();
+}
+
+void
+BM_PostEventNoTransition(benchmark::State& state)
+{
+    TestStyleFsm fsm;
+    fsm.setStartState(TestStyleDesc::StateId::state2);
+    for (auto _ : state)
+        fsm.postEvent(TestStyleDesc::Event::ignore);
+    benchmark::DoNotOptimize(fsm.handled);
+}
+BENCHMARK(BM_PostEventNoTransition);
+
+void
+BM_PostEventTransition(benchmark::State& state)
+{
+    TestStyleFsm fsm;
+    fsm.setStartState(TestStyleDesc::StateId::state2);
+    for (auto _ : state)
+        fsm.postEvent(TestStyleDesc::Event::toggle);
+    benchmark::DoNotOptimize(fsm.handled);
+}
+BENCHMARK(BM_PostEventTransition);
+
+/**
+ * Synthetic charts. State 0 is the root and the shape gives the parent of
+ * every other state. The event toggles between the 'first' and 'second'
+ * leaf.
+ */
+
+// Two chains of 'Depth' states below the root. Leaf to leaf transitions
+// exit and enter 'Depth' levels.
+template <int Depth>
+struct DeepShape
+{
+    static const constexpr int stateNo = 2 * Depth + 1;
+    static const constexpr int first = Depth;
+    static const constexpr int second = 2 * Depth;
+    static constexpr int parent(int id)
+    {
+        return id == 1 || id == Depth + 1 ? 0 : id - 1;
+    }
+};
+
+// 'Width' leaves directly below the root.
+template <int Width>
+struct WideShape
+{
+    static const constexpr int stateNo = Width + 1;
+    static const constexpr int first = 1;
+    static const constexpr int second = Width;
+    static constexpr int parent(int)
+    {
+        return 0;
+    }
+};
+
+template <class Shape>
+class ChartFsm;
+
+template <class Shape>
+struct ChartDesc
+{
+    enum class StateId
+    {
+        stateIdNo = Shape::stateNo
+    };
+    using Event = int;
+    using Fsm = ChartFsm<Shape>;
+    static void setupStates(FsmSetup<ChartDesc>& sc);
+};
+
+template <class Shape>
+class ChartFsm : public FsmBase<ChartDesc<Shape>>
+{
+  public:
+    using StateId = typename ChartDesc<Shape>::StateId;
+    void start()
+    {
+        this->setStartState(static_cast<StateId>(Shape::first));
+    }
+};
+
+template <class Shape, int id>
+class Node
+    : public StateBase<ChartDesc<Shape>,
+                       static_cast<typename ChartDesc<Shape>::StateId>(id)>
+{
+  public:
+    using Base = StateBase<ChartDesc<Shape>,
+                           static_cast<typename ChartDesc<Shape>::StateId>(id)>;
+    using StateId = typename ChartDesc<Shape>::StateId;
+    explicit Node(StateArgs& args) : Base(args) {}
+
+    bool event(int)
+    {
+        if (id != Shape::first && id != Shape::second)
+            return false;
+        this->transition(static_cast<StateId>(
+            id == Shape::first ? Shape::second : Shape::first));
+        return true;
+    }
+};
+
+// Add states 1 .. stateNo - 1. Parents have lower ids so they are added
+// first.
+template <class Shape, int... ids>
+void
+addNodes(FsmSetup<ChartDesc<Shape>>& sc, std::integer_sequence<int, ids...>)
+{
+    (void)std::initializer_list<int>{
+        (sc.template addState<Node<Shape, ids + 1>,
+                              Node<Shape, Shape::parent(ids + 1)>>(),
+         0)...};
+}
+
+template <class Shape>
+void
+ChartDesc<Shape>::setupStates(FsmSetup<ChartDesc>& sc)
+{
+    sc.template addState<Node<Shape, 0>>();
+    addNodes<Shape>(sc, std::make_integer_sequence<int, Shape::stateNo - 1>{});
+}
+
+template <class Shape>
+void
+BM_Transition(benchmark::State& state)
+{
+    ChartFsm<Shape> fsm;
+    fsm.start();
+    for (auto _ : state)
+        fsm.postEvent(0);
+    state.counters["states"] = Shape::stateNo;
+}
+BENCHMARK_TEMPLATE(BM_Transition, DeepShape<1>);
+BENCHMARK_TEMPLATE(BM_Transition, DeepShape<2>);
+BENCHMARK_TEMPLATE(BM_Transition, DeepShape<4>);
+BENCHMARK_TEMPLATE(BM_Transition, DeepShape<8>);
+BENCHMARK_TEMPLATE(BM_Transition, DeepShape<16>);
+BENCHMARK_TEMPLATE(BM_Transition, DeepShape<32>);
+// Above FsmStaticData::lcaTableLimit states, no common ancestor table.
+BENCHMARK_TEMPLATE(BM_Transition, DeepShape<160>);
+BENCHMARK_TEMPLATE(BM_Transition, WideShape<4>);
+BENCHMARK_TEMPLATE(BM_Transition, WideShape<64>);
+BENCHMARK_TEMPLATE(BM_Transition, WideShape<512>);
+
+/**
+ * Events bubbling from the leaf of a chain of 'Depth' states to the root,
+ * the only state handling them. With event ids the dispatch cache jumps
+ * straight to the root.
+ */
+template <class Desc>
+class BubbleFsm : public FsmBase<Desc>
+{
+  public:
+    long handled = 0;
+};
+
+template <class Desc, int id>
+class Link
+    : public StateBase<Desc, static_cast<typename Desc::StateId>(id)>
+{
+  public:
+    using Base = StateBase<Desc, static_cast<typename Desc::StateId>(id)>;
+    using HandledEvents = typename std::conditional<id == 0, EventSet<int, 0>,
+                                                    EventSet<int>>::type;
+
+    explicit Link(StateArgs& args) : Base(args) {}
+    bool event(int)
+    {
+        if (id != 0)
+            return false;
+        this->fsm().handled++;
+        return true;
+    }
+};
+
+template <class Desc, class Seq>
+struct ChainList;
+
+template <class Desc, int... ids>
+struct ChainList<Desc, std::integer_sequence<int, ids...>>
+{
+    using type = StateList<
+        StateDef<Link<Desc, ids>, Link<Desc, (ids > 0 ? ids - 1 : 0)>>...>;
+};
+
+struct BubbleIds
+{
+    static constexpr int eventIdNo = 1;
+    static int eventId(int)
+    {
+        return 0;
+    }
+};
+
+struct NoIds
+{
+};
+
+template <int Depth, bool cached>
+struct BubbleDesc : std::conditional<cached, BubbleIds, NoIds>::type
+{
+    enum class StateId
+    {
+        stateIdNo = Depth
+    };
+    using Event = int;
+    using Fsm = BubbleFsm<BubbleDesc>;
+    using States =
+        typename ChainList<BubbleDesc,
+                           std::make_integer_sequence<int, Depth>>::type;
+};
+
+template <int Depth, bool cached>
+void
+BM_Bubble(benchmark::State& state)
+{
+    using Desc = BubbleDesc<Depth, cached>;
+    BubbleFsm<Desc> fsm;
+    fsm.setStartState(static_cast<typename Desc::StateId>(Depth - 1));
+    for (auto _ : state)
+        fsm.postEvent(0);
+    benchmark::DoNotOptimize(fsm.handled);
+    state.counters["levels"] = Depth;
+}
+BENCHMARK_TEMPLATE(BM_Bubble, 2, false);
+BENCHMARK_TEMPLATE(BM_Bubble, 2, true);
+BENCHMARK_TEMPLATE(BM_Bubble, 8, false);
+BENCHMARK_TEMPLATE(BM_Bubble, 8, true);
+BENCHMARK_TEMPLATE(BM_Bubble, 32, false);
+BENCHMARK_TEMPLATE(BM_Bubble, 32, true);
+
+/**
+ * Two independent toggles. As two orthogonal regions of one FSM, and as
+ * two FSMs with the event posted to both by hand.
+ */
+template <class Desc>
+class ToggleFsm : public FsmBase<Desc>
+{
+  public:
+    long toggles = 0;
+};
+
+template <class Desc, int id, int next>
+class Toggle
+    : public StateBase<Desc, static_cast<typename Desc::StateId>(id)>
+{
+  public:
+    using Base = StateBase<Desc, static_cast<typename Desc::StateId>(id)>;
+    explicit Toggle(StateArgs& args) : Base(args) {}
+    bool event(int)
+    {
+        this->fsm().toggles++;
+        this->transition(static_cast<typename Desc::StateId>(next));
+        return true;
+    }
+};
+
+template <class Desc>
+class Both : public StateBase<Desc, Desc::StateId::both>
+{
+  public:
+    explicit Both(StateArgs& args) : StateBase<Desc, Desc::StateId::both>(args)
+    {
+    }
+};
+
+struct RegionToggleDesc
+{
+    enum class StateId
+    {
+        both,
+        a0,
+        a1,
+        b0,
+        b1,
+        stateIdNo
+    };
+    using Event = int;
+    using Fsm = ToggleFsm<RegionToggleDesc>;
+    using States =
+        StateList<StateDef<Both<RegionToggleDesc>>,
+                  StateDef<Toggle<RegionToggleDesc, 1, 2>,
+                           Both<RegionToggleDesc>, 0>,
+                  StateDef<Toggle<RegionToggleDesc, 2, 1>,
+                           Both<RegionToggleDesc>, 0>,
+                  StateDef<Toggle<RegionToggleDesc, 3, 4>,
+                           Both<RegionToggleDesc>, 1>,
+                  StateDef<Toggle<RegionToggleDesc, 4, 3>,
+                           Both<RegionToggleDesc>, 1>>;
+};
+
+struct SingleToggleDesc
+{
+    enum class StateId
+    {
+        a0,
+        a1,
+        stateIdNo
+    };
+    using Event = int;
+    using Fsm = ToggleFsm<SingleToggleDesc>;
+    using States = StateList<StateDef<Toggle<SingleToggleDesc, 0, 1>>,
+                             StateDef<Toggle<SingleToggleDesc, 1, 0>>>;
+};
+
+void
+BM_RegionsOneFsm(benchmark::State& state)
+{
+    ToggleFsm<RegionToggleDesc> fsm;
+    fsm.setStartState(RegionToggleDesc::StateId::both);
+    for (auto _ : state)
+        fsm.postEvent(0);
+    benchmark::DoNotOptimize(fsm.toggles);
+}
+BENCHMARK(BM_RegionsOneFsm);
+
+void
+BM_RegionsTwoFsms(benchmark::State& state)
+{
+    ToggleFsm<SingleToggleDesc> a;
+    ToggleFsm<SingleToggleDesc> b;
+    a.setStartState(SingleToggleDesc::StateId::a0);
+    b.setStartState(SingleToggleDesc::StateId::a0);
+    for (auto _ : state)
+    {
+        a.postEvent(0);
+        b.postEvent(0);
+    }
+    benchmark::DoNotOptimize(a.toggles + b.toggles);
+}
+BENCHMARK(BM_RegionsTwoFsms);
+
+/**
+ * Resume a switched off player at its last leaf, three levels down. With
+ * a deep history target, or emulated by remembering the leaf in the FSM:
+ * 'On' is entered at its initial sub state 'First', which transitions on
+ * to the remembered leaf. The emulation constructs and destroys 'First'
+ * and runs a second transition, which deep history avoids.
+ */
+template <bool native>
+class ResumeFsm;
+
+template <bool native>
+struct ResumeDesc
+{
+    enum class StateId
+    {
+        off,
+        on,
+        mid,
+        leaf,
+        first,
+        stateIdNo
+    };
+    using Event = int;
+    using Fsm = ResumeFsm<native>;
+    static void setupStates(FsmSetup<ResumeDesc>& sc);
+};
+
+template <bool native>
+class ResumeFsm : public FsmBase<ResumeDesc<native>>
+{
+  public:
+    int lastLeaf = FsmStaticData::nullStateId;
+};
+
+template <bool native, int id>
+using ResumeBase =
+    StateBase<ResumeDesc<native>,
+              static_cast<typename ResumeDesc<native>::StateId>(id)>;
+
+template <bool native>
+class ResumeOn : public ResumeBase<native, 1>
+{
+  public:
+    static const constexpr bool keepHistory = true;
+
+    explicit ResumeOn(StateArgs& args) : ResumeBase<native, 1>(args) {}
+};
+
+template <bool native>
+class ResumeFirst : public ResumeBase<native, 4>
+{
+  public:
+    explicit ResumeFirst(StateArgs& args) : ResumeBase<native, 4>(args)
+    {
+        const int last = this->fsm().lastLeaf;
+        if (last != FsmStaticData::nullStateId)
+            this->transition(
+                static_cast<typename ResumeDesc<native>::StateId>(last));
+    }
+};
+
+template <bool native>
+class ResumeOff : public ResumeBase<native, 0>
+{
+  public:
+    explicit ResumeOff(StateArgs& args) : ResumeBase<native, 0>(args) {}
+    bool event(int)
+    {
+        if (native)
+            this->template transition<DeepHistory<ResumeOn<native>>>();
+        else
+            this->template transition<ResumeFirst<native>>();
+        return true;
+    }
+};
+
+template <bool native>
+class ResumeMid : public ResumeBase<native, 2>
+{
+  public:
+    explicit ResumeMid(StateArgs& args) : ResumeBase<native, 2>(args) {}
+};
+
+template <bool native>
+class ResumeLeaf : public ResumeBase<native, 3>
+{
+  public:
+    explicit ResumeLeaf(StateArgs& args) : ResumeBase<native, 3>(args) {}
+    ~ResumeLeaf()
+    {
+        this->fsm().lastLeaf = 3;
+    }
+    bool event(int)
+    {
+        this->template transition<ResumeOff<native>>();
+        return true;
+    }
+};
+
+template <bool native>
+void
+ResumeDesc<native>::setupStates(FsmSetup<ResumeDesc>& sc)
+{
+    sc.template addState<ResumeOff<native>>();
+    sc.template addState<ResumeOn<native>>();
+    sc.template addState<ResumeMid<native>, ResumeOn<native>>();
+    sc.template addState<ResumeLeaf<native>, ResumeMid<native>>();
+    sc.template addState<ResumeFirst<native>, ResumeOn<native>>();
+}
+
+// One iteration switches off and resumes.
+template <bool native>
+void
+BM_HistoryResume(benchmark::State& state)
+{
+    ResumeFsm<native> fsm;
+    fsm.setStartState(ResumeDesc<native>::StateId::leaf);
+    for (auto _ : state)
+    {
+        fsm.postEvent(0);
+        fsm.postEvent(0);
+    }
+    if (fsm.currentStateId() != ResumeDesc<native>::StateId::leaf)
+        state.SkipWithError("not resumed at the leaf");
+}
+BENCHMARK_TEMPLATE(BM_HistoryResume, true);
+BENCHMARK_TEMPLATE(BM_HistoryResume, false);
+
+/**
+ * Transition to self in a state owning a 64 KiB buffer. An external
+ * transition destroys and constructs the state, a local one keeps it.
+ */
+template <bool local>
+class BufferFsm;
+
+template <bool local>
+struct BufferDesc
+{
+    enum class StateId
+    {
+        buffer,
+        stateIdNo
+    };
+    using Event = int;
+    using Fsm = BufferFsm<local>;
+    static void setupStates(FsmSetup<BufferDesc>& sc);
+};
+
+template <bool local>
+class BufferFsm : public FsmBase<BufferDesc<local>>
+{
+};
+
+template <bool local>
+class BufferState
+    : public StateBase<BufferDesc<local>, BufferDesc<local>::StateId::buffer>
+{
+  public:
+    explicit BufferState(StateArgs& args)
+        : StateBase<BufferDesc<local>, BufferDesc<local>::StateId::buffer>(
+              args),
+          m_buffer(64 * 1024)
+    {
+    }
+    bool event(int)
+    {
+        if (local)
+            this->template localTransition<BufferState>();
+        else
+            this->template transition<BufferState>();
+        return true;
+    }
+    std::vector<char> m_buffer;
+};
+
+template <bool local>
+void
+BufferDesc<local>::setupStates(FsmSetup<BufferDesc>& sc)
+{
+    sc.template addState<BufferState<local>>();
+}
+
+template <bool local>
+void
+BM_SelfTransition(benchmark::State& state)
+{
+    BufferFsm<local> fsm;
+    fsm.setStartState(BufferDesc<local>::StateId::buffer);
+    for (auto _ : state)
+        fsm.postEvent(0);
+}
+BENCHMARK_TEMPLATE(BM_SelfTransition, false);
+BENCHMARK_TEMPLATE(BM_SelfTransition, true);
+
+/**
+ * Hand a 16 KiB buffer from one state to the next. Moved through a
+ * transition payload, or copied into the FSM and from there into the
+ * target, like the data members of the FSM in fsm_test.cpp.
+ */
+template <bool payload>
+class HandOverFsm;
+
+template <bool payload>
+struct HandOverDesc
+{
+    enum class StateId
+    {
+        ping,
+        pong,
+        stateIdNo
+    };
+    using Event = int;
+    using Fsm = HandOverFsm<payload>;
+    static void setupStates(FsmSetup<HandOverDesc>& sc);
+};
+
+template <bool payload>
+class HandOverFsm : public FsmBase<HandOverDesc<payload>>
+{
+  public:
+    std::vector<char> handOver;
+};
+
+template <bool payload, int id>
+class HandOverState
+    : public StateBase<HandOverDesc<payload>,
+                       static_cast<typename HandOverDesc<payload>::StateId>(
+                           id)>
+{
+    using Base =
+        StateBase<HandOverDesc<payload>,
+                  static_cast<typename HandOverDesc<payload>::StateId>(id)>;
+
+  public:
+    explicit HandOverState(StateArgs& args)
+        : Base(args), m_buffer(this->fsm().handOver)
+    {
+    }
+    HandOverState(StateArgs& args, std::vector<char> buffer)
+        : Base(args), m_buffer(std::move(buffer))
+    {
+    }
+    bool event(int)
+    {
+        using Next = HandOverState<payload, 1 - id>;
+        if (payload)
+            this->template transition<Next>(std::move(m_buffer));
+        else
+        {
+            this->fsm().handOver = m_buffer;
+            this->template transition<Next>();
+        }
+        return true;
+    }
+    std::vector<char> m_buffer;
+};
+
+template <bool payload>
+void
+HandOverDesc<payload>::setupStates(FsmSetup<HandOverDesc>& sc)
+{
+    sc.template addState<HandOverState<payload, 0>>();
+    sc.template addState<HandOverState<payload, 1>>();
+}
+
+template <bool payload>
+void
+BM_HandOver(benchmark::State& state)
+{
+    HandOverFsm<payload> fsm;
+    fsm.handOver.resize(16 * 1024);
+    fsm.setStartState(HandOverDesc<payload>::StateId::ping);
+    for (auto _ : state)
+        fsm.postEvent(0);
+}
+BENCHMARK_TEMPLATE(BM_HandOver, false);
+BENCHMARK_TEMPLATE(BM_HandOver, true);
+
+/**
+ * Decide where to go, then go there. With a choice pseudo-state, or with
+ * an intermediate state transitioning from its constructor.
+ */
+template <bool choice>
+class DecideFsm;
+
+template <bool choice>
+struct DecideDesc
+{
+    enum class StateId
+    {
+        idle,
+        decide,
+        left,
+        right,
+        stateIdNo
+    };
+    using Event = int;
+    using Fsm = DecideFsm<choice>;
+    static void setupStates(FsmSetup<DecideDesc>& sc);
+};
+
+template <bool choice>
+class DecideFsm : public FsmBase<DecideDesc<choice>>
+{
+  public:
+    int turns = 0;
+};
+
+template <bool choice, int id>
+using DecideBase =
+    StateBase<DecideDesc<choice>,
+              static_cast<typename DecideDesc<choice>::StateId>(id)>;
+
+// Idle, left and right go to 'decide' on every event.
+template <bool choice, int id>
+class DecideState : public DecideBase<choice, id>
+{
+  public:
+    explicit DecideState(StateArgs& args) : DecideBase<choice, id>(args) {}
+    bool event(int)
+    {
+        this->fsm().turns++;
+        this->transition(DecideDesc<choice>::StateId::decide);
+        return true;
+    }
+};
+
+// Alternate between left and right.
+template <bool choice>
+typename DecideDesc<choice>::StateId
+nextSide(const DecideFsm<choice>& fsm)
+{
+    using StateId = typename DecideDesc<choice>::StateId;
+    return fsm.turns % 2 ? StateId::left : StateId::right;
+}
+
+class DecideChoice
+    : public ChoiceBase<DecideDesc<true>, DecideDesc<true>::StateId::decide>
+{
+  public:
+    static StateId choose(const Fsm& fsm)
+    {
+        return nextSide(fsm);
+    }
+};
+
+class DecideInterim : public DecideBase<false, 1>
+{
+  public:
+    explicit DecideInterim(StateArgs& args) : DecideBase<false, 1>(args)
+    {
+        transition(nextSide(fsm()));
+    }
+};
+
+template <>
+void
+DecideDesc<true>::setupStates(FsmSetup<DecideDesc>& sc)
+{
+    sc.addState<DecideState<true, 0>>();
+    sc.addChoice<DecideChoice>();
+    sc.addState<DecideState<true, 2>>();
+    sc.addState<DecideState<true, 3>>();
+}
+
+template <>
+void
+DecideDesc<false>::setupStates(FsmSetup<DecideDesc>& sc)
+{
+    sc.addState<DecideState<false, 0>>();
+    sc.addState<DecideInterim>();
+    sc.addState<DecideState<false, 2>>();
+    sc.addState<DecideState<false, 3>>();
+}
+
+template <bool choice>
+void
+BM_Decide(benchmark::State& state)
+{
+    DecideFsm<choice> fsm;
+    fsm.setStartState(DecideDesc<choice>::StateId::idle);
+    for (auto _ : state)
+        fsm.postEvent(0);
+}
+BENCHMARK_TEMPLATE(BM_Decide, false);
+BENCHMARK_TEMPLATE(BM_Decide, true);
+
+/**
+ * A leaf two levels down updating its root through parent<>() on every
+ * event. With runtime tables and with a 'States' type list.
+ */
+template <class Desc>
+class ParentFsm : public FsmBase<Desc>
+{
+};
+
+template <class Desc, int id>
+using ParentBase =
+    StateBase<Desc, static_cast<typename Desc::StateId>(id)>;
+
+template <class Desc>
+class ParentRoot : public ParentBase<Desc, 0>
+{
+  public:
+    explicit ParentRoot(StateArgs& args) : ParentBase<Desc, 0>(args) {}
+    long count = 0;
+};
+
+template <class Desc>
+class ParentMid : public ParentBase<Desc, 1>
+{
+  public:
+    explicit ParentMid(StateArgs& args) : ParentBase<Desc, 1>(args) {}
+};
+
+template <class Desc>
+class ParentLeaf : public ParentBase<Desc, 2>
+{
+  public:
+    explicit ParentLeaf(StateArgs& args) : ParentBase<Desc, 2>(args) {}
+    bool event(int)
+    {
+        this->template parent<ParentRoot<Desc>>().count++;
+        return true;
+    }
+};
+
+struct ParentIds
+{
+    enum class StateId
+    {
+        root,
+        mid,
+        leaf,
+        stateIdNo
+    };
+    using Event = int;
+};
+
+struct RuntimeParentDesc : ParentIds
+{
+    using Fsm = ParentFsm<RuntimeParentDesc>;
+    static void setupStates(FsmSetup<RuntimeParentDesc>& sc)
+    {
+        sc.addState<ParentRoot<RuntimeParentDesc>>();
+        sc.addState<ParentMid<RuntimeParentDesc>,
+                    ParentRoot<RuntimeParentDesc>>();
+        sc.addState<ParentLeaf<RuntimeParentDesc>,
+                    ParentMid<RuntimeParentDesc>>();
+    }
+};
+
+struct ConstParentDesc : ParentIds
+{
+    using Fsm = ParentFsm<ConstParentDesc>;
+    using States =
+        StateList<StateDef<ParentRoot<ConstParentDesc>>,
+                  StateDef<ParentMid<ConstParentDesc>,
+                           ParentRoot<ConstParentDesc>>,
+                  StateDef<ParentLeaf<ConstParentDesc>,
+                           ParentMid<ConstParentDesc>>>;
+};
+
+template <class Desc>
+void
+BM_ParentAccess(benchmark::State& state)
+{
+    ParentFsm<Desc> fsm;
+    fsm.setStartState(Desc::StateId::leaf);
+    for (auto _ : state)
+        fsm.postEvent(0);
+    benchmark::DoNotOptimize(
+        fsm.template activeState<ParentRoot<Desc>>()->count);
+}
+BENCHMARK_TEMPLATE(BM_ParentAccess, RuntimeParentDesc);
+BENCHMARK_TEMPLATE(BM_ParentAccess, ConstParentDesc);
+
+/**
+ * Four "are we inside X" checks on a DeepShape<8> chart. Through
+ * activeState, isIn and one isInAny with a set of the four states.
+ */
+enum class InQuery
+{
+    activeState,
+    isIn,
+    set,
+};
+
+template <InQuery query>
+void
+BM_InQueries(benchmark::State& state)
+{
+    using Shape = DeepShape<8>;
+    using StateId = ChartDesc<Shape>::StateId;
+    ChartFsm<Shape> fsm;
+    fsm.start();
+    constexpr auto set = FsmStateSet<ChartDesc<Shape>>::of<
+        Node<Shape, 3>, Node<Shape, 12>, Node<Shape, 16>, Node<Shape, 7>>();
+    long hits = 0;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(&fsm);
+        if (query == InQuery::activeState)
+            hits += fsm.activeState<Node<Shape, 3>>() ||
+                    fsm.activeState<Node<Shape, 12>>() ||
+                    fsm.activeState<Node<Shape, 16>>() ||
+                    fsm.activeState<Node<Shape, 7>>();
+        else if (query == InQuery::isIn)
+            hits += fsm.isIn(StateId(3)) || fsm.isIn(StateId(12)) ||
+                    fsm.isIn(StateId(16)) || fsm.isIn(StateId(7));
+        else
+            hits += fsm.isInAny(set);
+    }
+    benchmark::DoNotOptimize(hits);
+}
+BENCHMARK_TEMPLATE(BM_InQueries, InQuery::activeState);
+BENCHMARK_TEMPLATE(BM_InQueries, InQuery::isIn);
+BENCHMARK_TEMPLATE(BM_InQueries, InQuery::set);
+
+template <class Shape>
+void
+BM_SetStartState(benchmark::State& state)
+{
+    ChartFsm<Shape> fsm;
+    for (auto _ : state)
+        fsm.start();
+}
+BENCHMARK_TEMPLATE(BM_SetStartState, DeepShape<1>);
+BENCHMARK_TEMPLATE(BM_SetStartState, DeepShape<8>);
+BENCHMARK_TEMPLATE(BM_SetStartState, DeepShape<32>);
+BENCHMARK_TEMPLATE(BM_SetStartState, WideShape<64>);
+
+// Construction and destruction of an instance. The 'bytes' counter is the
+// memory held by one instance: the FSM object plus its instance block.
+template <class Fsm>
+void
+BM_Instance(benchmark::State& state)
+{
+    size_t bytes = 0;
+    for (auto _ : state)
+    {
+        Fsm fsm;
+        benchmark::DoNotOptimize(&fsm);
+        bytes = sizeof(Fsm) + fsm.member().blockSize();
+    }
+    state.counters["bytes"] = bytes;
+}
+BENCHMARK_TEMPLATE(BM_Instance, TestStyleFsm);
+BENCHMARK_TEMPLATE(BM_Instance, ChartFsm<DeepShape<8>>);
+BENCHMARK_TEMPLATE(BM_Instance, ChartFsm<DeepShape<32>>);
+BENCHMARK_TEMPLATE(BM_Instance, ChartFsm<WideShape<64>>);
+
+/**
+ * Queue throughput. Batches of 'range(0)' events are added and then
+ * drained by processQueue.
+ */
+template <class QueueType>
+class QueueFsm;
+template <class Desc>
+class SumState;
+
+template <class QueueType>
+struct QueueDesc
+{
+    enum class StateId
+    {
+        sum,
+        stateIdNo
+    };
+    using Event = int;
+    using Fsm = QueueFsm<QueueType>;
+    using Queue = QueueType;
+    using States = StateList<StateDef<SumState<QueueDesc>>>;
+};
+
+template <class QueueType>
+class QueueFsm : public FsmBase<QueueDesc<QueueType>>
+{
+  public:
+    long sum = 0;
+};
+
+template <class Desc>
+class SumState : public StateBase<Desc, Desc::StateId::sum>
+{
+  public:
+    explicit SumState(StateArgs& args) : StateBase<Desc, Desc::StateId::sum>(args)
+    {
+    }
+    bool event(int ev)
+    {
+        this->fsm().sum += ev;
+        return true;
+    }
+};
+
+template <class Queue>
+void
+BM_QueueThroughput(benchmark::State& state)
+{
+    QueueFsm<Queue> fsm;
+    fsm.setStartState(QueueDesc<Queue>::StateId::sum);
+    const int batch = state.range(0);
+    for (auto _ : state)
+    {
+        for (int i = 0; i < batch; i++)
+            fsm.addEvent(i);
+        fsm.processQueue();
+    }
+    benchmark::DoNotOptimize(fsm.sum);
+    state.SetItemsProcessed(state.iterations() * batch);
+}
+BENCHMARK_TEMPLATE(BM_QueueThroughput, VecQueue<int, BufferAllocator<int>>)->Arg(16)->Arg(1024);
+BENCHMARK_TEMPLATE(BM_QueueThroughput, RingQueue<int>)->Arg(16)->Arg(1024);
+BENCHMARK_TEMPLATE(BM_QueueThroughput, MpscQueue<int>)->Arg(16)->Arg(1024);
+
+/**
+ * Three kinds of events through the queue, to a leaf handling two of them
+ * and its parent. As one struct with an id and the fields of all kinds,
+ * switched on in 'event', or as an EventVariant with 'on' overloads.
+ */
+struct KeyPress
+{
+    int key;
+};
+
+struct PointerMove
+{
+    int x;
+    int y;
+};
+
+struct TextInput
+{
+    char text[48];
+};
+
+struct TaggedEvent
+{
+    enum class Kind
+    {
+        key,
+        pointer,
+        text,
+    };
+    Kind kind;
+    KeyPress key;
+    PointerMove pointer;
+    TextInput text;
+};
+
+template <bool variant>
+class KindFsm;
+
+template <bool variant>
+struct KindDesc
+{
+    enum class StateId
+    {
+        root,
+        leaf,
+        stateIdNo
+    };
+    using Event = typename std::conditional<
+        variant, EventVariant<KeyPress, PointerMove, TextInput>,
+        TaggedEvent>::type;
+    using Fsm = KindFsm<variant>;
+    static void setupStates(FsmSetup<KindDesc>& sc);
+};
+
+template <bool variant>
+class KindFsm : public FsmBase<KindDesc<variant>>
+{
+  public:
+    long sum = 0;
+
+    // Queue 'n' events, cycling through the kinds.
+    void addEvents(int n);
+};
+
+template <>
+void
+KindFsm<false>::addEvents(int n)
+{
+    TaggedEvent ev{};
+    for (int i = 0; i < n; i++)
+    {
+        ev.kind = static_cast<TaggedEvent::Kind>(i % 3);
+        ev.key.key = i;
+        ev.pointer = PointerMove{i, i};
+        ev.text.text[0] = 't';
+        addEvent(ev);
+    }
+}
+
+template <>
+void
+KindFsm<true>::addEvents(int n)
+{
+    for (int i = 0; i < n; i++)
+    {
+        if (i % 3 == 0)
+            addEvent(KeyPress{i});
+        else if (i % 3 == 1)
+            addEvent(PointerMove{i, i});
+        else
+            addEvent(TextInput{{'t'}});
+    }
+}
+
+template <bool variant, int id>
+using KindBase =
+    StateBase<KindDesc<variant>,
+              static_cast<typename KindDesc<variant>::StateId>(id)>;
+
+template <bool variant>
+class KindRoot : public KindBase<variant, 0>
+{
+  public:
+    explicit KindRoot(StateArgs& args) : KindBase<variant, 0>(args) {}
+    bool event(const typename KindDesc<variant>::Event&)
+    {
+        this->fsm().sum++;
+        return true;
+    }
+};
+
+class TaggedLeaf : public KindBase<false, 1>
+{
+  public:
+    explicit TaggedLeaf(StateArgs& args) : KindBase<false, 1>(args) {}
+    bool event(const TaggedEvent& ev)
+    {
+        switch (ev.kind)
+        {
+        case TaggedEvent::Kind::key:
+            fsm().sum += ev.key.key;
+            return true;
+        case TaggedEvent::Kind::text:
+            fsm().sum += ev.text.text[0];
+            return true;
+        default:
+            return false;
+        }
+    }
+};
+
+class VariantLeaf : public KindBase<true, 1>
+{
+  public:
+    explicit VariantLeaf(StateArgs& args) : KindBase<true, 1>(args) {}
+    bool on(const KeyPress& key)
+    {
+        fsm().sum += key.key;
+        return true;
+    }
+    bool on(const TextInput& text)
+    {
+        fsm().sum += text.text[0];
+        return true;
+    }
+};
+
+template <>
+void
+KindDesc<false>::setupStates(FsmSetup<KindDesc>& sc)
+{
+    sc.addState<KindRoot<false>>();
+    sc.addState<TaggedLeaf, KindRoot<false>>();
+}
+
+template <>
+void
+KindDesc<true>::setupStates(FsmSetup<KindDesc>& sc)
+{
+    sc.addState<KindRoot<true>>();
+    sc.addState<VariantLeaf, KindRoot<true>>();
+}
+
+template <bool variant>
+void
+BM_EventKinds(benchmark::State& state)
+{
+    KindFsm<variant> fsm;
+    fsm.setStartState(KindDesc<variant>::StateId::leaf);
+    const int batch = state.range(0);
+    for (auto _ : state)
+    {
+        fsm.addEvents(batch);
+        fsm.processQueue();
+    }
+    benchmark::DoNotOptimize(fsm.sum);
+    state.SetItemsProcessed(state.iterations() * batch);
+    state.counters["bytes"] = sizeof(typename KindDesc<variant>::Event);
+}
+BENCHMARK_TEMPLATE(BM_EventKinds, false)->Arg(16)->Arg(1024);
+BENCHMARK_TEMPLATE(BM_EventKinds, true)->Arg(16)->Arg(1024);
+
+} // namespace
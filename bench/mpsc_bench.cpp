@@ -0,0 +1,137 @@
+/*
+ * mpsc_bench.cpp
+ *
+ *  Created on: 15 okt. 2026
+ *      Author: mikaelr
+ */
+
+#include "StateChart.h"
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+/**
+ * Enqueue throughput of postEvent with several producer threads and one
+ * consumer thread running processQueue. Compare the MpscQueue FSM with a
+ * single threaded FSM behind a mutex.
+ */
+namespace
+{
+
+template <class Fsm>
+class CountState;
+
+template <class Queue>
+class BenchFsm;
+
+template <class QueueType>
+struct BenchDesc
+{
+    enum class StateId
+    {
+        count,
+        stateIdNo
+    };
+    using Event = int;
+    using Fsm = BenchFsm<QueueType>;
+    using Queue = QueueType;
+    using States = StateList<StateDef<CountState<BenchDesc>>>;
+};
+
+template <class Queue>
+class BenchFsm : public FsmBase<BenchDesc<Queue>>
+{
+  public:
+    long sum = 0;
+};
+
+template <class Desc>
+class CountState : public StateBase<Desc, Desc::StateId::count>
+{
+  public:
+    explicit CountState(StateArgs& args) : StateBase<Desc, Desc::StateId::count>(args)
+    {
+    }
+    bool event(int ev)
+    {
+        this->fsm().sum += ev;
+        return true;
+    }
+};
+
+using MpscFsm = BenchFsm<MpscQueue<int>>;
+using LockedFsm = BenchFsm<VecQueue<int, BufferAllocator<int>>>;
+
+// Shared between the benchmark threads. Set up by thread 0.
+template <class Fsm>
+struct Shared
+{
+    static Fsm* fsm;
+    static std::thread consumer;
+    static std::atomic<bool> stop;
+    static std::mutex lock;
+};
+template <class Fsm>
+Fsm* Shared<Fsm>::fsm;
+template <class Fsm>
+std::thread Shared<Fsm>::consumer;
+template <class Fsm>
+std::atomic<bool> Shared<Fsm>::stop;
+template <class Fsm>
+std::mutex Shared<Fsm>::lock;
+
+void
+BM_MpscPostEvent(benchmark::State& state)
+{
+    using S = Shared<MpscFsm>;
+    if (state.thread_index() == 0)
+    {
+        S::fsm = new MpscFsm;
+        S::fsm->setStartState(BenchDesc<MpscQueue<int>>::StateId::count);
+        S::stop = false;
+        S::consumer = std::thread([] {
+            while (!S::stop.load(std::memory_order_relaxed))
+                S::fsm->processQueue();
+        });
+    }
+    for (auto _ : state)
+        S::fsm->postEvent(1);
+
+    if (state.thread_index() == 0)
+    {
+        S::stop = true;
+        S::consumer.join();
+        S::fsm->processQueue();
+        delete S::fsm;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MpscPostEvent)->ThreadRange(1, 16)->UseRealTime();
+
+// The setup used before MpscQueue: every post takes a mutex and runs
+// the queue on the posting thread.
+void
+BM_MutexPostEvent(benchmark::State& state)
+{
+    using S = Shared<LockedFsm>;
+    if (state.thread_index() == 0)
+    {
+        S::fsm = new LockedFsm;
+        S::fsm->setStartState(
+            BenchDesc<VecQueue<int, BufferAllocator<int>>>::StateId::count);
+    }
+    for (auto _ : state)
+    {
+        std::lock_guard<std::mutex> guard(S::lock);
+        S::fsm->postEvent(1);
+    }
+    if (state.thread_index() == 0)
+        delete S::fsm;
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MutexPostEvent)->ThreadRange(1, 16)->UseRealTime();
+
+} // namespace
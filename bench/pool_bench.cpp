@@ -0,0 +1,151 @@
+/*
+ * pool_bench.cpp
+ *
+ *  Created on: 15 okt. 2026
+ *      Author: mikaelr
+ */
+
+#include "FsmPool.h"
+
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <random>
+#include <vector>
+
+/**
+ * Many instances receiving events in random order. Separately allocated
+ * instances posted one by one, compared with pooled instances dispatched
+ * with dispatchBatch.
+ */
+namespace
+{
+
+class ConnFsm;
+class Closed;
+class Open;
+
+struct ConnDesc
+{
+    enum class StateId
+    {
+        closed,
+        open,
+        stateIdNo
+    };
+    using Event = int;
+    using Fsm = ConnFsm;
+    using States = StateList<StateDef<Closed>, StateDef<Open, Closed>>;
+};
+
+class ConnFsm : public FsmBase<ConnDesc>
+{
+  public:
+    long bytes = 0;
+};
+
+class Closed : public StateBase<ConnDesc, ConnDesc::StateId::closed>
+{
+  public:
+    explicit Closed(StateArgs& args) : StateBase(args) {}
+    bool event(int)
+    {
+        transition<Open>();
+        return true;
+    }
+};
+
+class Open : public StateBase<ConnDesc, ConnDesc::StateId::open>
+{
+  public:
+    explicit Open(StateArgs& args) : StateBase(args) {}
+    bool event(int ev)
+    {
+        fsm().bytes += ev;
+        return true;
+    }
+};
+
+const int batchSize = 1 << 16;
+
+std::vector<std::size_t>
+randomTargets(std::size_t instances)
+{
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<std::size_t> dist(0, instances - 1);
+    std::vector<std::size_t> targets(batchSize);
+    for (auto& t : targets)
+        t = dist(gen);
+    return targets;
+}
+
+void
+BM_HeapInstances(benchmark::State& state)
+{
+    const std::size_t instances = state.range(0);
+    std::vector<std::unique_ptr<ConnFsm>> fsms;
+    for (std::size_t i = 0; i < instances; i++)
+    {
+        fsms.emplace_back(new ConnFsm);
+        fsms.back()->setStartState(ConnDesc::StateId::closed);
+    }
+    auto targets = randomTargets(instances);
+    for (auto _ : state)
+        for (auto t : targets)
+            fsms[t]->postEvent(1);
+    state.SetItemsProcessed(state.iterations() * batchSize);
+    state.counters["bytes"] =
+        sizeof(ConnFsm) + fsms[0]->member().blockSize() +
+        FsmBaseMember::cacheLineSize - 1;
+}
+BENCHMARK(BM_HeapInstances)->Arg(1024)->Arg(1 << 16)->Arg(1 << 20);
+
+void
+BM_PoolDispatchBatch(benchmark::State& state)
+{
+    const std::size_t instances = state.range(0);
+    FsmPool<ConnDesc> pool;
+    std::vector<FsmPool<ConnDesc>::Id> ids;
+    pool.createBatch(instances, ids);
+    for (auto id : ids)
+        pool[id].setStartState(ConnDesc::StateId::closed);
+    auto targets = randomTargets(instances);
+    std::vector<int> events(batchSize, 1);
+    for (auto _ : state)
+        pool.dispatchBatch(targets, events);
+    state.SetItemsProcessed(state.iterations() * batchSize);
+    state.counters["bytes"] = pool.slotSize();
+}
+BENCHMARK(BM_PoolDispatchBatch)->Arg(1024)->Arg(1 << 16)->Arg(1 << 20);
+
+void
+BM_PoolCreateDestroy(benchmark::State& state)
+{
+    FsmPool<ConnDesc> pool;
+    std::vector<FsmPool<ConnDesc>::Id> ids;
+    for (auto _ : state)
+    {
+        pool.createBatch(batchSize, ids);
+        pool.destroyBatch(ids);
+        ids.clear();
+    }
+    state.SetItemsProcessed(state.iterations() * batchSize);
+}
+BENCHMARK(BM_PoolCreateDestroy);
+
+void
+BM_HeapCreateDestroy(benchmark::State& state)
+{
+    std::vector<std::unique_ptr<ConnFsm>> fsms(batchSize);
+    for (auto _ : state)
+    {
+        for (auto& fsm : fsms)
+            fsm.reset(new ConnFsm);
+        for (auto& fsm : fsms)
+            fsm.reset();
+    }
+    state.SetItemsProcessed(state.iterations() * batchSize);
+}
+BENCHMARK(BM_HeapCreateDestroy);
+
+} // namespace
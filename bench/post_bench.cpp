@@ -0,0 +1,110 @@
+/*
+ * post_bench.cpp
+ *
+ *  Created on: 15 okt. 2026
+ *      Author: mikaelr
+ */
+
+#include "StateChart.h"
+
+#include <benchmark/benchmark.h>
+
+/**
+ * Latency of a single external event. postEvent on an idle FSM dispatches
+ * directly, addEvent + processQueue always goes through the queue. For a
+ * small event both do the same work, the direct dispatch saves copying
+ * the event in and out of the queue.
+ */
+namespace
+{
+
+template <class Event>
+class PostFsm;
+template <class Event>
+class PostState;
+
+template <class Ev>
+struct PostDesc
+{
+    enum class StateId
+    {
+        only,
+        stateIdNo
+    };
+    using Event = Ev;
+    using Fsm = PostFsm<Ev>;
+    using States = StateList<StateDef<PostState<Ev>>>;
+};
+
+// An event of a cache line.
+struct LargeEvent
+{
+    explicit LargeEvent(int value) : values{value} {}
+    int values[16];
+};
+
+int
+valueOf(int ev)
+{
+    return ev;
+}
+
+int
+valueOf(const LargeEvent& ev)
+{
+    return ev.values[0];
+}
+
+template <class Event>
+class PostFsm : public FsmBase<PostDesc<Event>>
+{
+  public:
+    long sum = 0;
+};
+
+template <class Event>
+class PostState
+    : public StateBase<PostDesc<Event>, PostDesc<Event>::StateId::only>
+{
+  public:
+    explicit PostState(StateArgs& args)
+        : StateBase<PostDesc<Event>, PostDesc<Event>::StateId::only>(args)
+    {
+    }
+    bool event(const Event& ev)
+    {
+        this->fsm().sum += valueOf(ev);
+        return true;
+    }
+};
+
+template <class Event>
+void
+BM_PostEventIdle(benchmark::State& state)
+{
+    PostFsm<Event> fsm;
+    fsm.setStartState(PostDesc<Event>::StateId::only);
+    for (auto _ : state)
+        fsm.postEvent(Event(1));
+    benchmark::DoNotOptimize(fsm.sum);
+}
+BENCHMARK_TEMPLATE(BM_PostEventIdle, int);
+BENCHMARK_TEMPLATE(BM_PostEventIdle, LargeEvent);
+
+template <class Event>
+void
+BM_AddEventProcessQueue(benchmark::State& state)
+{
+    PostFsm<Event> fsm;
+    fsm.setStartState(PostDesc<Event>::StateId::only);
+    for (auto _ : state)
+    {
+        fsm.addEvent(Event(1));
+        fsm.processQueue();
+    }
+    benchmark::DoNotOptimize(fsm.sum);
+}
+BENCHMARK_TEMPLATE(BM_AddEventProcessQueue, int);
+BENCHMARK_TEMPLATE(BM_AddEventProcessQueue, LargeEvent);
+
+} // namespace
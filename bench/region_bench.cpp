@@ -0,0 +1,95 @@
+/*
+ * region_bench.cpp
+ *
+ *  Created on: 15 okt. 2026
+ *      Author: mikaelr
+ */
+
+#include "RegionPool.h"
+#include "StateChart.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+
+/**
+ * One FSM whose four regions do 'range(0)' rounds of work per event, with
+ * the regions dispatched sequentially or on a RegionPool. The parallel
+ * dispatch pays a wakeup per event and needs several cores to win.
+ */
+namespace
+{
+
+class WorkFsm;
+
+struct WorkDesc
+{
+    enum class StateId
+    {
+        top,
+        r0,
+        r1,
+        r2,
+        r3,
+        stateIdNo // Keep this last. Gives the number of states.
+    };
+    using Event = int;
+    using Fsm = WorkFsm;
+    static void setupStates(FsmSetup<WorkDesc>& sc);
+};
+
+class WorkFsm : public FsmBase<WorkDesc>
+{
+  public:
+    int rounds = 0;
+};
+
+class Top : public StateBase<WorkDesc, WorkDesc::StateId::top>
+{
+  public:
+    explicit Top(StateArgs& args) : StateBase(args) {}
+};
+
+template <WorkDesc::StateId id>
+class Work : public StateBase<WorkDesc, id>
+{
+  public:
+    explicit Work(StateArgs& args) : StateBase<WorkDesc, id>(args) {}
+    bool event(int)
+    {
+        // Only this region writes m_value.
+        for (int i = 0; i < this->fsm().rounds; i++)
+            m_value = m_value * 6364136223846793005u + 1442695040888963407u;
+        benchmark::DoNotOptimize(m_value);
+        return true;
+    }
+    std::uint64_t m_value = 1;
+};
+
+void
+WorkDesc::setupStates(FsmSetup<WorkDesc>& sc)
+{
+    sc.addState<Top>();
+    sc.addState<Work<StateId::r0>, Top>(0);
+    sc.addState<Work<StateId::r1>, Top>(1);
+    sc.addState<Work<StateId::r2>, Top>(2);
+    sc.addState<Work<StateId::r3>, Top>(3);
+}
+
+template <int threadNo>
+void
+BM_RegionWork(benchmark::State& state)
+{
+    RegionPool pool(threadNo);
+    WorkFsm fsm;
+    fsm.rounds = state.range(0);
+    if (threadNo > 0)
+        fsm.setRegionExecutor(&pool);
+    fsm.setStartState(WorkDesc::StateId::top);
+    for (auto _ : state)
+        fsm.postEvent(0);
+}
+BENCHMARK_TEMPLATE(BM_RegionWork, 0)->Arg(0)->Arg(1000)->Arg(100000);
+BENCHMARK_TEMPLATE(BM_RegionWork, 3)->Arg(0)->Arg(1000)->Arg(100000);
+
+} // namespace
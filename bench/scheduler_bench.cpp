@@ -0,0 +1,92 @@
+/*
+ * scheduler_bench.cpp
+ *
+ *  Created on: 15 okt. 2026
+ *      Author: mikaelr
+ */
+
+#include "FsmScheduler.h"
+
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <vector>
+
+/**
+ * Throughput of FsmScheduler with 1 to 64 worker threads. Tokens are
+ * passed around a ring of actors, each hop is one postEvent and one
+ * schedule from a worker thread.
+ */
+namespace
+{
+
+class RingFsm;
+class Passing;
+
+struct RingDesc
+{
+    enum class StateId
+    {
+        passing,
+        stateIdNo
+    };
+    using Event = int;
+    using Fsm = RingFsm;
+    using Queue = MpscQueue<int>;
+    using States = StateList<StateDef<Passing>>;
+};
+
+class RingFsm : public FsmActor<RingDesc>
+{
+  public:
+    RingFsm()
+    {
+        setStartState(RingDesc::StateId::passing);
+    }
+    FsmScheduler* scheduler = nullptr;
+    RingFsm* next = nullptr;
+};
+
+class Passing : public StateBase<RingDesc, RingDesc::StateId::passing>
+{
+  public:
+    explicit Passing(StateArgs& args) : StateBase(args) {}
+    bool event(int hops)
+    {
+        if (hops > 0)
+            fsm().scheduler->post(*fsm().next, hops - 1);
+        return true;
+    }
+};
+
+const int actorNo = 1024;
+const int tokenNo = 256;
+const int hops = 256;
+
+void
+BM_SchedulerTokenRing(benchmark::State& state)
+{
+    FsmScheduler scheduler(state.range(0));
+    std::vector<std::unique_ptr<RingFsm>> actors;
+    for (int i = 0; i < actorNo; i++)
+        actors.emplace_back(new RingFsm);
+    for (int i = 0; i < actorNo; i++)
+    {
+        actors[i]->scheduler = &scheduler;
+        actors[i]->next = actors[(i + 1) % actorNo].get();
+    }
+
+    for (auto _ : state)
+    {
+        for (int token = 0; token < tokenNo; token++)
+            scheduler.post(*actors[token * actorNo / tokenNo], hops);
+        scheduler.waitIdle();
+    }
+    state.SetItemsProcessed(state.iterations() * tokenNo * (hops + 1));
+}
+BENCHMARK(BM_SchedulerTokenRing)
+    ->RangeMultiplier(2)
+    ->Range(1, 64)
+    ->UseRealTime();
+
+} // namespace
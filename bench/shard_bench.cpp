@@ -0,0 +1,106 @@
+/*
+ * shard_bench.cpp
+ *
+ *  Created on: 15 okt. 2026
+ *      Author: mikaelr
+ */
+
+#include "ShardRuntime.h"
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+/**
+ * Throughput of ShardRuntime. Tokens are passed around a ring of FSMs
+ * spread round robin over the shards, so every hop crosses shards through
+ * an SPSC ring.
+ */
+namespace
+{
+
+class HopFsm;
+class Hopping;
+
+struct HopDesc
+{
+    enum class StateId
+    {
+        hopping,
+        stateIdNo
+    };
+    using Event = int;
+    using Fsm = HopFsm;
+    using States = StateList<StateDef<Hopping>>;
+};
+
+using Runtime = ShardRuntime<int>;
+
+class HopFsm : public FsmBase<HopDesc>
+{
+  public:
+    HopFsm()
+    {
+        setStartState(HopDesc::StateId::hopping);
+    }
+    Runtime* runtime = nullptr;
+    Runtime::Address next = {0, 0};
+    std::atomic<int>* done = nullptr;
+};
+
+class Hopping : public StateBase<HopDesc, HopDesc::StateId::hopping>
+{
+  public:
+    explicit Hopping(StateArgs& args) : StateBase(args) {}
+    bool event(int hops)
+    {
+        if (hops > 0)
+            fsm().runtime->send(fsm().next, hops - 1);
+        else
+            (*fsm().done)++;
+        return true;
+    }
+};
+
+const int fsmNo = 1024;
+const int tokenNo = 256;
+const int hops = 256;
+
+void
+BM_ShardTokenRing(benchmark::State& state)
+{
+    const int shardNo = state.range(0);
+    std::atomic<int> done{0};
+    Runtime runtime(shardNo);
+    std::vector<std::unique_ptr<HopFsm>> fsms;
+    std::vector<Runtime::Address> addresses;
+    for (int i = 0; i < fsmNo; i++)
+    {
+        fsms.emplace_back(new HopFsm);
+        addresses.push_back(runtime.add(i % shardNo, *fsms[i]));
+    }
+    for (int i = 0; i < fsmNo; i++)
+    {
+        fsms[i]->runtime = &runtime;
+        fsms[i]->next = addresses[(i + 1) % fsmNo];
+        fsms[i]->done = &done;
+    }
+    runtime.start();
+
+    for (auto _ : state)
+    {
+        done = 0;
+        for (int token = 0; token < tokenNo; token++)
+            runtime.send(addresses[token * fsmNo / tokenNo], hops);
+        while (done < tokenNo)
+            std::this_thread::yield();
+    }
+    runtime.stop();
+    state.SetItemsProcessed(state.iterations() * tokenNo * (hops + 1));
+}
+BENCHMARK(BM_ShardTokenRing)->RangeMultiplier(2)->Range(1, 8)->UseRealTime();
+
+} // namespace
@@ -0,0 +1,77 @@
+/*
+ * timer_bench.cpp
+ *
+ *  Created on: 15 okt. 2026
+ *      Author: mikaelr
+ */
+
+#include "TimerWheel.h"
+
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <random>
+#include <vector>
+
+/**
+ * Cost of arm + cancel and of advancing the wheel, with many other timers
+ * armed. Arm and cancel should not depend on the number of timers.
+ */
+namespace
+{
+
+void
+noop(TimerWheel::Timer*)
+{
+}
+
+std::vector<std::unique_ptr<TimerWheel::Timer>>
+armMany(TimerWheel& wheel, int count)
+{
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<TimerWheel::Tick> dist(1, 1000000);
+    std::vector<std::unique_ptr<TimerWheel::Timer>> timers;
+    for (int i = 0; i < count; i++)
+    {
+        timers.emplace_back(new TimerWheel::Timer(&noop));
+        wheel.arm(*timers.back(), wheel.now() + dist(gen));
+    }
+    return timers;
+}
+
+void
+BM_TimerArmCancel(benchmark::State& state)
+{
+    TimerWheel wheel;
+    auto others = armMany(wheel, state.range(0));
+    TimerWheel::Timer timer(&noop);
+    TimerWheel::Tick expiry = 1;
+    for (auto _ : state)
+    {
+        wheel.arm(timer, expiry);
+        timer.cancel();
+        expiry = expiry * 7 % 100003;
+    }
+}
+BENCHMARK(BM_TimerArmCancel)->Arg(0)->Arg(1000)->Arg(1000000);
+
+// Advance one tick at a time through timers spread over 1M ticks.
+void
+BM_TimerAdvance(benchmark::State& state)
+{
+    TimerWheel wheel;
+    auto timers = armMany(wheel, state.range(0));
+    for (auto _ : state)
+    {
+        wheel.advance(wheel.now() + 1);
+        if (wheel.size() == 0)
+        {
+            state.PauseTiming();
+            timers = armMany(wheel, state.range(0));
+            state.ResumeTiming();
+        }
+    }
+}
+BENCHMARK(BM_TimerAdvance)->Arg(1000)->Arg(100000);
+
+} // namespace
@@ -3,10 +3,12 @@
 #include <fmt/format.h>
 
 #include "StateChart.h"
+#include "TimerWheel.h"
 
 #include <termios.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <poll.h>
 
 #include <date/date.h>
 
@@ -283,10 +285,14 @@ public:
 
 	Display m_display;
 	LClock m_clock;
+	TimerService m_timers;
+
+	// Timeouts of the states, cancelled when they are exited.
+	FsmTimeouts<DigitalWatch> m_timeouts;
 };
 
 DigitalWatch::DigitalWatch()
-: m_display(m_clock)
+: m_display(m_clock), m_timeouts(m_timers, *this)
 {
 }
 
@@ -352,6 +358,8 @@ public:
 	explicit SetTimeState(StateArgs& args)
 	: State(args), m_display(fsm().m_display)
 	{
+		fsm().m_timeouts.start(*this, milliseconds(0), Event{EId::tick},
+		                       milliseconds(500));
 		m_display.setMode(fsm().modeString(SId::setTime));
 		auto& clk = fsm().m_clock;
 		m_sec = clk.sec();
@@ -361,11 +369,19 @@ public:
 	~SetTimeState()
 	{}
 	bool event(const Event& ev)
+	{
+		// Show edits and cursor moves at once, not at the next tick.
+		bool handled = handleEvent(ev);
+		if (handled)
+			redraw();
+		return handled;
+	}
+	bool handleEvent(const Event& ev)
 	{
 		switch(ev.m_id)
 		{
 		case EId::tick:
-			m_display.print(m_hour, m_min, m_sec, true);
+			redraw();
 			break;
 		case EId::arrow_left:
 			m_display.cursorLeft();
@@ -419,6 +435,10 @@ public:
 		}
 		return false;
 	}
+	void redraw()
+	{
+		m_display.print(m_hour, m_min, m_sec, true);
+	}
 
 	int m_sec;
 	int m_min;
@@ -429,10 +449,14 @@ public:
 class ShowTimeState : public State<StateId::showTime>
 {
 public:
+	// Tick at each new second of the watch.
 	explicit ShowTimeState(StateArgs& args)
 	: State(args), m_display(fsm().m_display)
 	{
+		fsm().m_timeouts.start(*this, milliseconds(1000 - fsm().m_clock.msec()),
+		                       Event{EId::tick}, seconds(1));
 		m_display.setMode(fsm().modeString(SId::showTime));
+		m_display.printTime();
 	}
 	bool event(const Event& ev);
 	Display& m_display;
@@ -477,15 +501,21 @@ int main()
 	dw.setStartState(StateId::showTime);
 	using EId = Event::Id;
 
+	// Sleep until a key is pressed or the next timeout expires.
+	struct pollfd keys = { fileno(stdin), POLLIN, 0 };
 	while(dw.currentStateId() != StateId::endState)
 	{
-		Event ev = nbKeys.getChar();
-		if (ev.m_id != EId::no_key)
+		auto wait = dw.m_timers.timeUntilNext();
+		int waitMs = -1;
+		if (wait != TimerService::Duration::max())
+			waitMs = duration_cast<milliseconds>(wait + milliseconds(1) - nanoseconds(1)).count();
+		poll(&keys, 1, waitMs);
+
+		for (Event ev = nbKeys.getChar(); ev.m_id != EId::no_key; ev = nbKeys.getChar())
 			dw.postEvent(ev);
 
-		dw.postEvent(Event{EId::tick});
+		dw.m_timers.advance();
 		cout.flush();
-		usleep(50000);
 	}
 	cout << "\r" << endl;
 }
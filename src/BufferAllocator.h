@@ -0,0 +1,79 @@
+/*
+ * BufferAllocator.h
+ *
+ *  Created on: 15 okt. 2026
+ *      Author: mikaelr
+ */
+
+#ifndef SRC_UTILITY_BUFFERALLOCATOR_H_
+#define SRC_UTILITY_BUFFERALLOCATOR_H_
+
+#include <cstddef>
+#include <new>
+
+/**
+ * Allocator handing out a caller supplied buffer for the first allocation
+ * that fits in it. Larger or later allocations go to the heap.
+ * Used to let a container start out in memory that is part of a larger
+ * block. The buffer is not owned by the allocator.
+ */
+template <class T>
+class BufferAllocator
+{
+  public:
+    using value_type = T;
+
+    BufferAllocator() = default;
+
+    BufferAllocator(T* buffer, std::size_t capacity)
+        : m_buffer(buffer), m_capacity(capacity)
+    {
+    }
+
+    // Rebound copies do not share the buffer.
+    template <class U>
+    BufferAllocator(const BufferAllocator<U>&)
+    {
+    }
+
+    T* allocate(std::size_t n)
+    {
+        if (m_buffer && !m_bufferUsed && n <= m_capacity)
+        {
+            m_bufferUsed = true;
+            return m_buffer;
+        }
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, std::size_t)
+    {
+        if (p == m_buffer)
+        {
+            m_bufferUsed = false;
+            return;
+        }
+        ::operator delete(p);
+    }
+
+    std::size_t bufferCapacity() const
+    {
+        return m_capacity;
+    }
+
+    bool operator==(const BufferAllocator& o) const
+    {
+        return m_buffer == o.m_buffer;
+    }
+    bool operator!=(const BufferAllocator& o) const
+    {
+        return m_buffer != o.m_buffer;
+    }
+
+  private:
+    T* m_buffer = nullptr;
+    std::size_t m_capacity = 0;
+    bool m_bufferUsed = false;
+};
+
+#endif /* SRC_UTILITY_BUFFERALLOCATOR_H_ */
@@ -0,0 +1,255 @@
+/*
+ * EventVariant.h
+ *
+ *  Created on: 16 okt. 2026
+ *      Author: mikaelr
+ */
+
+#ifndef SRC_UTILITY_EVENTVARIANT_H_
+#define SRC_UTILITY_EVENTVARIANT_H_
+
+#include <cassert>
+#include <cstddef>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+// Index of 'E' in 'Events', or -1.
+template <class E, class... Events>
+constexpr int
+eventVariantIndex()
+{
+    const bool match[] = {std::is_same<E, Events>::value..., false};
+    for (int i = 0; i < static_cast<int>(sizeof...(Events)); i++)
+        if (match[i])
+            return i;
+    return -1;
+}
+
+// True if all of 'values' are true.
+template <bool... values>
+constexpr bool
+eventVariantAll()
+{
+    const bool all[] = {values..., true};
+    for (bool value : all)
+        if (!value)
+            return false;
+    return true;
+}
+
+// Deletes copy in an EventVariant with a move only alternative.
+template <bool copyable>
+struct EventVariantCopy
+{
+};
+
+template <>
+struct EventVariantCopy<false>
+{
+    EventVariantCopy() = default;
+    EventVariantCopy(const EventVariantCopy&) = delete;
+    EventVariantCopy(EventVariantCopy&&) = default;
+    EventVariantCopy& operator=(const EventVariantCopy&) = delete;
+    EventVariantCopy& operator=(EventVariantCopy&&) = default;
+};
+
+// Storage, index and the copy, move and destruction of an EventVariant.
+template <class... Events>
+class EventVariantStorage
+{
+  public:
+    static const constexpr bool trivial =
+        eventVariantAll<std::is_trivially_copyable<Events>::value...>();
+    static const constexpr bool nothrowMove =
+        eventVariantAll<std::is_nothrow_move_constructible<Events>::value...>();
+
+    EventVariantStorage(const EventVariantStorage& other)
+    {
+        static const CopyFkn copies[] = {&copy<Events>...};
+        if (trivial)
+            m_storage = other.m_storage;
+        else
+            copies[other.m_index](&m_storage, &other.m_storage);
+        m_index = other.m_index;
+    }
+
+    EventVariantStorage(EventVariantStorage&& other) noexcept(nothrowMove)
+    {
+        moveFrom(other);
+    }
+
+    // Copied into a temporary first, so a throwing copy leaves this as it
+    // was.
+    EventVariantStorage& operator=(const EventVariantStorage& other)
+    {
+        if (this != &other)
+        {
+            EventVariantStorage copied(other);
+            *this = std::move(copied);
+        }
+        return *this;
+    }
+
+    // A move that throws leaves this without an alternative, see 'empty'.
+    EventVariantStorage&
+    operator=(EventVariantStorage&& other) noexcept(nothrowMove)
+    {
+        if (this != &other)
+        {
+            destroy();
+            moveFrom(other);
+        }
+        return *this;
+    }
+
+    ~EventVariantStorage()
+    {
+        destroy();
+    }
+
+  protected:
+    template <class Ev>
+    struct InPlace
+    {
+    };
+
+    // Construct 'Ev', at 'index' in 'Events', from 'ev'.
+    template <class Ev, class E>
+    EventVariantStorage(InPlace<Ev>, int index, E&& ev) : m_index(index)
+    {
+        new (&m_storage) Ev(std::forward<E>(ev));
+    }
+
+    // Index while no alternative is held.
+    static const constexpr unsigned char empty = 255;
+
+    typename std::aligned_union<0, Events...>::type m_storage;
+    unsigned char m_index = empty;
+
+  private:
+    using CopyFkn = void (*)(void* to, const void* from);
+    using MoveFkn = void (*)(void* to, void* from);
+    using DestroyFkn = void (*)(void* ev);
+
+    template <class E>
+    static void copy(void* to, const void* from)
+    {
+        new (to) E(*static_cast<const E*>(from));
+    }
+
+    template <class E>
+    static void move(void* to, void* from)
+    {
+        new (to) E(std::move(*static_cast<E*>(from)));
+    }
+
+    template <class E>
+    static void destroyAlt(void* ev)
+    {
+        static_cast<E*>(ev)->~E();
+    }
+
+    // Set the index last, so a throwing move leaves this empty.
+    void moveFrom(EventVariantStorage& other) noexcept(nothrowMove)
+    {
+        static const MoveFkn moves[] = {&move<Events>...};
+        m_index = empty;
+        if (trivial)
+            m_storage = other.m_storage;
+        else
+            moves[other.m_index](&m_storage, &other.m_storage);
+        m_index = other.m_index;
+    }
+
+    void destroy()
+    {
+        static const DestroyFkn destroys[] = {&destroyAlt<Events>...};
+        if (!trivial && m_index != empty)
+            destroys[m_index](&m_storage);
+        m_index = empty;
+    }
+};
+
+/**
+ * One of the event types 'Events', for use as FsmDesc::Event. Sized by
+ * the largest alternative plus a one byte index, so a queue of variants
+ * stores each event compactly. Copy and move handle only the alternative
+ * held, and are a plain copy of the storage when all alternatives are
+ * trivially copyable. Copy is deleted if an alternative is move only,
+ * and move is noexcept if all alternatives move without throwing.
+ *
+ * States handle each alternative in an overload 'on(const EvA&)', see
+ * StateFkns. The index is the event id of the dispatch cache.
+ */
+template <class... Events>
+class EventVariant
+    : public EventVariantStorage<Events...>,
+      private EventVariantCopy<
+          eventVariantAll<std::is_copy_constructible<Events>::value...>()>
+{
+    static_assert(sizeof...(Events) > 0 && sizeof...(Events) < 256,
+                  "1 to 255 alternatives.");
+
+    using Storage = EventVariantStorage<Events...>;
+
+  public:
+    static const constexpr int size = sizeof...(Events);
+
+    template <int I>
+    using Alternative =
+        typename std::tuple_element<I, std::tuple<Events...>>::type;
+
+    // Construct from one of the alternatives.
+    template <class E, class Ev = typename std::decay<E>::type,
+              class = typename std::enable_if<
+                  eventVariantIndex<Ev, Events...>() >= 0>::type>
+    EventVariant(E&& ev)
+        : Storage(typename Storage::template InPlace<Ev>(),
+                  eventVariantIndex<Ev, Events...>(), std::forward<E>(ev))
+    {
+    }
+
+    // Position of the held alternative in 'Events'. 255 if a move
+    // assignment threw.
+    int index() const
+    {
+        return this->m_index;
+    }
+
+    template <class E>
+    bool holds() const
+    {
+        return this->m_index == eventVariantIndex<E, Events...>();
+    }
+
+    template <class E>
+    const E& get() const
+    {
+        assert(holds<E>());
+        return *reinterpret_cast<const E*>(&this->m_storage);
+    }
+
+    template <class E>
+    E& get()
+    {
+        assert(holds<E>());
+        return *reinterpret_cast<E*>(&this->m_storage);
+    }
+};
+
+// Number of alternatives of an EventVariant, 0 for other event types.
+template <class Event>
+struct EventVariantSize
+{
+    static const constexpr int value = 0;
+};
+
+template <class... Events>
+struct EventVariantSize<EventVariant<Events...>>
+{
+    static const constexpr int value = sizeof...(Events);
+};
+
+#endif /* SRC_UTILITY_EVENTVARIANT_H_ */
@@ -0,0 +1,232 @@
+/*
+ * FsmPool.h
+ *
+ *  Created on: 15 okt. 2026
+ *      Author: mikaelr
+ */
+
+#ifndef SRC_STATECHART_FSMPOOL_H_
+#define SRC_STATECHART_FSMPOOL_H_
+
+#include "StateChart.h"
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+/**
+ * Pool of FSM instances of one type, for when there are very many of them.
+ * The instances are placed in slabs of fixed size slots. Each slot holds the
+ * FSM object followed by its instance block (level data, state storage and
+ * initial queue storage), so an instance costs no allocation of its own.
+ * All instances share the FsmStaticData of the FSM type.
+ * Instances are referred to by an Id, stable for the lifetime of the
+ * instance. Ids of destroyed instances are reused.
+ */
+template <class FsmDesc>
+class FsmPool
+{
+  public:
+    using Fsm = typename FsmDesc::Fsm;
+    using Event = typename FsmDesc::Event;
+    using Id = std::size_t;
+
+    static const constexpr std::size_t slotAlign = FsmBaseMember::cacheLineSize;
+
+    /**
+     * @param slabSlots Number of instances allocated at a time.
+     */
+    explicit FsmPool(std::size_t slabSlots = 256)
+        : m_slabSlots(slabSlots ? slabSlots : 1),
+          m_fsmBytes(alignUp(sizeof(Fsm))),
+          m_slotSize(m_fsmBytes + alignUp(Fsm::instanceBlockSize()))
+    {
+        static_assert(alignof(Fsm) <= slotAlign,
+                      "FSM alignment exceed the slot alignment.");
+    }
+
+    FsmPool(const FsmPool&) = delete;
+    FsmPool& operator=(const FsmPool&) = delete;
+
+    ~FsmPool()
+    {
+        for (Id id = 0; id < m_live.size(); id++)
+            if (m_live[id])
+                fsm(id)->~Fsm();
+    }
+
+    /**
+     * Construct one instance.
+     * @param args Passed to the FSM constructor.
+     * @return Id of the new instance.
+     */
+    template <class... Args>
+    Id create(Args&&... args)
+    {
+        if (m_free.empty())
+            addSlab();
+        Id id = m_free.back();
+        m_free.pop_back();
+
+        char* slot = slotAddress(id);
+        FsmBaseMember::useBlock(slot + m_fsmBytes, slot, sizeof(Fsm));
+#ifdef STATECHART_NO_EXCEPTIONS
+        new (slot) Fsm(std::forward<Args>(args)...);
+#else
+        try
+        {
+            new (slot) Fsm(std::forward<Args>(args)...);
+        }
+        catch (...)
+        {
+            FsmBaseMember::dropBlock();
+            m_free.push_back(id);
+            throw;
+        }
+#endif
+        // Taken by the instance in the slot, not by one it constructed.
+        const bool unused = FsmBaseMember::dropBlock();
+        assert(!unused && fsm(id)->member().usesBlock(slot + m_fsmBytes));
+        (void)unused;
+        m_live[id] = true;
+        m_size++;
+        return id;
+    }
+
+    // Construct 'n' default instances. Their ids are appended to 'ids'.
+    void createBatch(std::size_t n, std::vector<Id>& ids)
+    {
+        ids.reserve(ids.size() + n);
+        for (std::size_t i = 0; i < n; i++)
+            ids.push_back(create());
+    }
+
+    void destroy(Id id)
+    {
+        assert(live(id));
+        fsm(id)->~Fsm();
+        m_live[id] = false;
+        m_free.push_back(id);
+        m_size--;
+    }
+
+    void destroyBatch(const std::vector<Id>& ids)
+    {
+        for (auto id : ids)
+            destroy(id);
+    }
+
+    bool live(Id id) const
+    {
+        return id < m_live.size() && m_live[id];
+    }
+
+    Fsm& operator[](Id id)
+    {
+        assert(live(id));
+        return *fsm(id);
+    }
+
+    const Fsm& operator[](Id id) const
+    {
+        assert(live(id));
+        return *fsm(id);
+    }
+
+    // Number of live instances.
+    std::size_t size() const
+    {
+        return m_size;
+    }
+
+    // Bytes used by each instance, the FSM object and its instance block.
+    std::size_t slotSize() const
+    {
+        return m_slotSize;
+    }
+
+    /**
+     * Post 'events[i]' to the instance 'ids[i]' for all i. The events are
+     * delivered slab by slab rather than in the given order, so the
+     * instances are visited while their slab is in cache. Within a slab,
+     * and so for each instance, the given order is kept.
+     * Linear in the number of events and slabs.
+     */
+    void dispatchBatch(const std::vector<Id>& ids,
+                       const std::vector<Event>& events)
+    {
+        assert(ids.size() == events.size());
+        // Counting sort of the event indices on the slab.
+        m_slabStart.assign(m_slabBase.size() + 1, 0);
+        for (auto id : ids)
+            m_slabStart[id / m_slabSlots + 1]++;
+        for (std::size_t slab = 1; slab < m_slabStart.size(); slab++)
+            m_slabStart[slab] += m_slabStart[slab - 1];
+        m_order.resize(ids.size());
+        for (std::size_t i = 0; i < ids.size(); i++)
+            m_order[m_slabStart[ids[i] / m_slabSlots]++] = i;
+
+        for (auto i : m_order)
+        {
+            assert(live(ids[i]));
+            fsm(ids[i])->postEvent(events[i]);
+        }
+    }
+
+  private:
+    static constexpr std::size_t alignUp(std::size_t size)
+    {
+        return (size + slotAlign - 1) / slotAlign * slotAlign;
+    }
+
+    char* slotAddress(Id id) const
+    {
+        return m_slabBase[id / m_slabSlots] + id % m_slabSlots * m_slotSize;
+    }
+
+    Fsm* fsm(Id id) const
+    {
+        return reinterpret_cast<Fsm*>(slotAddress(id));
+    }
+
+    void addSlab()
+    {
+        const std::size_t bytes = m_slabSlots * m_slotSize;
+        m_slabs.emplace_back(new char[bytes + slotAlign - 1]);
+        auto addr = reinterpret_cast<std::uintptr_t>(m_slabs.back().get());
+        m_slabBase.push_back(m_slabs.back().get() +
+                             (slotAlign - addr % slotAlign) % slotAlign);
+
+        // Hand out the lowest ids first.
+        const Id first = m_live.size();
+        m_live.resize(first + m_slabSlots, false);
+        for (Id id = first + m_slabSlots; id > first; id--)
+            m_free.push_back(id - 1);
+    }
+
+    const std::size_t m_slabSlots;
+    const std::size_t m_fsmBytes;
+    const std::size_t m_slotSize;
+
+    std::vector<std::unique_ptr<char[]>> m_slabs;
+
+    // Start of each slab, adjusted to 'slotAlign'.
+    std::vector<char*> m_slabBase;
+
+    std::vector<bool> m_live;
+    std::vector<Id> m_free;
+    std::size_t m_size = 0;
+
+    // Scratch space for dispatchBatch.
+    std::vector<std::size_t> m_slabStart;
+    std::vector<std::size_t> m_order;
+};
+
+template <class FsmDesc>
+const constexpr std::size_t FsmPool<FsmDesc>::slotAlign;
+
+#endif /* SRC_STATECHART_FSMPOOL_H_ */
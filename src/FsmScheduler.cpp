@@ -0,0 +1,184 @@
+/*
+ * FsmScheduler.cpp
+ *
+ *  Created on: 15 okt. 2026
+ *      Author: mikaelr
+ */
+
+#include "FsmScheduler.h"
+
+namespace
+{
+// Index of the worker running on this thread, -1 outside the workers.
+thread_local int currentWorker = -1;
+
+// Rounds of stealing before a worker goes to sleep.
+const int stealRounds = 64;
+}
+
+FsmScheduler::FsmScheduler(int threadNo)
+{
+    if (threadNo < 1)
+        threadNo = 1;
+    for (int i = 0; i < threadNo; i++)
+        m_workers.emplace_back(new Worker);
+    for (int i = 0; i < threadNo; i++)
+        m_workers[i]->m_thread = std::thread(&FsmScheduler::workerLoop, this, i);
+}
+
+FsmScheduler::~FsmScheduler()
+{
+    waitIdle();
+    {
+        std::lock_guard<std::mutex> lock(m_sleepLock);
+        m_stop = true;
+    }
+    m_wakeup.notify_all();
+    for (auto& worker : m_workers)
+        worker->m_thread.join();
+}
+
+void
+FsmScheduler::schedule(Actor& actor)
+{
+    int state = actor.m_state.load();
+    for (;;)
+    {
+        if (state == Actor::idle)
+        {
+            if (actor.m_state.compare_exchange_weak(state, Actor::scheduled))
+            {
+                m_busy++;
+                int worker = currentWorker;
+                if (worker < 0)
+                    worker = m_nextWorker++ % m_workers.size();
+                push(worker, &actor);
+                return;
+            }
+        }
+        else if (state == Actor::running)
+        {
+            // The worker running it will schedule it again.
+            if (actor.m_state.compare_exchange_weak(state, Actor::notified))
+                return;
+        }
+        else
+            return;
+    }
+}
+
+void
+FsmScheduler::waitIdle()
+{
+    std::unique_lock<std::mutex> lock(m_sleepLock);
+    m_idle.wait(lock, [this] { return m_busy == 0; });
+}
+
+void
+FsmScheduler::push(int worker, Actor* actor)
+{
+    {
+        Worker& w = *m_workers[worker];
+        std::lock_guard<std::mutex> lock(w.m_lock);
+        w.m_actors.push_back(actor);
+    }
+    // A worker going to sleep increments m_sleeping before it checks the
+    // deques for work, so either it sees this actor or we see it sleeping.
+    if (m_sleeping > 0)
+    {
+        std::lock_guard<std::mutex> lock(m_sleepLock);
+        m_wakeup.notify_one();
+    }
+}
+
+FsmScheduler::Actor*
+FsmScheduler::pop(int worker)
+{
+    Worker& w = *m_workers[worker];
+    std::lock_guard<std::mutex> lock(w.m_lock);
+    if (w.m_actors.empty())
+        return nullptr;
+    Actor* actor = w.m_actors.front();
+    w.m_actors.pop_front();
+    return actor;
+}
+
+FsmScheduler::Actor*
+FsmScheduler::steal(int worker)
+{
+    const int workerNo = static_cast<int>(m_workers.size());
+    for (int i = 1; i < workerNo; i++)
+    {
+        Worker& victim = *m_workers[(worker + i) % workerNo];
+        std::unique_lock<std::mutex> lock(victim.m_lock, std::try_to_lock);
+        if (!lock.owns_lock() || victim.m_actors.empty())
+            continue;
+        Actor* actor = victim.m_actors.back();
+        victim.m_actors.pop_back();
+        return actor;
+    }
+    return nullptr;
+}
+
+bool
+FsmScheduler::hasWork()
+{
+    for (auto& worker : m_workers)
+    {
+        std::lock_guard<std::mutex> lock(worker->m_lock);
+        if (!worker->m_actors.empty())
+            return true;
+    }
+    return false;
+}
+
+void
+FsmScheduler::run(int worker, Actor* actor)
+{
+    actor->m_state = Actor::running;
+    actor->m_run(actor);
+
+    int state = Actor::running;
+    if (!actor->m_state.compare_exchange_strong(state, Actor::idle))
+    {
+        // Events were posted while running. Go to the back of the deque
+        // so the other actors get their turn.
+        actor->m_state = Actor::scheduled;
+        push(worker, actor);
+        return;
+    }
+    if (--m_busy == 0)
+    {
+        std::lock_guard<std::mutex> lock(m_sleepLock);
+        m_idle.notify_all();
+    }
+}
+
+void
+FsmScheduler::workerLoop(int worker)
+{
+    currentWorker = worker;
+    for (;;)
+    {
+        Actor* actor = pop(worker);
+        for (int round = 0; !actor && round < stealRounds; round++)
+        {
+            actor = steal(worker);
+            if (!actor)
+                std::this_thread::yield();
+        }
+        if (actor)
+        {
+            run(worker, actor);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_sleepLock);
+        if (m_stop)
+            return;
+        m_sleeping++;
+        if (!hasWork())
+            m_wakeup.wait(lock);
+        m_sleeping--;
+    }
+}
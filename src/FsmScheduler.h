@@ -0,0 +1,148 @@
+/*
+ * FsmScheduler.h
+ *
+ *  Created on: 15 okt. 2026
+ *      Author: mikaelr
+ */
+
+#ifndef SRC_STATECHART_FSMSCHEDULER_H_
+#define SRC_STATECHART_FSMSCHEDULER_H_
+
+#include "StateChart.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * Run many FSMs on a pool of worker threads. Each FSM is an actor with its
+ * own MpscQueue. Posting an event to an idle actor schedules it on a
+ * worker, which runs processQueue until the queue is empty.
+ *
+ * Each worker has its own deque of scheduled actors. Actors scheduled from
+ * a worker go to its own deque, others are spread over the workers. A
+ * worker without work steals from the others before going to sleep.
+ *
+ * An actor is in at most one deque at a time and only runs on the worker
+ * that took it from there, so it never runs on two threads at once. Its
+ * events are processed in queue order, run to completion.
+ */
+class FsmScheduler
+{
+  public:
+    /**
+     * Scheduling state of one FSM. Base class of FsmActor.
+     */
+    class Actor
+    {
+      public:
+        using RunFkn = void (*)(Actor*);
+
+        explicit Actor(RunFkn run) : m_run(run) {}
+        Actor(const Actor&) = delete;
+        Actor& operator=(const Actor&) = delete;
+
+      private:
+        friend class FsmScheduler;
+
+        enum : int
+        {
+            idle,      // Nothing to do.
+            scheduled, // In a worker deque.
+            running,   // Processing its queue on a worker.
+            notified,  // Running, and more events were posted.
+        };
+
+        RunFkn m_run;
+        std::atomic<int> m_state{idle};
+    };
+
+    // Start 'threadNo' workers.
+    explicit FsmScheduler(int threadNo);
+
+    FsmScheduler(const FsmScheduler&) = delete;
+    FsmScheduler& operator=(const FsmScheduler&) = delete;
+
+    // Wait for all scheduled actors to finish, then stop the workers.
+    ~FsmScheduler();
+
+    /**
+     * Post an event to an actor and make sure it gets to run.
+     * May be called from any thread, including from event handlers.
+     */
+    template <class Fsm, class Ev>
+    void post(Fsm& fsm, Ev&& ev)
+    {
+        fsm.postEvent(std::forward<Ev>(ev));
+        schedule(fsm);
+    }
+
+    // Let 'actor' run, unless it is already scheduled or running.
+    void schedule(Actor& actor);
+
+    // Block until no actor is scheduled or running.
+    void waitIdle();
+
+    int threadNo() const
+    {
+        return static_cast<int>(m_workers.size());
+    }
+
+  private:
+    struct Worker
+    {
+        std::mutex m_lock;
+        std::deque<Actor*> m_actors;
+        std::thread m_thread;
+    };
+
+    void push(int worker, Actor* actor);
+    Actor* pop(int worker);
+    Actor* steal(int worker);
+    bool hasWork();
+    void run(int worker, Actor* actor);
+    void workerLoop(int worker);
+
+    std::vector<std::unique_ptr<Worker>> m_workers;
+
+    // Round robin target for actors scheduled outside the workers.
+    std::atomic<unsigned> m_nextWorker{0};
+
+    // Actors scheduled or running.
+    std::atomic<std::size_t> m_busy{0};
+
+    // Sleeping workers wait on m_wakeup, waitIdle on m_idle.
+    std::mutex m_sleepLock;
+    std::condition_variable m_wakeup;
+    std::condition_variable m_idle;
+    std::atomic<int> m_sleeping{0};
+    bool m_stop = false;
+};
+
+/**
+ * Base class for an FSM run by FsmScheduler. Use instead of FsmBase.
+ * The FsmDesc must use a concurrent queue, like MpscQueue.
+ */
+template <class FsmDesc>
+class FsmActor : public FsmBase<FsmDesc>, public FsmScheduler::Actor
+{
+  public:
+    static_assert(FsmBase<FsmDesc>::Queue::concurrent,
+                  "FsmActor require a concurrent queue.");
+
+    FsmActor() : FsmScheduler::Actor(&FsmActor::runQueue) {}
+
+  private:
+    static void runQueue(FsmScheduler::Actor* actor)
+    {
+        static_cast<FsmActor*>(actor)->processQueue();
+    }
+};
+
+#endif /* SRC_STATECHART_FSMSCHEDULER_H_ */
@@ -0,0 +1,139 @@
+/*
+ * MpscQueue.h
+ *
+ *  Created on: 15 okt. 2026
+ *      Author: mikaelr
+ */
+
+#ifndef SRC_UTILITY_MPSCQUEUE_H_
+#define SRC_UTILITY_MPSCQUEUE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/**
+ * Lock free multi producer, single consumer queue. (Vyukov style linked
+ * list.)
+ * 'push' may be called from any number of threads at once and never
+ * blocks. 'empty', 'front' and 'pop' must only be called from one
+ * consumer thread at a time.
+ * A push is visible to the consumer once the producer has linked its
+ * node. A producer preempted between the two steps of a push delays the
+ * elements after it until it resumes, it does not block other producers.
+ *
+ * Usable as FsmDesc::Queue. The FSM then only enqueues in 'postEvent',
+ * and the consumer thread runs 'processQueue'.
+ */
+template <class El>
+class MpscQueue
+{
+  public:
+    // Tell the FSM that producers may run on other threads.
+    static const constexpr bool concurrent = true;
+
+    // Nodes are allocated per element, no initial storage is used.
+    static constexpr std::size_t bufferBytes(std::size_t)
+    {
+        return 0;
+    }
+
+    MpscQueue() : m_head(&m_stub), m_tail(&m_stub) {}
+
+    // Construct with initial storage from the FSM instance. Not used.
+    MpscQueue(El*, std::size_t) : MpscQueue() {}
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    ~MpscQueue()
+    {
+        while (!empty())
+            pop();
+        if (m_tail != &m_stub)
+            delete m_tail;
+    }
+
+    void push(const El& el)
+    {
+        emplace(el);
+    }
+
+    void push(El&& el)
+    {
+        emplace(std::move(el));
+    }
+
+    // Construct an element in place at the back.
+    template <class... Args>
+    void emplace(Args&&... args)
+    {
+        Node* node = new Node;
+        new (node->storage()) El(std::forward<Args>(args)...);
+        link(node);
+    }
+
+    // Consumer side.
+    bool empty() const
+    {
+        return m_tail->m_next.load(std::memory_order_acquire) == nullptr;
+    }
+
+    El& front()
+    {
+        return *m_tail->m_next.load(std::memory_order_acquire)->value();
+    }
+
+    const El& front() const
+    {
+        return *m_tail->m_next.load(std::memory_order_acquire)->value();
+    }
+
+    // The popped node stays as the new stub until the next pop.
+    void pop()
+    {
+        Node* next = m_tail->m_next.load(std::memory_order_acquire);
+        next->value()->~El();
+        if (m_tail != &m_stub)
+            delete m_tail;
+        m_tail = next;
+    }
+
+  private:
+    struct Node
+    {
+        void* storage()
+        {
+            return &m_storage;
+        }
+        El* value()
+        {
+            return static_cast<El*>(storage());
+        }
+
+        std::atomic<Node*> m_next{nullptr};
+        typename std::aligned_storage<sizeof(El), alignof(El)>::type
+            m_storage;
+    };
+
+    void link(Node* node)
+    {
+        Node* prev = m_head.exchange(node, std::memory_order_acq_rel);
+        prev->m_next.store(node, std::memory_order_release);
+    }
+
+    // Last pushed node. Written by producers.
+    std::atomic<Node*> m_head;
+
+    // Keep producer and consumer data on separate cache lines.
+    char m_padding[64 - sizeof(std::atomic<Node*>)];
+
+    // Node before the front element. Owned by the consumer.
+    Node* m_tail;
+
+    Node m_stub;
+};
+
+#endif /* SRC_UTILITY_MPSCQUEUE_H_ */
@@ -0,0 +1,91 @@
+/*
+ * RegionPool.cpp
+ *
+ *  Created on: 15 okt. 2026
+ *      Author: mikaelr
+ */
+
+#include "RegionPool.h"
+
+RegionPool::RegionPool(int threadNo)
+{
+    for (int i = 0; i < threadNo; i++)
+        m_threads.emplace_back(&RegionPool::workerLoop, this);
+}
+
+RegionPool::~RegionPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_stop = true;
+    }
+    m_wakeup.notify_all();
+    for (auto& thread : m_threads)
+        thread.join();
+}
+
+void
+RegionPool::run(int taskNo, TaskFkn fkn, void* context)
+{
+    if (m_threads.empty() || taskNo < 2)
+    {
+        for (int task = 0; task < taskNo; task++)
+            fkn(context, task);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        // A late worker may still hold the previous batch. Let it see
+        // that all tasks are taken before m_next is reset.
+        while (m_active.load() > 0)
+            std::this_thread::yield();
+        m_taskNo = taskNo;
+        m_fkn = fkn;
+        m_context = context;
+        m_next = 0;
+        m_done = 0;
+        m_batch++;
+    }
+    m_wakeup.notify_all();
+
+    runTasks(taskNo, fkn, context);
+    while (m_done.load(std::memory_order_acquire) < taskNo)
+        std::this_thread::yield();
+}
+
+void
+RegionPool::workerLoop()
+{
+    unsigned batch = 0;
+    for (;;)
+    {
+        int taskNo;
+        TaskFkn fkn;
+        void* context;
+        {
+            std::unique_lock<std::mutex> lock(m_lock);
+            m_wakeup.wait(lock,
+                          [&] { return m_stop || m_batch != batch; });
+            if (m_stop)
+                return;
+            batch = m_batch;
+            taskNo = m_taskNo;
+            fkn = m_fkn;
+            context = m_context;
+            m_active++;
+        }
+        runTasks(taskNo, fkn, context);
+        m_active--;
+    }
+}
+
+void
+RegionPool::runTasks(int taskNo, TaskFkn fkn, void* context)
+{
+    for (int task = m_next++; task < taskNo; task = m_next++)
+    {
+        fkn(context, task);
+        m_done.fetch_add(1, std::memory_order_release);
+    }
+}
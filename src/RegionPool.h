@@ -0,0 +1,71 @@
+/*
+ * RegionPool.h
+ *
+ *  Created on: 15 okt. 2026
+ *      Author: mikaelr
+ */
+
+#ifndef SRC_STATECHART_REGIONPOOL_H_
+#define SRC_STATECHART_REGIONPOOL_H_
+
+#include "StateChart.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Fork/join pool running the orthogonal regions of one event in parallel.
+ * (See FsmBase::setRegionExecutor.) The calling thread runs tasks too, and
+ * run returns when all tasks are done, so it is a barrier per event.
+ *
+ * Waking the workers costs a few microseconds per event. It pays off when
+ * the regions do a lot of work per event. One pool can serve many FSMs,
+ * but run is called by one thread at a time.
+ */
+class RegionPool : public RegionExecutor
+{
+  public:
+    // Start 'threadNo' workers, in addition to the calling thread.
+    explicit RegionPool(int threadNo);
+
+    RegionPool(const RegionPool&) = delete;
+    RegionPool& operator=(const RegionPool&) = delete;
+
+    ~RegionPool();
+
+    void run(int taskNo, TaskFkn fkn, void* context) override;
+
+    int threadNo() const
+    {
+        return static_cast<int>(m_threads.size());
+    }
+
+  private:
+    void workerLoop();
+
+    // Run tasks of the current batch until all are taken.
+    void runTasks(int taskNo, TaskFkn fkn, void* context);
+
+    std::vector<std::thread> m_threads;
+
+    // Guards the batch below and the sleeping workers.
+    std::mutex m_lock;
+    std::condition_variable m_wakeup;
+    unsigned m_batch = 0;
+    int m_taskNo = 0;
+    TaskFkn m_fkn = nullptr;
+    void* m_context = nullptr;
+    bool m_stop = false;
+
+    // Next task to take and number of finished tasks of the batch.
+    std::atomic<int> m_next{0};
+    std::atomic<int> m_done{0};
+
+    // Workers that may still take tasks from a batch.
+    std::atomic<int> m_active{0};
+};
+
+#endif /* SRC_STATECHART_REGIONPOOL_H_ */
@@ -0,0 +1,177 @@
+/*
+ * RingQueue.h
+ *
+ *  Created on: 15 okt. 2026
+ *      Author: mikaelr
+ */
+
+#ifndef SRC_UTILITY_RINGQUEUE_H_
+#define SRC_UTILITY_RINGQUEUE_H_
+
+#include <cstddef>
+#include <new>
+#include <utility>
+
+/**
+ * Queue stored in a power of two ring buffer. Push and pop are O(1)
+ * and never move the other elements. When full, the capacity is doubled
+ * which is amortized O(1). Once the queue has reached the largest burst
+ * size no more allocations are done.
+ * Storage for the initial capacity can be supplied by the caller, e.g.
+ * from the FSM instance block. It is not owned by the queue.
+ */
+template <class El>
+class RingQueue
+{
+  public:
+    // Single threaded. Events are processed by the thread posting them.
+    static const constexpr bool concurrent = false;
+
+    // Smallest power of two >= n.
+    static constexpr std::size_t roundUp(std::size_t n)
+    {
+        std::size_t capacity = 1;
+        while (capacity < n)
+            capacity *= 2;
+        return capacity;
+    }
+
+    // Bytes of initial storage used for 'capacity' elements.
+    static constexpr std::size_t bufferBytes(std::size_t capacity)
+    {
+        return capacity ? roundUp(capacity) * sizeof(El) : 0;
+    }
+
+    RingQueue() = default;
+
+    // Preallocate 'capacity' elements on the heap.
+    explicit RingQueue(std::size_t capacity)
+    {
+        if (capacity)
+            setStorage(allocate(roundUp(capacity)), roundUp(capacity));
+    }
+
+    /**
+     * Start out in 'buffer'.
+     * @param buffer Storage of at least bufferBytes(capacity) bytes.
+     */
+    RingQueue(El* buffer, std::size_t capacity)
+        : m_buffer(capacity ? buffer : nullptr)
+    {
+        if (capacity)
+            setStorage(buffer, roundUp(capacity));
+    }
+
+    RingQueue(const RingQueue&) = delete;
+    RingQueue& operator=(const RingQueue&) = delete;
+
+    ~RingQueue()
+    {
+        while (!empty())
+            pop();
+        release(m_data);
+    }
+
+    void push(const El& el)
+    {
+        emplace(el);
+    }
+
+    void push(El&& el)
+    {
+        emplace(std::move(el));
+    }
+
+    // Construct an element in place at the back.
+    template <class... Args>
+    void emplace(Args&&... args)
+    {
+        if (size() == capacity())
+            grow();
+        new (slot(m_tail)) El(std::forward<Args>(args)...);
+        ++m_tail;
+    }
+
+    void pop()
+    {
+        slot(m_head)->~El();
+        ++m_head;
+    }
+
+    El& front()
+    {
+        return *slot(m_head);
+    }
+    const El& front() const
+    {
+        return *slot(m_head);
+    }
+
+    std::size_t size() const
+    {
+        return m_tail - m_head;
+    }
+    bool empty() const
+    {
+        return m_head == m_tail;
+    }
+    std::size_t capacity() const
+    {
+        return m_data ? m_mask + 1 : 0;
+    }
+
+  private:
+    El* slot(std::size_t pos) const
+    {
+        return m_data + (pos & m_mask);
+    }
+
+    static El* allocate(std::size_t n)
+    {
+        return static_cast<El*>(::operator new(n * sizeof(El)));
+    }
+
+    void release(El* data)
+    {
+        if (data && data != m_buffer)
+            ::operator delete(data);
+    }
+
+    void setStorage(El* data, std::size_t capacity)
+    {
+        m_data = data;
+        m_mask = capacity - 1;
+    }
+
+    // Double the capacity, moving the elements to the start of the new
+    // storage in queue order.
+    void grow()
+    {
+        const std::size_t n = size();
+        const std::size_t newCapacity = n ? 2 * capacity() : 4;
+        El* data = allocate(newCapacity);
+        for (std::size_t i = 0; i < n; i++)
+        {
+            El* el = slot(m_head + i);
+            new (data + i) El(std::move(*el));
+            el->~El();
+        }
+        release(m_data);
+        setStorage(data, newCapacity);
+        m_head = 0;
+        m_tail = n;
+    }
+
+    // Storage, capacity 'm_mask + 1' elements.
+    El* m_data = nullptr;
+    std::size_t m_mask = 0;
+
+    // Free running positions. Element 'pos' is at 'pos & m_mask'.
+    std::size_t m_head = 0;
+    std::size_t m_tail = 0;
+
+    // Caller supplied initial storage.
+    El* m_buffer = nullptr;
+};
+
+#endif /* SRC_UTILITY_RINGQUEUE_H_ */
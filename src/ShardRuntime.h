@@ -0,0 +1,485 @@
+/*
+ * ShardRuntime.h
+ *
+ *  Created on: 15 okt. 2026
+ *      Author: mikaelr
+ */
+
+#ifndef SRC_STATECHART_SHARDRUNTIME_H_
+#define SRC_STATECHART_SHARDRUNTIME_H_
+
+#include "MpscQueue.h"
+#include "SpscRing.h"
+#include "StateChart.h"
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+/**
+ * Thread per core runtime. Each shard is a thread, optionally pinned to a
+ * core, that owns a disjoint set of FSMs and runs its own event loop.
+ * Nothing is shared between shards except the mailboxes:
+ * - Events from shard A to an FSM on shard B go through an SPSC ring
+ *   used only by that pair of shards.
+ * - Events from threads outside the runtime go through a MpscQueue per
+ *   shard.
+ * A shard drains its mailboxes in batches into the queues of the target
+ * FSMs, then runs processQueue on each FSM that got events.
+ *
+ * All FSMs use the same Event type. Their own queue is only touched by
+ * the owning shard, so it does not need to be concurrent.
+ *
+ * A shard with nothing to do polls 'spinNo' more times, then parks
+ * until an event is sent to it.
+ *
+ * The shards stop together, once none of them has events to process and
+ * the rings are empty, so no shard is left sending to one that exited.
+ */
+template <class Event>
+class ShardRuntime
+{
+  public:
+    // Empty polls before an idle shard parks.
+    static const constexpr int spinNo = 64;
+
+    // Longest a parked shard sleeps without being woken.
+    static constexpr std::chrono::milliseconds parkTimeout()
+    {
+        return std::chrono::milliseconds(100);
+    }
+
+    // Location of an FSM in the runtime.
+    struct Address
+    {
+        int shard;
+        int index;
+    };
+
+    /**
+     * @param shardNo      Number of shard threads.
+     * @param pin          Pin shard i to cpu i (modulo the cpu count).
+     * @param ringCapacity Capacity of each shard to shard ring.
+     */
+    explicit ShardRuntime(int shardNo, bool pin = true,
+                          std::size_t ringCapacity = 1024)
+        : m_pin(pin)
+    {
+        assert(shardNo > 0);
+        for (int i = 0; i < shardNo; i++)
+            m_shards.emplace_back(new Shard(i, shardNo, ringCapacity));
+    }
+
+    ShardRuntime(const ShardRuntime&) = delete;
+    ShardRuntime& operator=(const ShardRuntime&) = delete;
+
+    ~ShardRuntime()
+    {
+        stop();
+    }
+
+    int shardNo() const
+    {
+        return static_cast<int>(m_shards.size());
+    }
+
+    /**
+     * Hand 'fsm' to 'shard'. Only allowed before start. The FSM must
+     * outlive the runtime, or at least stop().
+     */
+    template <class Fsm>
+    Address add(int shard, Fsm& fsm)
+    {
+        assert(!m_running);
+        auto& entries = m_shards[shard]->m_fsms;
+        entries.push_back(Entry{&fsm, &Entry::template addEvent<Fsm>,
+                                &Entry::template processQueue<Fsm>, false});
+        return Address{shard, static_cast<int>(entries.size()) - 1};
+    }
+
+    void start()
+    {
+        m_stop = false;
+        m_done = false;
+        for (auto& shard : m_shards)
+            shard->m_stopSeen = false;
+        m_running = true;
+        for (auto& shard : m_shards)
+            shard->m_thread = std::thread(&ShardRuntime::loop, this,
+                                          shard.get());
+    }
+
+    /**
+     * Stop the shards once none of them has events to process, including
+     * events sent by handlers while stopping. Events sent from outside the
+     * runtime after stop() are dropped.
+     */
+    void stop()
+    {
+        if (!m_running)
+            return;
+        m_stop = true;
+        for (auto& shard : m_shards)
+            wake(*shard);
+        for (auto& shard : m_shards)
+            shard->m_thread.join();
+        m_running = false;
+    }
+
+    /**
+     * Send an event to the FSM at 'to'. May be called from any thread.
+     * From a shard thread the event goes through the ring to the target
+     * shard, or directly to the target queue if it is on the same shard.
+     */
+    void send(Address to, Event ev)
+    {
+        Shard* self = currentShard();
+        if (!self)
+        {
+            m_shards[to.shard]->m_external.push(
+                Message{to.index, std::move(ev)});
+            wake(*m_shards[to.shard]);
+            return;
+        }
+        if (to.shard == self->m_id)
+        {
+            self->deliver(to.index, std::move(ev));
+            return;
+        }
+
+        // Keep the order behind earlier events waiting for space. A failed
+        // push leaves 'msg' untouched. The target is woken after the poll.
+        Message msg{to.index, std::move(ev)};
+        auto& pending = self->m_pending[to.shard];
+        if (!pending.empty() || !ring(self->m_id, to.shard).push(std::move(msg)))
+            pending.push_back(std::move(msg));
+        else
+            self->m_sent[to.shard] = true;
+    }
+
+    // Index of the shard running on this thread, or -1.
+    static int currentShardId()
+    {
+        Shard* self = currentShard();
+        return self ? self->m_id : -1;
+    }
+
+  private:
+    struct Message
+    {
+        int index;
+        Event ev;
+    };
+
+    // Type erased FSM owned by a shard.
+    struct Entry
+    {
+        template <class Fsm>
+        static void addEvent(void* fsm, Event&& ev)
+        {
+            static_cast<Fsm*>(fsm)->addEvent(std::move(ev));
+        }
+
+        template <class Fsm>
+        static void processQueue(void* fsm)
+        {
+            static_cast<Fsm*>(fsm)->processQueue();
+        }
+
+        void* m_fsm;
+        void (*m_addEvent)(void*, Event&&);
+        void (*m_processQueue)(void*);
+
+        // Got events since it last ran.
+        bool m_ready;
+    };
+
+    struct Shard
+    {
+        Shard(int id, int shardNo, std::size_t ringCapacity)
+            : m_id(id), m_pending(shardNo), m_sent(shardNo, false)
+        {
+            // Ring i carries events from shard i to this shard.
+            for (int i = 0; i < shardNo; i++)
+                m_inbox.emplace_back(new SpscRing<Message>(ringCapacity));
+        }
+
+        // Mark the shard busy while it has events. The epoch is odd while
+        // busy and changes on every switch, see 'allIdle'.
+        void setBusy(bool busy)
+        {
+            const unsigned epoch = m_epoch.load(std::memory_order_relaxed);
+            if ((epoch & 1) != unsigned(busy))
+                m_epoch.store(epoch + 1);
+        }
+
+        void deliver(int index, Event&& ev)
+        {
+            Entry& entry = m_fsms[index];
+            entry.m_addEvent(entry.m_fsm, std::move(ev));
+            if (!entry.m_ready)
+            {
+                entry.m_ready = true;
+                m_ready.push_back(index);
+            }
+        }
+
+        const int m_id;
+        std::vector<Entry> m_fsms;
+        std::vector<std::unique_ptr<SpscRing<Message>>> m_inbox;
+        MpscQueue<Message> m_external;
+
+        // Events to other shards waiting for ring space, per target shard.
+        std::vector<std::vector<Message>> m_pending;
+
+        // Shards sent to during this poll, to wake once it is done.
+        std::vector<char> m_sent;
+
+        // FSMs with events to process.
+        std::vector<int> m_ready;
+
+        // Set while the shard sleeps in 'park'. 'm_wakeup' is guarded by
+        // 'm_parkMutex'.
+        std::atomic<bool> m_parked{false};
+        bool m_wakeup = false;
+        std::mutex m_parkMutex;
+        std::condition_variable m_wakeCond;
+
+        // Written by the shard only, read by the others while stopping.
+        std::atomic<unsigned> m_epoch{0};
+
+        // Found nothing to do after stop() was called.
+        std::atomic<bool> m_stopSeen{false};
+
+        std::thread m_thread;
+    };
+
+    static Shard*& currentShard()
+    {
+        static thread_local Shard* shard = nullptr;
+        return shard;
+    }
+
+    SpscRing<Message>& ring(int from, int to)
+    {
+        return *m_shards[to]->m_inbox[from];
+    }
+
+    void pin(int shardId)
+    {
+#ifdef __linux__
+        const unsigned cpuNo = std::thread::hardware_concurrency();
+        if (!m_pin || cpuNo == 0)
+            return;
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(shardId % cpuNo, &cpus);
+        pthread_setaffinity_np(pthread_self(), sizeof cpus, &cpus);
+#else
+        (void)shardId;
+#endif
+    }
+
+    // Move waiting events into the rings. Return true if any moved.
+    bool flushPending(Shard& self)
+    {
+        bool moved = false;
+        for (int to = 0; to < shardNo(); to++)
+        {
+            auto& pending = self.m_pending[to];
+            std::size_t sent = 0;
+            while (sent < pending.size() &&
+                   ring(self.m_id, to).push(std::move(pending[sent])))
+                sent++;
+            pending.erase(pending.begin(), pending.begin() + sent);
+            if (sent > 0)
+                self.m_sent[to] = true;
+            moved = moved || sent > 0;
+        }
+        return moved;
+    }
+
+    bool hasInput(const Shard& self) const
+    {
+        for (const auto& inbox : self.m_inbox)
+            if (!inbox->empty())
+                return true;
+        return !self.m_external.empty() || hasPending(self);
+    }
+
+    // One pass of the event loop. Return true if anything was done.
+    bool poll(Shard& self)
+    {
+        if (!hasInput(self))
+            return false;
+        self.setBusy(true);
+
+        std::size_t received = 0;
+        for (auto& inbox : self.m_inbox)
+            received += inbox->consume([&self](Message&& msg) {
+                self.deliver(msg.index, std::move(msg.ev));
+            });
+        while (!self.m_external.empty())
+        {
+            Message& msg = self.m_external.front();
+            self.deliver(msg.index, std::move(msg.ev));
+            self.m_external.pop();
+            received++;
+        }
+
+        // Handlers may send to FSMs on this shard, which adds to m_ready.
+        for (std::size_t i = 0; i < self.m_ready.size(); i++)
+        {
+            Entry& entry = self.m_fsms[self.m_ready[i]];
+            entry.m_ready = false;
+            entry.m_processQueue(entry.m_fsm);
+        }
+        const bool ran = !self.m_ready.empty();
+        self.m_ready.clear();
+
+        const bool moved = flushPending(self);
+        wakeSent(self);
+        if (!hasPending(self))
+            self.setBusy(false);
+        return moved || received > 0 || ran;
+    }
+
+    /**
+     * Wake 'shard' if it is parked. Called after an event is made visible
+     * to it. Either the event is seen by the check in 'park', or the flag
+     * set there is seen here. Only the first waker clears the flag and
+     * notifies.
+     */
+    void wake(Shard& shard)
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!shard.m_parked.load(std::memory_order_relaxed) ||
+            !shard.m_parked.exchange(false, std::memory_order_relaxed))
+            return;
+        {
+            std::lock_guard<std::mutex> lock(shard.m_parkMutex);
+            shard.m_wakeup = true;
+        }
+        shard.m_wakeCond.notify_one();
+    }
+
+    // Wake the shards sent to during the poll, with one fence for all.
+    void wakeSent(Shard& self)
+    {
+        for (int to = 0; to < shardNo(); to++)
+        {
+            if (!self.m_sent[to])
+                continue;
+            self.m_sent[to] = false;
+            wake(*m_shards[to]);
+        }
+    }
+
+    // Sleep until woken by 'wake', or at most 'parkTimeout'.
+    void park(Shard& self)
+    {
+        std::unique_lock<std::mutex> lock(self.m_parkMutex);
+        self.m_wakeup = false;
+        self.m_parked.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!hasInput(self) && !m_done)
+            self.m_wakeCond.wait_for(lock, parkTimeout(),
+                                     [&self] { return self.m_wakeup; });
+        self.m_parked.store(false, std::memory_order_relaxed);
+    }
+
+    bool hasPending(const Shard& self) const
+    {
+        for (const auto& pending : self.m_pending)
+            if (!pending.empty())
+                return true;
+        return false;
+    }
+
+    /**
+     * True if no shard has events and no ring holds any. Each shard is
+     * idle, with an even epoch, and has polled since stop() was called.
+     * An event in flight while the rings are read has a busy sender or
+     * receiver, which changes its epoch between the two reads.
+     */
+    bool allIdle() const
+    {
+        std::vector<unsigned> epochs;
+        for (const auto& shard : m_shards)
+        {
+            epochs.push_back(shard->m_epoch.load());
+            if (!shard->m_stopSeen || (epochs.back() & 1) != 0)
+                return false;
+        }
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        for (const auto& shard : m_shards)
+            for (const auto& inbox : shard->m_inbox)
+                if (!inbox->empty())
+                    return false;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        for (std::size_t i = 0; i < m_shards.size(); i++)
+            if (m_shards[i]->m_epoch.load() != epochs[i])
+                return false;
+        return true;
+    }
+
+    void loop(Shard* self)
+    {
+        currentShard() = self;
+        pin(self->m_id);
+        int idleNo = 0;
+        while (!m_done)
+        {
+            // Read before polling, so events sent before stop() are seen.
+            const bool stopping = m_stop;
+            if (poll(*self))
+            {
+                idleNo = 0;
+                continue;
+            }
+            if (stopping && !hasPending(*self))
+            {
+                self->m_stopSeen = true;
+                if (allIdle())
+                {
+                    m_done = true;
+                    for (auto& shard : m_shards)
+                        wake(*shard);
+                    break;
+                }
+            }
+
+            // Events waiting for ring space are retried, not woken for.
+            if (++idleNo < spinNo || hasPending(*self))
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            park(*self);
+            idleNo = 0;
+        }
+        currentShard() = nullptr;
+    }
+
+    std::vector<std::unique_ptr<Shard>> m_shards;
+    const bool m_pin;
+    bool m_running = false;
+    std::atomic<bool> m_stop{false};
+
+    // Set by the shard finding all shards idle. Every shard then exits.
+    std::atomic<bool> m_done{false};
+};
+
+#endif /* SRC_STATECHART_SHARDRUNTIME_H_ */
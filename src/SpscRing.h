@@ -0,0 +1,146 @@
+/*
+ * SpscRing.h
+ *
+ *  Created on: 15 okt. 2026
+ *      Author: mikaelr
+ */
+
+#ifndef SRC_UTILITY_SPSCRING_H_
+#define SRC_UTILITY_SPSCRING_H_
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/**
+ * Bounded lock free single producer, single consumer ring.
+ * One thread pushes, another consumes. Each side keeps a cached copy of
+ * the other side's index and only reads the shared one when the cache
+ * says the ring is full or empty.
+ * The consumer takes elements in batches with 'consume', publishing the
+ * new head once per batch.
+ */
+template <class El>
+class SpscRing
+{
+  public:
+    // The capacity is rounded up to a power of two.
+    explicit SpscRing(std::size_t capacity)
+    {
+        std::size_t size = 1;
+        while (size < capacity)
+            size *= 2;
+        m_slots.reset(new Slot[size]);
+        m_mask = size - 1;
+    }
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    ~SpscRing()
+    {
+        consume([](El&&) {});
+    }
+
+    std::size_t capacity() const
+    {
+        return m_mask + 1;
+    }
+
+    // Producer side. Return false if the ring is full.
+    bool push(const El& el)
+    {
+        return emplace(el);
+    }
+
+    bool push(El&& el)
+    {
+        return emplace(std::move(el));
+    }
+
+    template <class... Args>
+    bool emplace(Args&&... args)
+    {
+        const std::size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_headCache > m_mask)
+        {
+            m_headCache = m_head.load(std::memory_order_acquire);
+            if (tail - m_headCache > m_mask)
+                return false;
+        }
+        new (m_slots[tail & m_mask].storage()) El(std::forward<Args>(args)...);
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side. Other threads get a snapshot.
+    bool empty() const
+    {
+        return m_head.load(std::memory_order_acquire) ==
+               m_tail.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Pass up to 'maxNo' elements to 'fkn' as rvalues, oldest first.
+     * @return The number of elements consumed.
+     */
+    template <class Fkn>
+    std::size_t consume(Fkn&& fkn, std::size_t maxNo = ~std::size_t(0))
+    {
+        const std::size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tailCache)
+        {
+            m_tailCache = m_tail.load(std::memory_order_acquire);
+            if (head == m_tailCache)
+                return 0;
+        }
+        std::size_t count = m_tailCache - head;
+        if (count > maxNo)
+            count = maxNo;
+        for (std::size_t i = 0; i < count; i++)
+        {
+            El* el = m_slots[(head + i) & m_mask].value();
+            fkn(std::move(*el));
+            el->~El();
+        }
+        m_head.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+  private:
+    struct Slot
+    {
+        void* storage()
+        {
+            return &m_storage;
+        }
+        El* value()
+        {
+            return static_cast<El*>(storage());
+        }
+        typename std::aligned_storage<sizeof(El), alignof(El)>::type
+            m_storage;
+    };
+
+    std::unique_ptr<Slot[]> m_slots;
+    std::size_t m_mask;
+
+    // Keep producer and consumer data on separate cache lines.
+    char m_padding0[64];
+
+    // Next slot to write and the last head seen. Owned by the producer.
+    std::atomic<std::size_t> m_tail{0};
+    std::size_t m_headCache = 0;
+
+    char m_padding1[64 - sizeof(std::atomic<std::size_t>) -
+                    sizeof(std::size_t)];
+
+    // Next slot to read and the last tail seen. Owned by the consumer.
+    std::atomic<std::size_t> m_head{0};
+    std::size_t m_tailCache = 0;
+};
+
+#endif /* SRC_UTILITY_SPSCRING_H_ */
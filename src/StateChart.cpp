@@ -7,197 +7,648 @@
 
 #include "StateChart.h"
 
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <utility>
+
+const constexpr int FsmStaticData::nullStateId;
+const constexpr int FsmStaticData::lcaTableLimit;
+const constexpr int FsmStaticData::lcaLevelLimit;
+const constexpr size_t FsmBaseMember::cacheLineSize;
+const constexpr int FsmBaseMember::activeWordBits;
+const constexpr int FsmBaseMember::localTransitionFlag;
+
+namespace
+{
+// Report an invalid state setup.
+void
+setupError(const char* what)
+{
+#ifdef STATECHART_NO_EXCEPTIONS
+    std::fprintf(stderr, "StateChart: %s\n", what);
+    std::abort();
+#else
+    throw std::runtime_error(what);
+#endif
+}
+}
+
 void
-FsmStaticData::addStateBase(int stateId, int parentId, size_t size,
-                            CreateFkn fkn)
+FsmStaticBuilder::addStateBase(int stateId, int parentId,
+                               const StateInfo& info, int region)
 {
     int level = 0;
     if (stateId != parentId)
     {
-        auto parent = findState(parentId);
-        level = parent->m_level + 1;
+        // The parent sets the level, so it must be added first.
+        if (parentId < 0 || parentId >= static_cast<int>(m_states.size()) ||
+            !m_states[parentId].valid())
+            setupError("Parent state not added before its sub state.");
+        level = m_states[parentId].m_level + 1;
+    }
+    m_levelNo = std::max(m_levelNo, level + 1);
+
+    m_states[stateId] = info;
+    m_states[stateId].m_parentId = parentId;
+    m_states[stateId].m_level = level;
+    m_states[stateId].m_region = level > 0 ? region : -1;
+}
+
+FsmStaticData
+FsmStaticBuilder::finalize()
+{
+    const int stateNo = static_cast<int>(m_states.size());
+    const int levelNo = m_levelNo;
+
+    m_paths.resize(stateNo * levelNo);
+    FsmStaticData::planPaths(m_states.data(), stateNo, levelNo,
+                             m_paths.data());
+
+    const int regionNo = FsmStaticData::countRegions(m_states.data(), stateNo);
+    m_regions.assign(regionNo, FsmStaticData::RegionInfo());
+    FsmStaticData::planRegions(m_states.data(), stateNo, m_regions.data());
+    if (!FsmStaticData::regionsValid(m_states.data(), stateNo,
+                                     m_regions.data()))
+        setupError("Mixed or empty regions.");
+    FsmStaticData::planHistory(m_states.data(), stateNo);
+    if (!FsmStaticData::historyValid(m_states.data(), stateNo))
+        setupError("History kept with orthogonal regions.");
+    if (!FsmStaticData::choicesValid(m_states.data(), stateNo))
+        setupError("Choice with a parent or sub states.");
+
+    int frameNo = 0;
+    const size_t storageSize = FsmStaticData::planOffsets(
+        m_states.data(), stateNo, levelNo, m_regions.data(), &frameNo);
+
+    m_lca.clear();
+    if (FsmStaticData::hasLcaTable(stateNo, levelNo))
+    {
+        m_lca.resize(stateNo * stateNo);
+        FsmStaticData::planLca(m_states.data(), stateNo, levelNo,
+                               m_paths.data(), m_lca.data());
+    }
+
+    m_firstHandler.resize(stateNo * m_eventIdNo);
+    FsmStaticData::planDispatch(m_states.data(), stateNo, levelNo,
+                                m_paths.data(), m_eventIdNo,
+                                m_firstHandler.data());
+
+    return FsmStaticData(m_states.data(), stateNo, levelNo, storageSize,
+                         m_paths.data(),
+                         m_lca.empty() ? nullptr : m_lca.data(), m_eventIdNo,
+                         m_firstHandler.data(), m_regions.data(), regionNo,
+                         frameNo);
+}
+
+thread_local FsmBaseMember::NextBlock FsmBaseMember::s_nextBlock = {
+    nullptr, nullptr, nullptr};
+thread_local int* FsmBaseMember::s_regionNext = nullptr;
+
+struct FsmBaseMember::RegionTask
+{
+    FsmBaseMember* m_member;
+    const StateInfo* m_sub;
+    int m_eventId;
+    const void* m_event;
+    Collector m_collector;
+    int m_next;
+    bool m_handled;
+};
+
+struct FsmBaseMember::RegionTasks
+{
+    RegionExecutor* m_executor;
+
+    // One task per region. No state has more regions than the chart.
+    std::vector<RegionTask> m_tasks;
+
+    // Transitions of nested regions, 'orthogonalNo' per task.
+    std::vector<Pending> m_pending;
+};
+
+// Two buffers, so the payload being moved into its target stays in place
+// while the target's constructor requests a transition with a payload.
+struct FsmBaseMember::PayloadSlot
+{
+    struct Buffer
+    {
+        std::unique_ptr<char[]> m_data;
+        size_t m_capacity;
+        PayloadMakeFkn m_make;
+        PayloadDestroyFkn m_destroy;
+    };
+
+    // The payload of m_payloadTarget.
+    Buffer m_next;
+
+    // The payload consumed by the entry in progress.
+    Buffer m_entering;
+};
+
+size_t
+FsmBaseMember::blockSizeFor(const FsmStaticData& setup, size_t queueBytes)
+{
+    return FsmStaticData::alignUp(setup.frameNo() * sizeof(LevelData)) +
+           FsmStaticData::alignUp(setup.orthogonalNo() * sizeof(Pending)) +
+           FsmStaticData::alignUp(setup.historyNo() * sizeof(StateInfo*)) +
+           FsmStaticData::alignUp(activeWordNo(setup.stateNo()) *
+                                  sizeof(ActiveWord)) +
+           FsmStaticData::alignUp(setup.storageSize()) + queueBytes;
+}
+
+FsmBaseMember::FsmBaseMember(const FsmStaticData& setup, size_t queueBytes)
+    : m_setup(setup)
+{
+    const int frameNo = m_setup.frameNo();
+    m_blockSize = blockSizeFor(m_setup, queueBytes);
+
+    char* block = nullptr;
+    const auto self = reinterpret_cast<std::uintptr_t>(this);
+    if (s_nextBlock.m_block &&
+        self >= reinterpret_cast<std::uintptr_t>(s_nextBlock.m_ownerBegin) &&
+        self < reinterpret_cast<std::uintptr_t>(s_nextBlock.m_ownerEnd))
+    {
+        block = s_nextBlock.m_block;
+        s_nextBlock.m_block = nullptr;
+    }
+    if (!block)
+    {
+        m_allocation.reset(new char[m_blockSize + cacheLineSize - 1]);
+        auto addr = reinterpret_cast<std::uintptr_t>(m_allocation.get());
+        block = m_allocation.get() +
+                ((cacheLineSize - addr % cacheLineSize) % cacheLineSize);
+    }
+
+    m_frames = reinterpret_cast<LevelData*>(block);
+    for (int frame = 0; frame < frameNo; frame++)
+        new (&m_frames[frame]) LevelData{nullptr, nullptr};
+    block += FsmStaticData::alignUp(frameNo * sizeof(LevelData));
+    m_pending = reinterpret_cast<Pending*>(block);
+    block += FsmStaticData::alignUp(m_setup.orthogonalNo() * sizeof(Pending));
+    m_history = reinterpret_cast<const StateInfo**>(block);
+    for (int i = 0; i < m_setup.historyNo(); i++)
+        m_history[i] = nullptr;
+    block += FsmStaticData::alignUp(m_setup.historyNo() * sizeof(StateInfo*));
+    m_active = reinterpret_cast<ActiveWord*>(block);
+    m_activeWordNo = activeWordNo(m_setup.stateNo());
+    for (int w = 0; w < m_activeWordNo; w++)
+        m_active[w] = 0;
+    m_storage =
+        block + FsmStaticData::alignUp(m_activeWordNo * sizeof(ActiveWord));
+}
+
+FsmBaseMember::~FsmBaseMember()
+{
+    cleanup();
+    dropPayload();
+}
+
+void*
+FsmBaseMember::payloadStore(size_t size) STATECHART_NOEXCEPT
+{
+    dropPayload();
+    if (!m_payload)
+        m_payload.reset(new PayloadSlot{{nullptr, 0, nullptr, nullptr},
+                                        {nullptr, 0, nullptr, nullptr}});
+    PayloadSlot::Buffer& next = m_payload->m_next;
+    if (next.m_capacity < size)
+    {
+        next.m_data.reset(new char[size]);
+        next.m_capacity = size;
     }
-    while (static_cast<int>(m_objectSizes.size()) <= level)
-        m_objectSizes.push_back(0);
+    return next.m_data.get();
+}
+
+void
+FsmBaseMember::setPayload(int target, PayloadMakeFkn make,
+                          PayloadDestroyFkn destroy) noexcept
+{
+    assert(!m_parallel);
+    m_payload->m_next.m_make = make;
+    m_payload->m_next.m_destroy = destroy;
+    m_payloadTarget = target;
+}
 
-    if (m_objectSizes[level] < size)
-        m_objectSizes[level] = size;
+void
+FsmBaseMember::dropPayload() noexcept
+{
+    if (m_payloadTarget == FsmStaticData::nullStateId)
+        return;
+    m_payload->m_next.m_destroy(m_payload->m_next.m_data.get());
+    m_payloadTarget = FsmStaticData::nullStateId;
+}
 
-    m_states[stateId] = StateInfo(parentId, level, fkn);
+void
+FsmBaseMember::setRegionExecutor(RegionExecutor* executor)
+{
+    const int orthogonalNo = m_setup.orthogonalNo();
+    if (!executor || orthogonalNo == 0)
+    {
+        m_regionTasks.reset();
+        return;
+    }
+    m_regionTasks.reset(new RegionTasks{
+        executor, std::vector<RegionTask>(orthogonalNo),
+        std::vector<Pending>(orthogonalNo * orthogonalNo)});
 }
 
 void
-FsmBaseMember::possiblyDoTransition(FsmBaseBase* fbb)
+FsmBaseMember::possiblyDoTransition(FsmBaseBase* fbb) STATECHART_NOEXCEPT
 {
+    if (m_pendingNo > 0)
+    {
+        const int next = m_nextState;
+        for (int i = 0; i < m_pendingNo; i++)
+        {
+            // Skip regions exited by an earlier transition.
+            if (!isActive(m_pending[i].m_source))
+                continue;
+            m_nextState = m_pending[i].m_target;
+            while (m_nextState != FsmStaticData::nullStateId)
+            {
+                const int target = m_nextState;
+                m_nextState = FsmStaticData::nullStateId;
+                applyTransition(target, fbb);
+            }
+        }
+        m_pendingNo = 0;
+        m_nextState = next;
+    }
+
     while (m_nextState != FsmStaticData::nullStateId)
     {
-        auto i = m_setup.findState(m_nextState);
+        const int target = m_nextState;
         m_nextState = FsmStaticData::nullStateId;
-        if (i)
+        applyTransition(target, fbb);
+    }
+
+    // The payload target was not entered.
+    dropPayload();
+}
+
+// A transition already keeps the active states on the target path, except
+// for an active target without active sub states. It is exited and
+// entered again, unless the transition is local.
+void
+FsmBaseMember::applyTransition(int target,
+                               FsmBaseBase* fsm) STATECHART_NOEXCEPT
+{
+    const bool local = (target & localTransitionFlag) != 0;
+    const StateInfo* info =
+        choose(m_setup.findState(target & ~localTransitionFlag), fsm);
+    if (!info)
+        return;
+    if (local && isActive(info))
+    {
+        if (!hasRegions())
         {
-            doTransition(i, fbb);
+            if (info == m_currentInfo)
+                return;
         }
+        else if (info->m_regionNo == 0 ||
+                 !stateInfo(m_setup.region(info, 0).m_frame))
+            return;
     }
+    doTransition(info, fsm);
 }
 
 void
-FsmBaseMember::doEntry(const StateInfo* newState, FsmBaseBase* fsm)
+FsmBaseMember::doEntry(const StateInfo* newState,
+                       FsmBaseBase* fsm) STATECHART_NOEXCEPT
 {
-    int level = newState->m_level;
-    auto& frame = m_stackFrames[level];
-    auto& storeVec = frame.m_stateStorage;
-    frame.m_activeState.reset(newState->m_maker(storeVec.get(), fsm));
-};
+    const int id = m_setup.findState(newState);
+    m_active[id / activeWordBits] |= ActiveWord(1) << (id % activeWordBits);
+    auto& frame = m_frames[newState->m_frame];
+    frame.m_stateInfo = newState;
+    char* store = m_storage + newState->m_offset;
+    if (id == m_payloadTarget)
+    {
+        // Detached first, the constructor may set the next payload.
+        m_payloadTarget = FsmStaticData::nullStateId;
+        std::swap(m_payload->m_next, m_payload->m_entering);
+        PayloadSlot::Buffer& entering = m_payload->m_entering;
+        frame.m_activeState =
+            entering.m_make(entering.m_data.get(), store, fsm);
+        entering.m_destroy(entering.m_data.get());
+    }
+    else
+        frame.m_activeState = newState->m_maker(store, fsm);
+}
 
 void
-FsmBaseMember::doExit(const StateInfo* currState)
+FsmBaseMember::doExit(const StateInfo* currState,
+                      const StateInfo* leaf) STATECHART_NOEXCEPT
 {
-    m_stackFrames[currState->m_level].m_activeState.reset(nullptr);
+    if (currState->m_history >= 0)
+        m_history[currState->m_history] = leaf;
+    auto& frame = m_frames[currState->m_frame];
+    currState->m_destroy(frame.m_activeState);
+    frame.m_activeState = nullptr;
+    frame.m_stateInfo = nullptr;
+    const int id = m_setup.findState(currState);
+    m_active[id / activeWordBits] &= ~(ActiveWord(1) << (id % activeWordBits));
+    if (m_exitObserver)
+        m_exitObserver->exited(id);
 }
 
 void
-FsmBaseMember::setupTransition(const StateInfo* nextInfo, FsmBaseBase* fsm)
+FsmBaseMember::setupTransition(const StateInfo* nextInfo,
+                               FsmBaseBase* fsm) STATECHART_NOEXCEPT
 {
-    // target lvl down to src.
-    const int targetLevel = nextInfo->m_level;
-    stateInfo(targetLevel) = nextInfo;
-    while (nextInfo->m_level > 0)
+    if (hasRegions())
     {
-        nextInfo = m_setup.findState(nextInfo->m_parentId);
-        stateInfo(nextInfo->m_level) = nextInfo;
+        enterPath(nextInfo, 0, fsm);
+        updateCurrent();
+        return;
     }
 
-    m_currentInfo = stateInfo(0);
-    doEntry(m_currentInfo, fsm);
-    // Reached same level state. Start entry up again.
-    while (m_currentInfo->m_level < targetLevel)
+    // Enter along the root path of the target.
+    for (int level = 0; level <= nextInfo->m_level; level++)
     {
-        m_currentInfo = stateInfo(m_currentInfo->m_level + 1);
+        m_currentInfo = m_setup.ancestor(nextInfo, level);
         doEntry(m_currentInfo, fsm);
     }
 }
 
 // Precondition: both nextInfo and m_currentInfo point to a valid info.
 void
-FsmBaseMember::doTransition(const StateInfo* nextInfo, FsmBaseBase* fsm)
+FsmBaseMember::doTransition(const StateInfo* nextInfo,
+                            FsmBaseBase* fsm) STATECHART_NOEXCEPT
 {
-    auto targetLevel = nextInfo->m_level;
+    if (hasRegions())
+    {
+        doRegionTransition(nextInfo, fsm);
+        return;
+    }
 
     // Special case: Transition to self should give exit/entry action
     if (m_currentInfo == nextInfo)
     {
-        doExit(m_currentInfo);
+        doExit(m_currentInfo, m_currentInfo);
         doEntry(m_currentInfo, fsm);
         return;
     }
 
-    // src level down to nextInfos level.
-    while (m_currentInfo->m_level > nextInfo->m_level)
+    // Levels up to 'common' are shared between source and target and
+    // stay active. Everything above is exited and then entered again
+    // along the root path of the target.
+    const int common = m_setup.commonLevel(m_currentInfo, nextInfo);
+
+    const StateInfo* leaf = m_currentInfo;
+    for (int level = m_currentInfo->m_level; level > common; level--)
     {
-        doExit(m_currentInfo);
-        m_currentInfo = stateInfo(m_currentInfo->m_level - 1);
+        m_currentInfo = stateInfo(level);
+        doExit(m_currentInfo, leaf);
     }
+    if (common >= 0)
+        m_currentInfo = stateInfo(common);
 
-    // nextInfos level down to src level.
-    while (nextInfo->m_level > m_currentInfo->m_level)
+    for (int level = common + 1; level <= nextInfo->m_level; level++)
     {
-        stateInfo(nextInfo->m_level) = nextInfo;
-        nextInfo = m_setup.findState(nextInfo->m_parentId);
+        m_currentInfo = m_setup.ancestor(nextInfo, level);
+        doEntry(m_currentInfo, fsm);
     }
+}
 
-    // Invariant: nextInfo->m_level == m_currentInfo->m_level.
-    // both level down. (same level)
-    int level = m_currentInfo->m_level;
-    while (nextInfo != m_currentInfo && level > 0)
+// The target path is entered below its deepest active state. A target
+// that is already active keeps its object, like in charts without regions,
+// unless it has no active sub states. Orthogonal regions outside the
+// target path are not touched.
+void
+FsmBaseMember::doRegionTransition(const StateInfo* nextInfo,
+                                  FsmBaseBase* fsm) STATECHART_NOEXCEPT
+{
+    if (isActive(nextInfo))
     {
-        doExit(m_currentInfo);
-        stateInfo(level) = nextInfo;
-        level--;
-        m_currentInfo = stateInfo(level);
-        nextInfo = m_setup.findState(nextInfo->m_parentId);
+        if (!exitSubStates(nextInfo))
+        {
+            doExit(nextInfo, nextInfo);
+            doEntry(nextInfo, fsm);
+        }
+        enterRegions(nextInfo, fsm, 0, nextInfo->m_regionNo);
+        updateCurrent();
+        return;
     }
 
-    // No root state, handle transition at level 0.
-    if (nextInfo != m_currentInfo)
+    // Find the first state to enter, below the deepest active ancestor.
+    const StateInfo* first = nextInfo;
+    while (first->m_level > 0)
     {
-        doExit(m_currentInfo);
-        stateInfo(0) = nextInfo;
-        m_currentInfo = nextInfo;
-        doEntry(m_currentInfo, fsm);
+        const StateInfo* parent = m_setup.findState(first->m_parentId);
+        if (isActive(parent))
+            break;
+        first = parent;
     }
 
-    // Done with all exists. Possibly start going up again.
-    // Invariant: m_currentInfo point to a state we have already entered.
-    // prior to entering the while loop.
-    while (m_currentInfo->m_level < targetLevel)
+    // Replace its active sibling.
+    if (const StateInfo* sibling = stateInfo(first->m_frame))
+        exitTree(sibling);
+    enterPath(nextInfo, first->m_level, fsm);
+    updateCurrent();
+}
+
+void
+FsmBaseMember::enterPath(const StateInfo* target, int level,
+                         FsmBaseBase* fsm) STATECHART_NOEXCEPT
+{
+    if (level == target->m_level)
     {
-        m_currentInfo = stateInfo(m_currentInfo->m_level + 1);
-        doEntry(m_currentInfo, fsm);
+        doEntry(target, fsm);
+        if (target->m_orthogonal)
+            enterRegions(target, fsm, 0, target->m_regionNo);
+        return;
     }
+    const StateInfo* si = m_setup.ancestor(target, level);
+    doEntry(si, fsm);
+
+    // Regions are entered in order, the one on the path in its turn.
+    const int pathRegion = m_setup.ancestor(target, level + 1)->m_region;
+    enterRegions(si, fsm, 0, pathRegion);
+    enterPath(target, level + 1, fsm);
+    enterRegions(si, fsm, pathRegion + 1, si->m_regionNo);
 }
 
 void
-FsmBaseMember::cleanup()
+FsmBaseMember::enterRegions(const StateInfo* si, FsmBaseBase* fsm, int first,
+                            int last) STATECHART_NOEXCEPT
 {
-    if (!m_currentInfo)
+    if (!si->m_orthogonal)
         return;
+    for (int r = first; r < last; r++)
+    {
+        const StateInfo* initial =
+            m_setup.findState(m_setup.region(si, r).m_initial);
+        doEntry(initial, fsm);
+        enterRegions(initial, fsm, 0, initial->m_regionNo);
+    }
+}
 
-    while (m_currentInfo->m_level > 0)
+const FsmBaseMember::StateInfo*
+FsmBaseMember::exitSubStates(const StateInfo* si) STATECHART_NOEXCEPT
+{
+    const StateInfo* leaf = nullptr;
+    // Regions in reverse entry order.
+    for (int r = si->m_regionNo - 1; r >= 0; r--)
     {
-        doExit(m_currentInfo);
-        m_currentInfo = stateInfo(m_currentInfo->m_level - 1);
+        if (const StateInfo* sub = stateInfo(m_setup.region(si, r).m_frame))
+            leaf = exitTree(sub);
     }
-    doExit(m_currentInfo);
-    m_currentInfo = nullptr;
+    return leaf;
 }
 
-void
-FsmBaseMember::setStartState(int id, FsmBaseBase* fsm)
+bool
+FsmBaseMember::dispatchTree(const StateInfo* si, int eventId,
+                            const void* event,
+                            Collector& collector) STATECHART_NOEXCEPT
 {
-    m_currentInfo = nullptr;
-    const auto& sizes = m_setup.sizes();
-    m_stackFrames.clear();
-    m_stackFrames.reserve(sizes.size());
-    for (const auto& el : sizes)
+    bool handled = false;
+    if (si->m_orthogonal && m_regionTasks && !m_parallel)
+        handled = dispatchParallel(si, eventId, event, collector);
+    else
     {
-        m_stackFrames.emplace_back(el);
+        for (int r = 0; r < si->m_regionNo; r++)
+        {
+            const StateInfo* sub = stateInfo(m_setup.region(si, r).m_frame);
+            if (!sub)
+                continue;
+            if (sub->m_regionNo > 0)
+                handled = dispatchTree(sub, eventId, event, collector) ||
+                          handled;
+            else if (eventId < 0 || sub->m_handled[eventId])
+                handled =
+                    sub->m_dispatch(getState(sub->m_frame), event) || handled;
+
+            // Hold back transitions so all regions see the same
+            // configuration.
+            int& next = *collector.m_next;
+            if (si->m_orthogonal && next != FsmStaticData::nullStateId)
+            {
+                collector.m_pending[collector.m_pendingNo++] =
+                    Pending{sub, next};
+                next = FsmStaticData::nullStateId;
+            }
+        }
+    }
+    if (handled || (eventId >= 0 && !si->m_handled[eventId]))
+        return handled;
+    return si->m_dispatch(getState(si->m_frame), event);
+}
+
+bool
+FsmBaseMember::dispatchParallel(const StateInfo* si, int eventId,
+                                const void* event,
+                                Collector& collector) STATECHART_NOEXCEPT
+{
+    RegionTasks& tasks = *m_regionTasks;
+    const int orthogonalNo = m_setup.orthogonalNo();
+    for (int r = 0; r < si->m_regionNo; r++)
+    {
+        RegionTask& task = tasks.m_tasks[r];
+        task.m_member = this;
+        task.m_sub = stateInfo(m_setup.region(si, r).m_frame);
+        task.m_eventId = eventId;
+        task.m_event = event;
+        task.m_collector =
+            Collector{&tasks.m_pending[r * orthogonalNo], 0, &task.m_next};
+        task.m_next = FsmStaticData::nullStateId;
+        task.m_handled = false;
+    }
+
+    m_parallel = true;
+    tasks.m_executor->run(si->m_regionNo, &FsmBaseMember::runRegionTask,
+                          tasks.m_tasks.data());
+    m_parallel = false;
+
+    // Same order as a sequential dispatch: the nested regions of a region
+    // first, then the region itself.
+    bool handled = false;
+    for (int r = 0; r < si->m_regionNo; r++)
+    {
+        const RegionTask& task = tasks.m_tasks[r];
+        handled = handled || task.m_handled;
+        for (int i = 0; i < task.m_collector.m_pendingNo; i++)
+            collector.m_pending[collector.m_pendingNo++] =
+                task.m_collector.m_pending[i];
+        if (task.m_next != FsmStaticData::nullStateId)
+            collector.m_pending[collector.m_pendingNo++] =
+                Pending{task.m_sub, task.m_next};
     }
-    setupTransition(m_setup.findState(id), fsm);
+    return handled;
 }
 
-ModelBase*
-FsmBaseMember::parent(int parentId)
+void
+FsmBaseMember::runRegionTask(void* context, int index) STATECHART_NOEXCEPT
 {
-    const StateInfo* myInfo = m_currentInfo;
-    if (myInfo->m_level == 0)
-        throw std::runtime_error("No parent available for root states.");
+    RegionTask& task = static_cast<RegionTask*>(context)[index];
+    const StateInfo* sub = task.m_sub;
+    if (!sub)
+        return;
 
-    // Make sure the supplied type is the same as the active stack type.
-    if (parentId != myInfo->m_parentId)
-        throw std::runtime_error("Type mismatch for parent state.");
+    FsmBaseMember& member = *task.m_member;
+    s_regionNext = &task.m_next;
+    if (sub->m_regionNo > 0)
+        task.m_handled = member.dispatchTree(sub, task.m_eventId,
+                                             task.m_event, task.m_collector);
+    else if (task.m_eventId < 0 || sub->m_handled[task.m_eventId])
+        task.m_handled =
+            sub->m_dispatch(member.getState(sub->m_frame), task.m_event);
+    s_regionNext = nullptr;
+}
 
-    ModelBase* mb = getModelBase(myInfo->m_level - 1);
-    return mb;
+void
+FsmBaseMember::updateCurrent() noexcept
+{
+    const StateInfo* si = stateInfo(0);
+    while (si && si->m_regionNo > 0)
+    {
+        const StateInfo* sub = stateInfo(m_setup.region(si, 0).m_frame);
+        if (!sub)
+            break;
+        si = sub;
+    }
+    m_currentInfo = si;
 }
 
-const ModelBase*
-FsmBaseMember::activeState(int targetId) const
+void
+FsmBaseMember::cleanup() STATECHART_NOEXCEPT
 {
     if (!m_currentInfo)
-        return nullptr;
+        return;
 
-    auto currentLevel = m_currentInfo->m_level;
-    auto targetInfo = m_setup.findState(targetId);
-    auto targetLevel = targetInfo->m_level;
-    if (targetLevel > currentLevel)
-        return nullptr;
+    if (hasRegions())
+    {
+        exitTree(stateInfo(0));
+        m_currentInfo = nullptr;
+        return;
+    }
 
-    // Invariant: stateFrame[targetLevel] is valid.
-    const auto* stackInfo = stateInfoAtLevel(targetLevel);
-    if (stackInfo != targetInfo)
+    const StateInfo* leaf = m_currentInfo;
+    while (m_currentInfo->m_level > 0)
+    {
+        doExit(m_currentInfo, leaf);
+        m_currentInfo = stateInfo(m_currentInfo->m_level - 1);
+    }
+    doExit(m_currentInfo, leaf);
+    m_currentInfo = nullptr;
+}
+
+void
+FsmBaseMember::setStartState(int id, FsmBaseBase* fsm) STATECHART_NOEXCEPT
+{
+    // Exit a previously started state stack before it is entered again.
+    cleanup();
+    setupTransition(choose(m_setup.findState(id), fsm), fsm);
+}
+
+const void*
+FsmBaseMember::activeState(int targetId) const noexcept
+{
+    auto targetInfo = m_setup.findState(targetId);
+    if (!targetInfo || !isActive(targetInfo))
         return nullptr;
 
     // Invariant: The actual requested object is active on the stack.
-    const auto* mb = getModelBase(targetLevel);
-    return mb;
+    return getState(targetInfo->m_frame);
 }
@@ -32,28 +32,65 @@
  * In the state setup function you need to call 'addState' for each
  * state that belongs to the state machine. Here you specify the State
  * class and the class of a possible parent state.
+ * Alternatively the description class can list the states in a
+ * 'States' type list (see StateList). Then the state tables are computed
+ * at compile time and no setup function is needed.
  *
  * Each state inherits from the class BaseState<Desc, StateId>.
- * All events are delivered through the function 'event' that needs to be
- * implemented.
+ * Events are delivered through the function 'event'. A state without it
+ * handles no events. With event ids in the description (see FsmEventIds)
+ * a state can list the events it handles in 'HandledEvents', and levels
+ * not handling an event are skipped. With an EventVariant as the event
+ * type, states handle each event type in an overload 'on(const EvA&)'.
  *
  * Each state has a particular level given by the number of transitive parents.
- * For each level there is at most 1 active state at any time.
+ * For each level there is at most 1 active state at any time, unless a state
+ * has orthogonal regions. Then one sub state per region is active, and each
+ * event is passed to all regions. (See FsmSetup::addState.) The regions
+ * can be dispatched in parallel. (See FsmBase::setRegionExecutor.)
  * The statechart allocates memory for each level and this is reused for each
  * state change by using placement new/delete. This should ensure deterministic
  * timing for all state changes.
  */
 
+#include "BufferAllocator.h"
+#include "EventVariant.h"
+#include "MpscQueue.h"
+#include "RingQueue.h"
 #include "VecQueue.h"
 
 #include <algorithm>
 #include <functional>
+#include <initializer_list>
 #include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 #include <cassert>
+#include <cstddef>
+#include <cstdint>
 #include <iostream>
 
+/**
+ * Build without exceptions. Defined by the user, or automatically with
+ * -fno-exceptions. Errors in the state setup are then fatal instead of
+ * throwing std::runtime_error, and the event and transition paths are
+ * noexcept. States must not throw from their constructors, destructors
+ * and event functions in this mode.
+ */
+#if !defined(STATECHART_NO_EXCEPTIONS) && !defined(__cpp_exceptions) &&     \
+    !defined(__EXCEPTIONS)
+#define STATECHART_NO_EXCEPTIONS
+#endif
+
+#ifdef STATECHART_NO_EXCEPTIONS
+#define STATECHART_NOEXCEPT noexcept
+#else
+#define STATECHART_NOEXCEPT
+#endif
+
 class FsmBaseBase;
 
 /**
@@ -76,8 +113,8 @@ struct StateArgs
  * construction upon state entry.
  *
  * Note that 'event' function is not handled here as a virtual function.
- * Rather it is done internally via the Model class and direct call
- * on the member. Hence the state classes do not need a vtable.
+ * Rather each state gets a dispatch function in the state table which
+ * calls the member directly. Hence the state classes do not need a vtable.
  */
 template <typename FsmDesc, typename FsmDesc::StateId stId>
 class StateBase
@@ -105,16 +142,49 @@ class StateBase
      * Perform a transition to a new state.
      * @param id state id to transition to.
      */
-    void transition(StateId id)
+    void transition(StateId id) noexcept
     {
         fsm().member().transition(static_cast<int>(id));
     }
 
     /**
-     * Transition, given target state type.
+     * Transition, given target state type. May also be a history
+     * pseudo-state, see ShallowHistory, or a choice, see ChoiceBase.
+     */
+    template <typename TargetState>
+    void transition() noexcept;
+
+    /**
+     * Transition, constructing the target with 'args' after the
+     * StateArgs. The arguments are moved into the FSM and from there into
+     * the constructor of the next entry of the target. If the target is
+     * not entered by the transitions of this event they are destroyed,
+     * as they are by a later transition with a payload. The target still
+     * needs a constructor taking only the StateArgs.
      */
+    template <typename TargetState, typename Arg, typename... Args>
+    void transition(Arg&& arg, Args&&... args) STATECHART_NOEXCEPT;
+
+    /**
+     * Local transition. Active states on the root path of the target are
+     * kept, including the target itself, so their objects live on. Only
+     * the states below are exited and entered. With the target active and
+     * no active sub states nothing is done, where transition() exits and
+     * enters it again.
+     * @param id state id to transition to.
+     */
+    void localTransition(StateId id) noexcept
+    {
+        fsm().member().localTransition(static_cast<int>(id));
+    }
+
+    /// Local transition, given target state type.
     template <typename TargetState>
-    void transition();
+    void localTransition() noexcept
+    {
+        fsm().member().localTransition(
+            static_cast<int>(TargetState::stateId));
+    }
 
     /// Reference to the custom state machine object.
     Fsm& fsm()
@@ -130,64 +200,206 @@ class StateBase
 
     // Get a reference to the parent object.
     // Semantics of the statechart guarantee that the reference
-    // is valid as long as this state is valid.
+    // is valid as long as this state is valid. 'ParentState' must be a
+    // parent at any distance. Checked at compile time with a 'States'
+    // type list, then this is a single load. Asserted otherwise.
     template <class ParentState>
-    ParentState& parent();
+    ParentState& parent() noexcept;
 
   private:
     Fsm* m_fsm;
 };
 
 /**
- * Base for 'StateModel' class. StateModel keeps a State as a member and
- * introduce inheritance for event passing. Purpose of ModelBase is to get a
- * uniform handling of destruction.
+ * Base class for choice pseudo-states. A choice has a state id but no
+ * object, and is never active. A transition to it is routed to the state
+ * selected by its 'choose' function, evaluated when the transition is
+ * applied, and that state is entered in one transition:
+ *
+ *   class Decide : public ChoiceBase<Desc, StateId::decide>
+ *   {
+ *     public:
+ *       static StateId choose(const Fsm& fsm);
+ *   };
+ *
+ * 'choose' may select another choice. Choices are added with
+ * FsmSetup::addChoice, or StateDef<Decide> in 'States', and have neither
+ * a parent nor sub states.
  */
-class ModelBase
+template <typename FsmDesc, typename FsmDesc::StateId stId>
+class ChoiceBase
 {
   public:
-    virtual ~ModelBase() {}
+    using FsmDescription = FsmDesc;
+    using StateId = typename FsmDesc::StateId;
+    using Fsm = typename FsmDesc::Fsm;
+
+    static constexpr const typename FsmDesc::StateId stateId = stId;
+    static const constexpr bool isChoice = true;
+
+    ChoiceBase() = delete;
 };
 
 /**
  * Keep track of the state hierarchy. One object of this class
  * exist for each type of FSM that is created.
+ *
+ * The object is a read only view of tables owned elsewhere. Either built
+ * at startup by FsmStaticBuilder (via 'setupStates') or computed at
+ * compile time by FsmConstSetup (via a 'States' type list).
  */
 class FsmStaticData
 {
   public:
-    explicit FsmStaticData(int stateNo) : m_states(stateNo) {}
-
     static const constexpr int nullStateId = -1;
 
+    static const constexpr int lcaTableLimit = 256;
+
+    // Deepest hierarchy with a common ancestor table, levels are stored
+    // as signed char.
+    static const constexpr int lcaLevelLimit = 127;
+
     /**
      * Signature for the creator function for a particular state.
      * Called when entering a new state to construct the state object.
      * @param store  A memory array large enough to create the object on.
      * @param fsm Pointer to the current fsm.
-     * @return Pointer to the newly created Model object.
+     * @return Pointer to the newly created State object.
+     */
+    using CreateFkn = void* (*)(char* store, FsmBaseBase* fsm);
+
+    // Destroy a state object created by the CreateFkn. (exit)
+    using DestroyFkn = void (*)(void* state);
+
+    /**
+     * Deliver an event to a state object.
+     * @param state Object created by the CreateFkn.
+     * @param event Pointer to an FsmDesc::Event.
+     * @return true if the event was handled.
      */
-    using CreateFkn = ModelBase* (*)(char* store, FsmBaseBase* fsm);
+    using DispatchFkn = bool (*)(void* state, const void* event);
+
+    // Select the target of a choice pseudo-state, see ChoiceBase.
+    using ChoiceFkn = int (*)(const FsmBaseBase* fsm);
+
+    // Level type in the dispatch cache. -1 for no level.
+    using CacheLevel = short;
 
     // Collection of meta data for one state.
     struct StateInfo
     {
-        StateInfo() : m_maker(nullptr) {}
+        constexpr StateInfo() {}
         template <class StateId>
-        StateInfo(StateId parentId, int level, const CreateFkn& fkn)
+        constexpr StateInfo(StateId parentId, int level, size_t size,
+                            CreateFkn maker, DestroyFkn destroy,
+                            DispatchFkn dispatch, const bool* handled,
+                            int history = -1)
             : m_parentId(static_cast<int>(parentId)), m_level(level),
-              m_maker(fkn)
+              m_size(size), m_maker(maker), m_destroy(destroy),
+              m_dispatch(dispatch), m_handled(handled), m_history(history)
         {
         }
-        int m_parentId;
-        int m_level;
-        CreateFkn m_maker;
+        // True for states that are part of the FSM.
+        constexpr bool valid() const
+        {
+            return m_parentId != nullStateId;
+        }
+
+        int m_parentId = nullStateId;
+        int m_level = 0;
+
+        // Orthogonal region of the parent this state is in, -1 for a plain
+        // sub state.
+        int m_region = -1;
+
+        // Regions of the sub states, see 'planRegions'. Plain sub states
+        // form one region. 'm_orthogonal' is set when the sub states are in
+        // orthogonal regions, which are all active with the state.
+        int m_regionNo = 0;
+        int m_regionStart = 0;
+        bool m_orthogonal = false;
+
+        // Frame holding the state when active. Equal to the level in
+        // charts without orthogonal regions.
+        int m_frame = 0;
+
+        // Object size and position in the instance storage. The position
+        // is right after the parent state, see 'planOffsets'.
+        size_t m_size = 0;
+        size_t m_offset = 0;
+
+        CreateFkn m_maker = nullptr;
+        DestroyFkn m_destroy = nullptr;
+        DispatchFkn m_dispatch = nullptr;
+
+        // For each event id, true if the event is passed to the state.
+        // See HandledEvents.
+        const bool* m_handled = nullptr;
+
+        // Slot in the history of an instance, -1 for states keeping no
+        // history. Given as 0 by states keeping it, see 'planHistory'.
+        int m_history = -1;
+
+        // Set for a choice pseudo-state, which has no object and is never
+        // active. 'm_isChoice' is the same, for constant expressions.
+        ChoiceFkn m_choice = nullptr;
+        bool m_isChoice = false;
+    };
+
+    /**
+     * Sub states of one state in one region. The frames and storage of
+     * the regions of a state follow each other, so all regions can be
+     * active at once.
+     */
+    struct RegionInfo
+    {
+        // Entered with the parent for orthogonal regions. The sub state
+        // with the lowest id.
+        int m_initial = nullStateId;
+
+        // Frames and storage used by the sub states and their descendants.
+        int m_frame = 0;
+        int m_frameNo = 0;
+        size_t m_offset = 0;
+        size_t m_size = 0;
     };
 
+    constexpr FsmStaticData() {}
+
+    /**
+     * @param states Info for each state id, 'stateNo' entries.
+     * @param levelNo Number of levels in the hierarchy.
+     * @param storageSize Storage needed for the state objects of any
+     *                    active configuration, see 'planOffsets'.
+     * @param paths Root paths, see 'planPaths'.
+     * @param lca Common ancestor levels, see 'planLca'. nullptr for charts
+     *            without a table, see 'hasLcaTable'.
+     * @param eventIdNo Number of event ids, 0 without a dispatch cache.
+     * @param firstHandler Dispatch cache, see 'planDispatch'.
+     * @param regions Regions, see 'planRegions'.
+     * @param regionNo Number of entries in 'regions'.
+     * @param frameNo Number of frames, see 'planOffsets'. 0 for 'levelNo'.
+     */
+    constexpr FsmStaticData(const StateInfo* states, int stateNo, int levelNo,
+                            size_t storageSize, const int* paths,
+                            const signed char* lca, int eventIdNo = 0,
+                            const CacheLevel* firstHandler = nullptr,
+                            const RegionInfo* regions = nullptr,
+                            int regionNo = 0, int frameNo = 0)
+        : m_states(states), m_stateNo(stateNo), m_levelNo(levelNo),
+          m_frameNo(frameNo > 0 ? frameNo : levelNo),
+          m_storageSize(storageSize), m_paths(paths), m_lca(lca),
+          m_eventIdNo(eventIdNo), m_firstHandler(firstHandler),
+          m_regions(regions), m_regionNo(regionNo),
+          m_orthogonalNo(orthogonalRegions(states, stateNo)),
+          m_historyNo(historyStates(states, stateNo))
+    {
+    }
+
     const StateInfo* findState(int id) const
     {
         const auto& el = m_states[id];
-        return el.m_maker == nullptr ? nullptr : &el;
+        return el.valid() ? &el : nullptr;
     }
 
     int findState(const StateInfo* si) const
@@ -195,304 +407,2055 @@ class FsmStaticData
         return si == nullptr ? nullStateId : (si - &m_states[0]);
     }
 
-    void addStateBase(int stateId, int parentId, size_t size, CreateFkn fkn);
+    // Number of state ids, including ids not used by the chart.
+    constexpr int stateNo() const
+    {
+        return m_stateNo;
+    }
 
-    const std::vector<size_t>& sizes() const
+    // Number of levels in the hierarchy.
+    constexpr int levelNo() const
     {
-        return m_objectSizes;
+        return m_levelNo;
     }
 
-  private:
-    // Store of the information structure for all the states.
-    std::vector<StateInfo> m_states;
+    // Number of frames, the most states that can be active at once.
+    int frameNo() const
+    {
+        return m_frameNo;
+    }
 
-    // Store the maximum size needed for each level to construct the objects.
-    std::vector<size_t> m_objectSizes;
-};
+    // Number of orthogonal regions in the chart. 0 when at most one state
+    // per level is active.
+    int orthogonalNo() const
+    {
+        return m_orthogonalNo;
+    }
 
-class FsmBaseMember
-{
-  public:
-    using StateInfo = FsmStaticData::StateInfo;
-    FsmBaseMember(const FsmStaticData& setup) : m_setup(setup) {}
+    // Number of states keeping history.
+    int historyNo() const
+    {
+        return m_historyNo;
+    }
 
-    ~FsmBaseMember()
+    // Region 'region' of the sub states of 'si'.
+    const RegionInfo& region(const StateInfo* si, int region) const
     {
-        cleanup();
+        return m_regions[si->m_regionStart + region];
     }
 
-    void transition(int id)
+    // Storage needed for the state objects of an FSM instance.
+    size_t storageSize() const
     {
-        m_nextState = id;
+        return m_storageSize;
     }
 
-    void setStartState(int id, FsmBaseBase* hsm);
+    // Round up to the alignment used for state objects.
+    static constexpr size_t alignUp(size_t size)
+    {
+        return (size + alignof(std::max_align_t) - 1) &
+               ~(alignof(std::max_align_t) - 1);
+    }
 
-    const StateInfo* activeStateInfo() const
+    // Return the ancestor of 'si' at 'level'. Require level <= si->m_level.
+    const StateInfo* ancestor(const StateInfo* si, int level) const
     {
-        return m_currentInfo;
+        return &m_states[ancestorId(findState(si), level)];
     }
 
-    int activeStateId() const
+    int ancestorId(int stateId, int level) const
     {
-        return m_setup.findState(m_currentInfo);
+        return m_paths[stateId * m_levelNo + level];
     }
 
-    // Return the working area for a particular level.
-    ModelBase* getModelBase(int level)
+    // Number of event ids in the dispatch cache.
+    constexpr int eventIdNo() const
     {
-        return m_stackFrames[level].m_activeState.get();
+        return m_eventIdNo;
     }
 
-    const ModelBase* getModelBase(int level) const
+    /**
+     * Return the deepest level, from 'stateId' towards the root, whose
+     * state is passed events with 'eventId'. Return -1 if there is none.
+     */
+    constexpr int firstHandler(int stateId, int eventId) const
     {
-        return m_stackFrames[level].m_activeState.get();
+        return m_firstHandler[stateId * m_eventIdNo + eventId];
     }
 
-    void possiblyDoTransition(FsmBaseBase* fbb);
+    /**
+     * Return the level of the deepest state that is both 'a' or one of its
+     * parents and 'b' or one of its parents. Return -1 if there is none.
+     */
+    int commonLevel(const StateInfo* a, const StateInfo* b) const
+    {
+        const int ia = findState(a);
+        const int ib = findState(b);
+        if (m_lca)
+            return m_lca[ia * m_stateNo + ib];
+
+        return commonLevel(m_paths, m_levelNo, ia, a->m_level, ib,
+                           b->m_level);
+    }
 
-    const StateInfo* stateInfoAtLevel(int level) const
+    // True if a chart of this size has a common ancestor table.
+    static constexpr bool hasLcaTable(int stateNo, int levelNo)
     {
-        return m_stackFrames[level].m_stateInfo;
+        return stateNo <= lcaTableLimit && levelNo <= lcaLevelLimit;
     }
 
-    // Given current state, return the ModelBase of the parent if available,
-    // or nullptr.
-    ModelBase* parent(int parentId);
+    /**
+     * Compute the root path for each state. Row 'stateId' of 'paths' holds
+     * the ancestor id at each level, 'levelNo' entries per row.
+     * Unused entries are set to nullStateId.
+     */
+    static constexpr void planPaths(const StateInfo* states, int stateNo,
+                                    int levelNo, int* paths)
+    {
+        for (int i = 0; i < stateNo * levelNo; i++)
+            paths[i] = nullStateId;
 
-    // Given a target state Id, return a pointer to the ModelBase if it
-    // is currently active on the stack at any level.
-    const ModelBase* activeState(int targetId) const;
+        for (int id = 0; id < stateNo; id++)
+        {
+            if (!states[id].valid())
+                continue;
+            int ancestorId = id;
+            for (int level = states[id].m_level; level >= 0; level--)
+            {
+                paths[id * levelNo + level] = ancestorId;
+                ancestorId = states[ancestorId].m_parentId;
+            }
+        }
+    }
 
-  private:
-    // Implement placement destruction for the smart pointer.
-    struct PlacementDestroyer
+    /**
+     * Compute the common ancestor level for each (source, target) pair.
+     * 'lca' holds stateNo * stateNo entries.
+     */
+    static constexpr void planLca(const StateInfo* states, int stateNo,
+                                  int levelNo, const int* paths,
+                                  signed char* lca)
     {
-        void operator()(ModelBase* p)
+        for (int a = 0; a < stateNo; a++)
         {
-            p->~ModelBase();
+            for (int b = 0; b < stateNo; b++)
+            {
+                signed char level = -1;
+                if (states[a].valid() && states[b].valid())
+                    level = static_cast<signed char>(
+                        commonLevel(paths, levelNo, a, states[a].m_level, b,
+                                    states[b].m_level));
+                lca[a * stateNo + b] = level;
+            }
         }
-    };
+    }
 
-    // Smart pointer type implementing the placement delete.
-    using UniquePtr = std::unique_ptr<ModelBase, PlacementDestroyer>;
+    /**
+     * Group the sub states of each state in regions. Sub states with
+     * m_region >= 0 are in orthogonal regions, the others in one plain
+     * region. Sets m_regionNo, m_regionStart and m_orthogonal.
+     * @return Number of regions, the size of the region table.
+     */
+    static constexpr int countRegions(StateInfo* states, int stateNo)
+    {
+        for (int id = 0; id < stateNo; id++)
+        {
+            StateInfo& si = states[id];
+            if (!si.valid() || si.m_level == 0)
+                continue;
+            StateInfo& parent = states[si.m_parentId];
+            const int region = si.m_region < 0 ? 0 : si.m_region;
+            if (parent.m_regionNo < region + 1)
+                parent.m_regionNo = region + 1;
+            if (si.m_region >= 0)
+                parent.m_orthogonal = true;
+        }
 
-    // Structure for one level of the state stack.
-    struct LevelData
+        int regionNo = 0;
+        for (int id = 0; id < stateNo; id++)
+        {
+            states[id].m_regionStart = regionNo;
+            regionNo += states[id].m_regionNo;
+        }
+        return regionNo;
+    }
+
+    /**
+     * Set the initial state of each region. Require 'countRegions' first.
+     * 'regions' holds the number of regions it returned.
+     */
+    static constexpr void planRegions(const StateInfo* states, int stateNo,
+                                      RegionInfo* regions)
     {
-        explicit LevelData(size_t size)
-            : m_stateInfo(nullptr), m_activeState(nullptr),
-              m_stateStorage(std::make_unique<char[]>(size))
+
+        for (int id = 0; id < stateNo; id++)
         {
+            const StateInfo& si = states[id];
+            if (!si.valid() || si.m_level == 0)
+                continue;
+            const StateInfo& parent = states[si.m_parentId];
+            RegionInfo& region =
+                regions[parent.m_regionStart +
+                        (si.m_region < 0 ? 0 : si.m_region)];
+            if (region.m_initial == nullStateId)
+                region.m_initial = id;
         }
+    }
 
-        // Active meta information pointer.
-        const StateInfo* m_stateInfo;
+    /**
+     * Check the regions after 'planRegions'. The sub states of a state
+     * are either all plain or all in orthogonal regions, and no region
+     * is empty.
+     */
+    static constexpr bool regionsValid(const StateInfo* states, int stateNo,
+                                       const RegionInfo* regions)
+    {
+        for (int id = 0; id < stateNo; id++)
+        {
+            const StateInfo& si = states[id];
+            if (!si.valid())
+                continue;
+            if (si.m_level > 0 &&
+                (si.m_region >= 0) != states[si.m_parentId].m_orthogonal)
+                return false;
+            for (int r = 0; r < si.m_regionNo; r++)
+                if (regions[si.m_regionStart + r].m_initial == nullStateId)
+                    return false;
+        }
+        return true;
+    }
 
-        // Current active state for this level.
-        UniquePtr m_activeState;
+    // Number of orthogonal regions.
+    static constexpr int orthogonalRegions(const StateInfo* states,
+                                           int stateNo)
+    {
+        int regionNo = 0;
+        for (int id = 0; id < stateNo; id++)
+            if (states[id].valid() && states[id].m_orthogonal)
+                regionNo += states[id].m_regionNo;
+        return regionNo;
+    }
 
-        // Storage for the current active State object.
-        std::unique_ptr<char[]> m_stateStorage;
-    };
+    /**
+     * Number the history slots of the states keeping history, in state
+     * id order.
+     * @return Number of slots.
+     */
+    static constexpr int planHistory(StateInfo* states, int stateNo)
+    {
+        int historyNo = 0;
+        for (int id = 0; id < stateNo; id++)
+            if (states[id].valid() && states[id].m_history >= 0)
+                states[id].m_history = historyNo++;
+        return historyNo;
+    }
 
-    // Do final exit handlers prior to destructing the fsm.
-    void cleanup();
+    // Number of states keeping history.
+    static constexpr int historyStates(const StateInfo* states, int stateNo)
+    {
+        int historyNo = 0;
+        for (int id = 0; id < stateNo; id++)
+            if (states[id].valid() && states[id].m_history >= 0)
+                historyNo++;
+        return historyNo;
+    }
 
-    // Do initial entry calls when starting the fsm.
-    void setupTransition(const StateInfo* nextInfo, FsmBaseBase* fsm);
+    /**
+     * Check that no state keeping history has orthogonal regions, itself
+     * or below it. Its history is then a single leaf state.
+     */
+    static constexpr bool historyValid(const StateInfo* states, int stateNo)
+    {
+        for (int id = 0; id < stateNo; id++)
+        {
+            if (!states[id].valid() || !states[id].m_orthogonal)
+                continue;
+            int up = id;
+            for (;;)
+            {
+                if (states[up].m_history >= 0)
+                    return false;
+                if (states[up].m_level == 0)
+                    break;
+                up = states[up].m_parentId;
+            }
+        }
+        return true;
+    }
 
-    // Do a normal state 2 state transition.
-    void doTransition(const StateInfo* nextInfo, FsmBaseBase* fsm);
+    /**
+     * Check that each choice pseudo-state is a bottom level state without
+     * sub states.
+     */
+    static constexpr bool choicesValid(const StateInfo* states, int stateNo)
+    {
+        for (int id = 0; id < stateNo; id++)
+        {
+            const StateInfo& si = states[id];
+            if (!si.valid())
+                continue;
+            if (si.m_isChoice && si.m_level > 0)
+                return false;
+            if (si.m_level > 0 && states[si.m_parentId].m_isChoice)
+                return false;
+        }
+        return true;
+    }
+
+    /**
+     * Place the state objects in the instance storage and the active
+     * states in frames. Each state is put right after its parent, so only
+     * states that can be active together overlap in lifetime and siblings
+     * share memory. The orthogonal regions of a state follow each other.
+     * Require 'planRegions' first.
+     * @param frameNo Set to the number of frames needed.
+     * @return The storage size for the largest active configuration.
+     */
+    static constexpr size_t planOffsets(StateInfo* states, int stateNo,
+                                        int levelNo, RegionInfo* regions,
+                                        int* frameNo)
+    {
+        // Sizes bottom up. A state needs its own size plus its largest
+        // sub state, or the sum of them for orthogonal regions.
+        size_t storageSize = 0;
+        *frameNo = 0;
+        for (int level = levelNo - 1; level >= 0; level--)
+        {
+            for (int id = 0; id < stateNo; id++)
+            {
+                const StateInfo& si = states[id];
+                if (!si.valid() || si.m_level != level)
+                    continue;
+                size_t size = alignUp(si.m_size);
+                int frames = 1;
+                for (int r = 0; r < si.m_regionNo; r++)
+                {
+                    size += regions[si.m_regionStart + r].m_size;
+                    frames += regions[si.m_regionStart + r].m_frameNo;
+                }
+
+                if (level == 0)
+                {
+                    storageSize = storageSize < size ? size : storageSize;
+                    *frameNo = *frameNo < frames ? frames : *frameNo;
+                    continue;
+                }
+                const StateInfo& parent = states[si.m_parentId];
+                RegionInfo& region =
+                    regions[parent.m_regionStart +
+                            (si.m_region < 0 ? 0 : si.m_region)];
+                if (region.m_size < size)
+                    region.m_size = size;
+                if (region.m_frameNo < frames)
+                    region.m_frameNo = frames;
+            }
+        }
 
-    void doEntry(const StateInfo* newState, FsmBaseBase* fsm);
+        // Positions top down.
+        for (int level = 0; level < levelNo; level++)
+        {
+            for (int id = 0; id < stateNo; id++)
+            {
+                StateInfo& si = states[id];
+                if (!si.valid() || si.m_level != level)
+                    continue;
+                if (level == 0)
+                {
+                    si.m_offset = 0;
+                    si.m_frame = 0;
+                }
+                else
+                {
+                    const RegionInfo& region =
+                        regions[states[si.m_parentId].m_regionStart +
+                                (si.m_region < 0 ? 0 : si.m_region)];
+                    si.m_offset = region.m_offset;
+                    si.m_frame = region.m_frame;
+                }
+
+                size_t offset = si.m_offset + alignUp(si.m_size);
+                int frame = si.m_frame + 1;
+                for (int r = 0; r < si.m_regionNo; r++)
+                {
+                    RegionInfo& region = regions[si.m_regionStart + r];
+                    region.m_offset = offset;
+                    region.m_frame = frame;
+                    offset += region.m_size;
+                    frame += region.m_frameNo;
+                }
+            }
+        }
+        return storageSize;
+    }
 
-    void doExit(const StateInfo* currState);
+    /**
+     * Compute the dispatch cache. For each state and event id, the level
+     * of the first state on the root path, leaf first, that is passed the
+     * event. 'firstHandler' holds stateNo * eventIdNo entries.
+     */
+    static constexpr void planDispatch(const StateInfo* states, int stateNo,
+                                       int levelNo, const int* paths,
+                                       int eventIdNo, CacheLevel* firstHandler)
+    {
+        for (int id = 0; id < stateNo; id++)
+        {
+            for (int ev = 0; ev < eventIdNo; ev++)
+            {
+                CacheLevel first = -1;
+                if (states[id].valid())
+                {
+                    int level = states[id].m_level;
+                    while (level >= 0 &&
+                           !states[paths[id * levelNo + level]].m_handled[ev])
+                        level--;
+                    first = static_cast<CacheLevel>(level);
+                }
+                firstHandler[id * eventIdNo + ev] = first;
+            }
+        }
+    }
 
-    const StateInfo*& stateInfo(int level)
+    static constexpr int commonLevel(const int* paths, int levelNo, int ia,
+                                     int levelA, int ib, int levelB)
     {
-        return m_stackFrames[level].m_stateInfo;
+        const int* pathA = &paths[ia * levelNo];
+        const int* pathB = &paths[ib * levelNo];
+        int level = levelA < levelB ? levelA : levelB;
+        while (level >= 0 && pathA[level] != pathB[level])
+            level--;
+        return level;
     }
 
-    std::vector<LevelData> m_stackFrames;
+  private:
+    // Information structure for all the states.
+    const StateInfo* m_states = nullptr;
+    int m_stateNo = 0;
 
-    const StateInfo* m_currentInfo = nullptr;
+    int m_levelNo = 0;
+    int m_frameNo = 0;
 
-    const FsmStaticData& m_setup;
+    // Storage needed to construct the objects.
+    size_t m_storageSize = 0;
 
-    int m_nextState = FsmStaticData::nullStateId;
+    // Root path for each state.
+    const int* m_paths = nullptr;
+
+    // Common ancestor level for each (source, target) pair.
+    const signed char* m_lca = nullptr;
+
+    // First handling level for each (state, event id) pair.
+    int m_eventIdNo = 0;
+    const CacheLevel* m_firstHandler = nullptr;
+
+    // Sub state regions of each state.
+    const RegionInfo* m_regions = nullptr;
+    int m_regionNo = 0;
+    int m_orthogonalNo = 0;
+
+    int m_historyNo = 0;
 };
 
-class FsmBaseBase
+/**
+ * Owner of the state tables for FSMs set up at runtime through
+ * 'setupStates'.
+ */
+class FsmStaticBuilder
 {
-public:
-    FsmBaseMember& member() 
-    {
-        return m_base;
-    }
-    const FsmBaseMember& member() const
+  public:
+    using StateInfo = FsmStaticData::StateInfo;
+
+    explicit FsmStaticBuilder(int stateNo, int eventIdNo = 0)
+        : m_states(stateNo), m_eventIdNo(eventIdNo)
     {
-        return m_base;
     }
-  protected:
-    FsmBaseBase(const FsmStaticData& setup) : m_base(setup) {}
 
-    ~FsmBaseBase() {}
+    /**
+     * Add one state. 'info' holds the functions for the state, level,
+     * parent and region are set up here. The parent must be added
+     * before its sub states.
+     */
+    void addStateBase(int stateId, int parentId, const StateInfo& info,
+                      int region = -1);
 
-    FsmBaseMember m_base;
+    /**
+     * Compute the transition tables once all states are added.
+     * For each state the root path (ancestor at each level) is stored.
+     * For charts with at most 'lcaTableLimit' states and 'lcaLevelLimit'
+     * levels the level of the least common ancestor is also stored for
+     * every (source, target) pair. Larger charts find it by comparing the
+     * root paths instead.
+     * With event ids, the dispatch cache is computed as well.
+     * Throw std::runtime_error if the regions are not valid, if a
+     * state keeping history has orthogonal regions, or if a choice has a
+     * parent or sub states.
+     * @return A view of the tables, valid for the lifetime of this object.
+     */
+    FsmStaticData finalize();
+
+  private:
+    std::vector<StateInfo> m_states;
+    int m_levelNo = 0;
+    std::vector<int> m_paths;
+    std::vector<signed char> m_lca;
+    std::vector<FsmStaticData::RegionInfo> m_regions;
+    int m_eventIdNo;
+    std::vector<FsmStaticData::CacheLevel> m_firstHandler;
 };
 
-template <class Event>
-class EventInterface : public ModelBase
+/**
+ * Runs the orthogonal regions of one event in parallel. Implemented by
+ * RegionPool, and set per FSM with FsmBase::setRegionExecutor.
+ */
+class RegionExecutor
 {
   public:
-    ~EventInterface() override {}
-    virtual bool event(const Event& ev) = 0;
+    using TaskFkn = void (*)(void* context, int task);
+
+    // Call fkn(context, task) for each task in [0, taskNo), possibly
+    // concurrently. Return when all calls have returned.
+    virtual void run(int taskNo, TaskFkn fkn, void* context) = 0;
+
+  protected:
+    ~RegionExecutor() = default;
 };
 
-template <class FsmDesc, class St>
-class StateModel : public EventInterface<typename FsmDesc::Event>
+/**
+ * Told about each state an FSM exits, after the state object is
+ * destroyed. Implemented by FsmTimeouts, and set per FSM with
+ * FsmBase::setExitObserver.
+ */
+class StateExitObserver
 {
   public:
-    StateModel(StateArgs args) : m_state(args) {}
-    bool event(const typename FsmDesc::Event& event) override
-    {
-        return m_state.event(event);
-    }
-    ~StateModel() override {}
+    virtual void exited(int stateId) = 0;
 
-    St m_state;
+  protected:
+    ~StateExitObserver() = default;
 };
 
-/**
- * Helper class for setting up the FSM state description table at
- * startup. Capture type information and forward it to the state table
- * at construction.
- */
-template <class FsmDesc>
-class FsmSetup
+class FsmBaseMember
 {
   public:
-    FsmSetup() : m_data(static_cast<int>(FsmDesc::StateId::stateIdNo))
-    {
-        FsmDesc::setupStates(*this);
-    }
+    using StateInfo = FsmStaticData::StateInfo;
+
+    static const constexpr size_t cacheLineSize = 64;
 
     /**
-     * Add a bottom level state to the FSM. State will haVE 'level' == 0.
-     * @param State    Type name for the class that implement the state.
-     *                 Must inherit StateBase<...>.
+     * Allocate the instance block. It holds the data for each frame, room
+     * for the transitions of the orthogonal regions, the history, the set
+     * of active states, the storage for the state objects and
+     * 'queueBytes' for the initial event queue capacity.
+     * One allocation, aligned to a cache line.
      */
-    template <class State>
-    void addState()
+    FsmBaseMember(const FsmStaticData& setup, size_t queueBytes = 0);
+
+    FsmBaseMember(const FsmBaseMember&) = delete;
+    FsmBaseMember& operator=(const FsmBaseMember&) = delete;
+
+    ~FsmBaseMember();
+
+    // Size of the instance block, excluding the alignment slack.
+    size_t blockSize() const
     {
-        addState<State, State>();
+        return m_blockSize;
     }
 
+    // Size of the instance block needed for 'setup' and 'queueBytes'.
+    static size_t blockSizeFor(const FsmStaticData& setup, size_t queueBytes);
+
     /**
-     * Add a state to the FSM. State will have 'level one above the parent
-     * state.
-     * @param State    Type name for the class that implement the state.
-     *                 Must inherit StateBase<...>.
-     * @param ParentState State type for the parent state.
+     * Let the instance constructed on this thread within the 'ownerSize'
+     * bytes at 'owner' use 'block' instead of allocating one. Instances
+     * constructed elsewhere in between allocate as usual. The block must
+     * hold blockSizeFor() bytes and be aligned to a cache line. The caller
+     * keeps ownership, and calls dropBlock once the owner is constructed.
+     * (See FsmPool.)
      */
-    template <class State, class ParentState>
-    void addState()
+    static void useBlock(char* block, const void* owner, size_t ownerSize)
     {
-        // StateId parentId = ParentState::stateId;
-        static_assert(static_cast<int>(State::stateId) !=
-                          FsmStaticData::nullStateId,
-                      "state id is reserved.");
-        auto makerFkn = [](char* store, FsmBaseBase* fsm) -> ModelBase* {
-            auto p = new (store) StateModel<FsmDesc, State>(StateArgs(fsm));
-            return static_cast<ModelBase*>(p);
-        };
-        m_data.addStateBase(static_cast<int>(State::stateId),
-                            static_cast<int>(ParentState::stateId),
-                            sizeof(StateModel<FsmDesc, State>), makerFkn);
+        const char* begin = static_cast<const char*>(owner);
+        s_nextBlock = NextBlock{block, begin, begin + ownerSize};
     }
 
-    const FsmStaticData& data()
+    // True if the instance lives in 'block', handed over by useBlock.
+    bool usesBlock(const char* block) const
     {
-        return m_data;
+        return reinterpret_cast<const char*>(m_frames) == block;
     }
 
-  private:
-    FsmStaticData m_data;
-};
+    // Forget the block from useBlock. Return true if it was not used.
+    static bool dropBlock()
+    {
+        const bool unused = s_nextBlock.m_block != nullptr;
+        s_nextBlock = NextBlock{nullptr, nullptr, nullptr};
+        return unused;
+    }
 
-template <class Event>
-class FsmBaseEvent : public FsmBaseBase
-{
-  public:
-    FsmBaseEvent(const FsmStaticData& setup) : FsmBaseBase(setup) {}
+    // Start of the area reserved for the event queue in the instance block.
+    void* queueStorage()
+    {
+        return m_storage + FsmStaticData::alignUp(m_setup.storageSize());
+    }
 
-    // Post an event and process the queue in case it was empty before.
-    // Recommended unless finer grained control is needed.
-    void postEvent(const Event& ev)
+    // True if the chart has orthogonal regions, so that several states
+    // per level can be active.
+    bool hasRegions() const
     {
-        bool empty = m_eventQueue.empty();
-        m_eventQueue.push(ev);
-        if (empty)
-        { // Nobody else is currently processing events.
-            processQueue();
-        }
+        return m_setup.orthogonalNo() > 0;
     }
 
-    // Add an event to the queue without processing it.
-    void addEvent(const Event& ev)
+    const FsmStaticData& setup() const
     {
-        m_eventQueue.push(ev);
+        return m_setup;
     }
 
-    // Process the queue.
-    void processQueue()
+    // Word type of the set of active state ids.
+    using ActiveWord = std::uint64_t;
+    static const constexpr int activeWordBits = 64;
+
+    static constexpr int activeWordNo(int stateNo)
     {
-        while (!m_eventQueue.empty())
-        {
-            // Keep a local copy in case the vector reallocate during the
-            // event processing. (due to internal event posting.)
-            Event ev = m_eventQueue.front();
-            processEvent(ev);
-            m_eventQueue.pop();
-        }
+        return (stateNo + activeWordBits - 1) / activeWordBits;
     }
 
-  private:
-    void processEvent(const Event& ev)
+    // True if state 'id' is active. One bit test.
+    bool isIn(int id) const noexcept
     {
-        auto activeInfo = member().activeStateInfo();
-        if (!activeInfo)
-            return;
+        return (m_active[id / activeWordBits] >> (id % activeWordBits)) & 1;
+    }
 
-        bool eventHandled = false;
-        int level = activeInfo->m_level;
-        while (!eventHandled && level >= 0)
-        {
-            auto activeState = member().getModelBase(level);
-            eventHandled = emitEvent(activeState, ev);
-            level--;
-        }
-        member().possiblyDoTransition(this);
+    // True if any of the states in 'set' is active. 'set' holds
+    // activeWordNo words.
+    bool isInAny(const ActiveWord* set) const noexcept
+    {
+        for (int w = 0; w < m_activeWordNo; w++)
+            if (m_active[w] & set[w])
+                return true;
+        return false;
     }
 
-    static bool emitEvent(ModelBase* sbb, const Event& ev)
+    // True if all states in 'set' are active.
+    bool isInAll(const ActiveWord* set) const noexcept
     {
-        return static_cast<EventInterface<Event>*>(sbb)->event(ev);
+        for (int w = 0; w < m_activeWordNo; w++)
+            if ((m_active[w] & set[w]) != set[w])
+                return false;
+        return true;
     }
 
-    VecQueue<Event> m_eventQueue;
+    // True if 'si' is active.
+    bool isActive(const StateInfo* si) const noexcept
+    {
+        return m_frames[si->m_frame].m_stateInfo == si;
+    }
+
+    void transition(int id) noexcept
+    {
+        if (m_parallel)
+            *s_regionNext = id;
+        else
+            m_nextState = id;
+    }
+
+    // Set in a requested target id to make the transition local.
+    static const constexpr int localTransitionFlag = 1 << 30;
+
+    // Local transition to 'id', see StateBase::localTransition.
+    void localTransition(int id) noexcept
+    {
+        transition(id | localTransitionFlag);
+    }
+
+    // Type erased payload of a transition, see FsmPayload. 'make'
+    // constructs the target state from it, 'destroy' destroys it.
+    using PayloadMakeFkn = void* (*)(void* payload, char* store,
+                                     FsmBaseBase* fsm);
+    using PayloadDestroyFkn = void (*)(void* payload);
+
+    // Storage for a payload of 'size' bytes, reused between transitions.
+    // Destroys a payload not yet used.
+    void* payloadStore(size_t size) STATECHART_NOEXCEPT;
+
+    // Hand the payload constructed in payloadStore to the next entry of
+    // 'target'. Not from regions dispatched in parallel.
+    void setPayload(int target, PayloadMakeFkn make,
+                    PayloadDestroyFkn destroy) noexcept;
+
+    /**
+     * Transition to the history of state 'id', see ShallowHistory. The
+     * state must keep history.
+     */
+    void historyTransition(int id, bool deep) noexcept
+    {
+        const StateInfo* si = m_setup.findState(id);
+        assert(si->m_history >= 0);
+        if (const StateInfo* leaf = m_history[si->m_history])
+        {
+            const int leafId = m_setup.findState(leaf);
+            if (leaf != si)
+                id = deep ? leafId
+                          : m_setup.ancestorId(leafId, si->m_level + 1);
+        }
+        transition(id);
+    }
+
+    /**
+     * Dispatch the regions of the outermost active orthogonal state in
+     * parallel on 'executor'. nullptr goes back to sequential dispatch.
+     * Each region collects its own transitions, which are applied in
+     * region order after all regions are done, as without the executor.
+     */
+    void setRegionExecutor(RegionExecutor* executor);
+
+    // Call 'observer' on each state exit. nullptr removes it.
+    void setExitObserver(StateExitObserver* observer)
+    {
+        m_exitObserver = observer;
+    }
+
+    void setStartState(int id, FsmBaseBase* hsm) STATECHART_NOEXCEPT;
+
+    // The deepest active state. With orthogonal regions, the deepest
+    // state reached through the first region of each state.
+    const StateInfo* activeStateInfo() const noexcept
+    {
+        return m_currentInfo;
+    }
+
+    int activeStateId() const noexcept
+    {
+        return m_setup.findState(m_currentInfo);
+    }
+
+    // Return the active state object for a particular level.
+    void* getState(int level) noexcept
+    {
+        return m_frames[level].m_activeState;
+    }
+
+    const void* getState(int level) const noexcept
+    {
+        return m_frames[level].m_activeState;
+    }
+
+    // Deliver an event to the active state at 'level'.
+    bool dispatch(int level, const void* event) STATECHART_NOEXCEPT
+    {
+        const auto& frame = m_frames[level];
+        return frame.m_stateInfo->m_dispatch(frame.m_activeState, event);
+    }
+
+    /**
+     * Deliver an event using the dispatch cache. Only the levels whose
+     * state is passed 'eventId' are called, leaf first, until one
+     * handles the event.
+     */
+    void dispatchCached(int eventId, const void* event) STATECHART_NOEXCEPT
+    {
+        const int leaf = activeStateId();
+        int level = m_setup.firstHandler(leaf, eventId);
+        while (level >= 0 && !dispatch(level, event) && level > 0)
+            level = m_setup.firstHandler(m_setup.ancestorId(leaf, level - 1),
+                                         eventId);
+    }
+
+    /**
+     * Deliver an event in a chart with orthogonal regions. Each active
+     * state is passed the event if none of its active sub states handled
+     * it. All regions of a state are passed the event. Transitions
+     * requested in the regions are applied afterwards, in region order.
+     * @param eventId Event id for the dispatch cache, or -1.
+     */
+    void dispatchRegions(int eventId, const void* event) STATECHART_NOEXCEPT
+    {
+        if (const StateInfo* root = stateInfo(0))
+        {
+            Collector collector{m_pending, 0, &m_nextState};
+            dispatchTree(root, eventId, event, collector);
+            m_pendingNo = collector.m_pendingNo;
+        }
+    }
+
+    void possiblyDoTransition(FsmBaseBase* fbb) STATECHART_NOEXCEPT;
+
+    const StateInfo* stateInfoAtLevel(int level) const noexcept
+    {
+        return m_frames[level].m_stateInfo;
+    }
+
+    // Given a target state Id, return a pointer to the state object if it
+    // is currently active on the stack at any level.
+    const void* activeState(int targetId) const noexcept;
+
+  private:
+    // Structure for one frame of the state stack. A frame holds one level
+    // of one region. (See StateInfo::m_frame.)
+    struct LevelData
+    {
+        // Active meta information pointer. nullptr when no state is active.
+        const StateInfo* m_stateInfo;
+
+        // Current active state for this frame. Destroyed through
+        // m_stateInfo->m_destroy.
+        void* m_activeState;
+    };
+
+    // Transition requested in an orthogonal region. Applied if the
+    // region's state is still active.
+    struct Pending
+    {
+        const StateInfo* m_source;
+        int m_target;
+    };
+
+    // Where a dispatch pass collects its transitions. 'm_next' is where
+    // transition() stores the target.
+    struct Collector
+    {
+        Pending* m_pending;
+        int m_pendingNo;
+        int* m_next;
+    };
+
+    // One region of a parallel dispatch, and the executor. (See .cpp)
+    struct RegionTask;
+    struct RegionTasks;
+
+    // Payload buffers and functions. (See .cpp)
+    struct PayloadSlot;
+
+    // Destroy the payload, if any.
+    void dropPayload() noexcept;
+
+    // Do final exit handlers prior to destructing the fsm.
+    void cleanup() STATECHART_NOEXCEPT;
+
+    // Do initial entry calls when starting the fsm.
+    void setupTransition(const StateInfo* nextInfo,
+                         FsmBaseBase* fsm) STATECHART_NOEXCEPT;
+
+    // Follow choice pseudo-states from 'si' to the state they select.
+    const StateInfo* choose(const StateInfo* si,
+                            const FsmBaseBase* fsm) const STATECHART_NOEXCEPT
+    {
+        while (si && si->m_choice)
+        {
+            // The choice must select a state in the chart.
+            const int id = si->m_choice(fsm);
+            assert(id >= 0 && id < m_setup.stateNo());
+            si = m_setup.findState(id);
+            assert(si && si->valid());
+        }
+        return si;
+    }
+
+    // Apply a requested transition. 'target' may have
+    // localTransitionFlag set.
+    void applyTransition(int target, FsmBaseBase* fsm) STATECHART_NOEXCEPT;
+
+    // Do a normal state 2 state transition.
+    void doTransition(const StateInfo* nextInfo,
+                      FsmBaseBase* fsm) STATECHART_NOEXCEPT;
+
+    void doEntry(const StateInfo* newState,
+                 FsmBaseBase* fsm) STATECHART_NOEXCEPT;
+
+    // Exit 'currState'. 'leaf' is the deepest state active below it,
+    // or itself, kept if it keeps history.
+    void doExit(const StateInfo* currState,
+                const StateInfo* leaf) STATECHART_NOEXCEPT;
+
+    // Transition in a chart with orthogonal regions.
+    void doRegionTransition(const StateInfo* nextInfo,
+                            FsmBaseBase* fsm) STATECHART_NOEXCEPT;
+
+    // Enter the root path of 'target' from 'level', and the initial
+    // states of the orthogonal regions on the way.
+    void enterPath(const StateInfo* target, int level,
+                   FsmBaseBase* fsm) STATECHART_NOEXCEPT;
+
+    // Enter the initial states of the orthogonal regions [first, last)
+    // of 'si'.
+    void enterRegions(const StateInfo* si, FsmBaseBase* fsm, int first,
+                      int last) STATECHART_NOEXCEPT;
+
+    // Exit the active sub states of 'si'. Return the deepest state
+    // exited, of the first region, or nullptr if there are none.
+    const StateInfo* exitSubStates(const StateInfo* si) STATECHART_NOEXCEPT;
+
+    // Exit 'si' and its sub states. Return the deepest state exited.
+    const StateInfo* exitTree(const StateInfo* si) STATECHART_NOEXCEPT
+    {
+        const StateInfo* leaf = nullptr;
+        if (si->m_regionNo > 0)
+            leaf = exitSubStates(si);
+        if (!leaf)
+            leaf = si;
+        doExit(si, leaf);
+        return leaf;
+    }
+
+    bool dispatchTree(const StateInfo* si, int eventId, const void* event,
+                      Collector& collector) STATECHART_NOEXCEPT;
+
+    // Dispatch the regions of 'si' on the region executor.
+    bool dispatchParallel(const StateInfo* si, int eventId, const void* event,
+                          Collector& collector) STATECHART_NOEXCEPT;
+
+    // RegionExecutor::TaskFkn running one RegionTask.
+    static void runRegionTask(void* context, int task) STATECHART_NOEXCEPT;
+
+    // Set m_currentInfo after a transition with orthogonal regions.
+    void updateCurrent() noexcept;
+
+    const StateInfo*& stateInfo(int frame)
+    {
+        return m_frames[frame].m_stateInfo;
+    }
+
+    const StateInfo* stateInfo(int frame) const
+    {
+        return m_frames[frame].m_stateInfo;
+    }
+
+    // Block handed over by useBlock and the object it is meant for.
+    struct NextBlock
+    {
+        char* m_block;
+        const char* m_ownerBegin;
+        const char* m_ownerEnd;
+    };
+
+    // Consumed by the constructor of the instance inside the owner.
+    static thread_local NextBlock s_nextBlock;
+
+    // Target of transition() in the region task run by this thread.
+    static thread_local int* s_regionNext;
+
+    // The instance block, 'm_allocation' adjusted to a cache line. Empty
+    // when the block is owned by someone else.
+    std::unique_ptr<char[]> m_allocation;
+
+    size_t m_blockSize;
+
+    // Frame data at the start of the instance block.
+    LevelData* m_frames;
+
+    // Transitions collected from orthogonal regions during dispatch. One
+    // entry per region, after the frames in the instance block.
+    Pending* m_pending;
+    int m_pendingNo = 0;
+
+    // The leaf active when each state keeping history was last exited,
+    // nullptr before that. After the pending transitions.
+    const StateInfo** m_history;
+
+    // One bit per state id, set while the state is active. Updated on
+    // entry and exit. After the history.
+    ActiveWord* m_active;
+    int m_activeWordNo;
+
+    // State object storage in the instance block. Each state is at
+    // its StateInfo::m_offset.
+    char* m_storage;
+
+    const StateInfo* m_currentInfo = nullptr;
+
+    const FsmStaticData& m_setup;
+
+    int m_nextState = FsmStaticData::nullStateId;
+
+    // Set while regions are dispatched in parallel.
+    bool m_parallel = false;
+
+    // Executor and task storage for parallel dispatch, if enabled.
+    std::unique_ptr<RegionTasks> m_regionTasks;
+
+    StateExitObserver* m_exitObserver = nullptr;
+
+    // Target of the payload in m_payload, nullStateId without one.
+    int m_payloadTarget = FsmStaticData::nullStateId;
+
+    // Allocated by the first transition with a payload.
+    std::unique_ptr<PayloadSlot> m_payload;
+};
+
+class FsmBaseBase
+{
+public:
+    FsmBaseMember& member() 
+    {
+        return m_base;
+    }
+    const FsmBaseMember& member() const
+    {
+        return m_base;
+    }
+  protected:
+    FsmBaseBase(const FsmStaticData& setup, size_t queueBytes = 0)
+        : m_base(setup, queueBytes)
+    {
+    }
+
+    ~FsmBaseBase() {}
+
+    FsmBaseMember m_base;
+};
+
+template <class T>
+struct FsmVoid
+{
+    using type = void;
+};
+
+/**
+ * Event ids used by the dispatch cache. An FsmDesc enables the cache by
+ * supplying:
+ *
+ *   static constexpr int eventIdNo = ...;
+ *   static int eventId(const Event& ev); // In [0, eventIdNo).
+ *
+ * For each state and event id the level of the first state handling the
+ * event is then computed once, and dispatch jumps straight there.
+ * An EventVariant event type always uses the index of the alternative,
+ * 'eventIdNo' and 'eventId' are then ignored.
+ */
+template <class FsmDesc, class = void>
+struct FsmEventIds
+{
+    static const constexpr int eventIdNo = 0;
+
+    template <class Event>
+    static int id(const Event&)
+    {
+        return 0;
+    }
+};
+
+template <class FsmDesc>
+struct FsmEventIds<
+    FsmDesc, typename std::enable_if<
+                 EventVariantSize<typename FsmDesc::Event>::value == 0,
+                 FsmVoid<decltype(FsmDesc::eventIdNo)>>::type::type>
+{
+    static const constexpr int eventIdNo = FsmDesc::eventIdNo;
+
+    static_assert(eventIdNo > 0, "eventIdNo must be positive.");
+
+    static int id(const typename FsmDesc::Event& ev)
+    {
+        return FsmDesc::eventId(ev);
+    }
+};
+
+// Event ids of an EventVariant event type, the index of the alternative.
+template <class FsmDesc>
+struct FsmEventIds<FsmDesc,
+                   typename std::enable_if<(EventVariantSize<
+                       typename FsmDesc::Event>::value > 0)>::type>
+{
+    static const constexpr int eventIdNo =
+        EventVariantSize<typename FsmDesc::Event>::value;
+
+    static int id(const typename FsmDesc::Event& ev)
+    {
+        return ev.index();
+    }
+};
+
+/**
+ * Event ids handled by a state. Declared in the state class as
+ *
+ *   using HandledEvents = EventSet<EventKind, EventKind::a, EventKind::b>;
+ *
+ * Only the listed events are passed to 'event'. Without HandledEvents a
+ * state with an 'event' function is passed all events. The handler may
+ * still return false to let the event bubble to the parent.
+ */
+template <class Id, Id... ids>
+struct EventSet
+{
+    static constexpr bool contains(int id)
+    {
+        const int list[] = {static_cast<int>(ids)..., -1};
+        for (int i = 0; i < static_cast<int>(sizeof...(ids)); i++)
+            if (list[i] == id)
+                return true;
+        return false;
+    }
+};
+
+// Detect 'State::event(const Event&)' returning bool.
+template <class State, class Event, class = void>
+struct StateHasEvent
+{
+    static const constexpr bool value = false;
+};
+
+template <class State, class Event>
+struct StateHasEvent<State, Event,
+                     typename FsmVoid<decltype(std::declval<State&>().event(
+                         std::declval<const Event&>()))>::type>
+{
+    static const constexpr bool value = std::is_convertible<
+        decltype(std::declval<State&>().event(std::declval<const Event&>())),
+        bool>::value;
+};
+
+// Detect a member named 'event' in 'State', of any type. The name is
+// ambiguous in a class also deriving from StateEventName. Not detected
+// in final states.
+struct StateEventName
+{
+    int event;
+};
+
+template <class State>
+struct StateEventNameProbe : State, StateEventName
+{
+};
+
+template <class State, bool final = std::is_final<State>::value,
+          class = void>
+struct StateNamesEvent
+{
+    static const constexpr bool value = !final;
+};
+
+template <class State>
+struct StateNamesEvent<
+    State, false,
+    typename FsmVoid<decltype(&StateEventNameProbe<State>::event)>::type>
+{
+    static const constexpr bool value = false;
+};
+
+// Detect 'State::on(const E&)', a handler of one EventVariant alternative.
+template <class State, class E, class = void>
+struct StateHasOn
+{
+    static const constexpr bool value = false;
+};
+
+template <class State, class E>
+struct StateHasOn<State, E,
+                  typename FsmVoid<decltype(std::declval<State&>().on(
+                      std::declval<const E&>()))>::type>
+{
+    static const constexpr bool value = true;
+};
+
+// The alternatives of an EventVariant with an 'on' handler in 'State'.
+template <class State, class Event>
+struct StateOnHandlers
+{
+    static constexpr bool contains(int)
+    {
+        return false;
+    }
+};
+
+template <class State, class... Events>
+struct StateOnHandlers<State, EventVariant<Events...>>
+{
+    static constexpr bool contains(int id)
+    {
+        const bool handled[] = {StateHasOn<State, Events>::value...};
+        return handled[id];
+    }
+};
+
+// Detect 'State::HandledEvents'. Without it, all or no events are handled.
+template <class State, bool hasEvent, class = void>
+struct StateHandledEvents
+{
+    static constexpr bool contains(int)
+    {
+        return hasEvent;
+    }
+};
+
+template <class State, bool hasEvent>
+struct StateHandledEvents<
+    State, hasEvent, typename FsmVoid<typename State::HandledEvents>::type>
+{
+    static_assert(hasEvent, "HandledEvents given for a state without event.");
+
+    static constexpr bool contains(int id)
+    {
+        return State::HandledEvents::contains(id);
+    }
+};
+
+// Detect 'State::keepHistory'. See ShallowHistory.
+template <class State, class = void>
+struct StateKeepsHistory
+{
+    static const constexpr bool value = false;
+};
+
+template <class State>
+struct StateKeepsHistory<State,
+                         typename FsmVoid<decltype(State::keepHistory)>::type>
+{
+    static const constexpr bool value = State::keepHistory;
+};
+
+// Detect 'State::isChoice', set by ChoiceBase.
+template <class State, class = void>
+struct StateIsChoice
+{
+    static const constexpr bool value = false;
+};
+
+template <class State>
+struct StateIsChoice<State, typename FsmVoid<decltype(State::isChoice)>::type>
+{
+    static const constexpr bool value = State::isChoice;
+};
+
+/**
+ * History pseudo-states of 'State', used as transition targets:
+ *
+ *   transition<ShallowHistory<Parent>>();
+ *
+ * ShallowHistory enters the sub state of 'State' that was active when
+ * 'State' was last exited, DeepHistory the whole path down to the leaf
+ * that was active. Without a sub state active then, or if 'State' has
+ * not been active, 'State' itself is the target. The target is looked up
+ * when the transition is requested, and entered in one transition.
+ *
+ * 'State' declares 'static const constexpr bool keepHistory = true;'
+ * and has no orthogonal regions, itself or below it.
+ */
+template <class State>
+struct ShallowHistory
+{
+};
+
+template <class State>
+struct DeepHistory
+{
+};
+
+/**
+ * Mask of the event ids passed to a state, referenced by its StateInfo.
+ * Holds at least one entry so it can always be pointed to.
+ */
+template <class FsmDesc, class State>
+struct StateEventMask
+{
+    static const constexpr int size =
+        FsmEventIds<FsmDesc>::eventIdNo > 0 ? FsmEventIds<FsmDesc>::eventIdNo
+                                            : 1;
+    static const constexpr bool hasEvent =
+        StateHasEvent<State, typename FsmDesc::Event>::value;
+
+    // A mistyped 'event' would otherwise handle nothing.
+    static_assert(hasEvent || !StateNamesEvent<State>::value,
+                  "State::event is not callable as bool(const Event&).");
+
+    struct Mask
+    {
+        bool handled[size];
+    };
+
+    static constexpr Mask build()
+    {
+        Mask m{};
+        for (int id = 0; id < size; id++)
+            m.handled[id] =
+                StateHandledEvents<State, hasEvent>::contains(id) ||
+                StateOnHandlers<State, typename FsmDesc::Event>::contains(id);
+        return m;
+    }
+
+    static constexpr Mask mask = build();
+};
+
+template <class FsmDesc, class State>
+constexpr typename StateEventMask<FsmDesc, State>::Mask
+    StateEventMask<FsmDesc, State>::mask;
+
+/**
+ * Type erased functions for a particular state, stored in its StateInfo.
+ * Shared between the runtime and the compile time setup of the state
+ * tables. The state class is used directly, without virtual functions.
+ */
+template <class FsmDesc, class State>
+struct StateFkns
+{
+    static void* make(char* store, FsmBaseBase* fsm)
+    {
+        StateArgs args(fsm);
+        return new (store) State(args);
+    }
+
+    static void destroy(void* state)
+    {
+        static_cast<State*>(state)->~State();
+    }
+
+    using Event = typename FsmDesc::Event;
+    using Mask = StateEventMask<FsmDesc, State>;
+
+    static bool dispatch(void* state, const void* event)
+    {
+        return deliver(static_cast<State*>(state),
+                       *static_cast<const Event*>(event), Delivery());
+    }
+
+    // Passed to 'deliver' for EventVariant events.
+    struct VariantDelivery
+    {
+    };
+
+    using Delivery = typename std::conditional<
+        (EventVariantSize<Event>::value > 0), VariantDelivery,
+        std::integral_constant<bool, Mask::hasEvent>>::type;
+
+    // Jump to the handler of the alternative held. One entry per
+    // alternative, see 'deliverAlt'.
+    static bool deliver(State* state, const Event& ev, VariantDelivery)
+    {
+        return deliverVariant(
+            state, ev,
+            std::make_integer_sequence<int, EventVariantSize<Event>::value>());
+    }
+
+    template <int... I>
+    static bool deliverVariant(State* state, const Event& ev,
+                               std::integer_sequence<int, I...>)
+    {
+        using DeliverFkn = bool (*)(State*, const Event&);
+        static const DeliverFkn table[] = {&deliverAlt<I>...};
+        return table[ev.index()](state, ev);
+    }
+
+    // 'on' for the alternative if there is one, else 'event' if any.
+    template <int I>
+    static bool deliverAlt(State* state, const Event& ev)
+    {
+        using Alt = typename Event::template Alternative<I>;
+        using HasOn =
+            std::integral_constant<bool, StateHasOn<State, Alt>::value>;
+        return deliverOn(state, ev, ev.template get<Alt>(), HasOn());
+    }
+
+    template <class Alt>
+    static bool deliverOn(State* state, const Event&, const Alt& alt,
+                          std::true_type)
+    {
+        return state->on(alt);
+    }
+
+    template <class Alt>
+    static bool deliverOn(State* state, const Event& ev, const Alt&,
+                          std::false_type)
+    {
+        return deliver(state, ev,
+                       std::integral_constant<bool, Mask::hasEvent>());
+    }
+
+    static bool deliver(State* state, const Event& ev, std::true_type)
+    {
+        return state->event(ev);
+    }
+
+    // A state without an event function handles nothing.
+    static bool deliver(State*, const Event&, std::false_type)
+    {
+        return false;
+    }
+
+    static_assert(alignof(State) <= alignof(std::max_align_t),
+                  "over aligned states are not supported.");
+
+    static constexpr FsmStaticData::StateInfo info(int parentId, int level)
+    {
+        return FsmStaticData::StateInfo(
+            parentId, level, sizeof(State), &make, &destroy, &dispatch,
+            Mask::mask.handled, StateKeepsHistory<State>::value ? 0 : -1);
+    }
+};
+
+// The StateInfo of a choice pseudo-state. Passed no events.
+template <class FsmDesc, class Choice>
+struct ChoiceFkns
+{
+    using Fsm = typename FsmDesc::Fsm;
+
+    static int choose(const FsmBaseBase* fsm)
+    {
+        return static_cast<int>(Choice::choose(*static_cast<const Fsm*>(fsm)));
+    }
+
+    static constexpr FsmStaticData::StateInfo info(int parentId, int level)
+    {
+        FsmStaticData::StateInfo si(
+            parentId, level, 0, nullptr, nullptr, nullptr,
+            StateEventMask<FsmDesc, Choice>::mask.handled);
+        si.m_choice = &choose;
+        si.m_isChoice = true;
+        return si;
+    }
+};
+
+// StateFkns, or ChoiceFkns for a choice.
+template <class FsmDesc, class State>
+using FsmStateFkns =
+    typename std::conditional<StateIsChoice<State>::value,
+                              ChoiceFkns<FsmDesc, State>,
+                              StateFkns<FsmDesc, State>>::type;
+
+/**
+ * Arguments of StateBase::transition<State>(args...), moved into the
+ * constructor of 'State' after the StateArgs when it is entered.
+ */
+template <class State, class... Args>
+struct FsmPayload
+{
+    static_assert(!StateIsChoice<State>::value,
+                  "a choice takes no payload.");
+    static_assert(std::is_constructible<State, StateArgs&, Args&&...>::value,
+                  "target state has no constructor taking these arguments.");
+
+    template <class... Ts>
+    explicit FsmPayload(Ts&&... args) : m_args(std::forward<Ts>(args)...)
+    {
+    }
+
+    static void* make(void* payload, char* store, FsmBaseBase* fsm)
+    {
+        return static_cast<FsmPayload*>(payload)->construct(
+            store, fsm, std::index_sequence_for<Args...>());
+    }
+
+    static void destroy(void* payload)
+    {
+        static_cast<FsmPayload*>(payload)->~FsmPayload();
+    }
+
+    template <size_t... I>
+    void* construct(char* store, FsmBaseBase* fsm, std::index_sequence<I...>)
+    {
+        StateArgs args(fsm);
+        return new (store) State(args, std::move(std::get<I>(m_args))...);
+    }
+
+    std::tuple<Args...> m_args;
+};
+
+/**
+ * Helper class for setting up the FSM state description table at
+ * startup. Capture type information and forward it to the state table
+ * at construction.
+ */
+template <class FsmDesc>
+class FsmSetup
+{
+  public:
+    FsmSetup()
+        : m_builder(static_cast<int>(FsmDesc::StateId::stateIdNo),
+                    FsmEventIds<FsmDesc>::eventIdNo)
+    {
+        FsmDesc::setupStates(*this);
+        m_data = m_builder.finalize();
+    }
+
+    /**
+     * Add a bottom level state to the FSM. State will haVE 'level' == 0.
+     * @param State    Type name for the class that implement the state.
+     *                 Must inherit StateBase<...>.
+     */
+    template <class State>
+    void addState()
+    {
+        addState<State, State>();
+    }
+
+    /**
+     * Add a state to the FSM. State will have 'level one above the parent
+     * state.
+     * @param State    Type name for the class that implement the state.
+     *                 Must inherit StateBase<...>.
+     * @param ParentState State type for the parent state.
+     */
+    template <class State, class ParentState>
+    void addState()
+    {
+        addState<State, ParentState>(-1);
+    }
+
+    /**
+     * Add a state to orthogonal region 'region' of the parent state.
+     * All regions of a state are active together, each with one sub
+     * state. Regions are numbered from 0 and the sub state with the lowest
+     * id in a region is entered with the parent. A state has either plain
+     * sub states or sub states in regions.
+     * @param State    Type name for the class that implement the state.
+     *                 Must inherit StateBase<...>.
+     * @param ParentState State type for the parent state.
+     */
+    template <class State, class ParentState>
+    void addState(int region)
+    {
+        static_assert(static_cast<int>(State::stateId) !=
+                          FsmStaticData::nullStateId,
+                      "state id is reserved.");
+        static_assert(!StateIsChoice<State>::value,
+                      "add choices with addChoice.");
+        m_builder.addStateBase(static_cast<int>(State::stateId),
+                               static_cast<int>(ParentState::stateId),
+                               StateFkns<FsmDesc, State>::info(0, 0), region);
+    }
+
+    /**
+     * Add a choice pseudo-state, see ChoiceBase.
+     * @param Choice Type name for the class that implement the choice.
+     *               Must inherit ChoiceBase<...>.
+     */
+    template <class Choice>
+    void addChoice()
+    {
+        static_assert(StateIsChoice<Choice>::value,
+                      "choice must inherit ChoiceBase.");
+        const int id = static_cast<int>(Choice::stateId);
+        m_builder.addStateBase(id, id, ChoiceFkns<FsmDesc, Choice>::info(0, 0));
+    }
+
+    const FsmStaticData& data()
+    {
+        return m_data;
+    }
+
+  private:
+    FsmStaticBuilder m_builder;
+    FsmStaticData m_data;
+};
+
+/**
+ * Entry in a 'States' type list. Describe one state and its parent state.
+ * Leave out 'ParentState' for a bottom level state or a choice. Give
+ * 'Region' for a state in an orthogonal region of the parent, see
+ * FsmSetup::addState.
+ */
+template <class State, class ParentState = State, int Region = -1>
+struct StateDef
+{
+    using Type = State;
+    using Parent = ParentState;
+    static const constexpr int region = Region;
+};
+
+/**
+ * Compile time description of the state hierarchy. Instead of the
+ * 'setupStates' function an FsmDesc can supply:
+ *
+ *   using States = StateList<StateDef<S1>, StateDef<S2, S1>, ...>;
+ *
+ * The state tables are then computed by the compiler. No setup code runs
+ * at startup and missing parents, duplicated ids or cyclic parent chains
+ * are compile errors.
+ */
+template <class... Defs>
+struct StateList
+{
+};
+
+// Compile time state tables. Sizes are given as template arguments.
+template <int StateNo, int LevelNo, int LcaNo, int CacheNo, int RegionNo>
+struct FsmConstTable
+{
+    FsmStaticData::StateInfo states[StateNo];
+    size_t storageSize;
+    int frameNo;
+    int paths[StateNo * LevelNo];
+    signed char lca[LcaNo];
+    FsmStaticData::CacheLevel firstHandler[CacheNo];
+    FsmStaticData::RegionInfo regions[RegionNo];
+};
+
+/**
+ * Compute the state tables from a StateList. All functions are constexpr.
+ * Definitions are indexed in type list order, 'd' below.
+ */
+template <class FsmDesc, class List>
+struct FsmConstPlan;
+
+template <class FsmDesc, class... Defs>
+struct FsmConstPlan<FsmDesc, StateList<Defs...>>
+{
+    using StateInfo = FsmStaticData::StateInfo;
+
+    static_assert(sizeof...(Defs) > 0, "States must list at least one state.");
+
+    static const constexpr int stateNo =
+        static_cast<int>(FsmDesc::StateId::stateIdNo);
+    static const constexpr int defNo = sizeof...(Defs);
+    static const constexpr int eventIdNo = FsmEventIds<FsmDesc>::eventIdNo;
+
+    static constexpr int id(int d)
+    {
+        const int ids[] = {static_cast<int>(Defs::Type::stateId)...};
+        return ids[d];
+    }
+
+    static constexpr int parent(int d)
+    {
+        const int ids[] = {static_cast<int>(Defs::Parent::stateId)...};
+        return ids[d];
+    }
+
+    static constexpr int region(int d)
+    {
+        const int regions[] = {Defs::region...};
+        return regions[d];
+    }
+
+    static constexpr StateInfo info(int d, int lvl)
+    {
+        const StateInfo infos[] = {
+            FsmStateFkns<FsmDesc, typename Defs::Type>::info(parent(d),
+                                                             lvl)...};
+        StateInfo si = infos[d];
+        si.m_region = lvl > 0 ? region(d) : -1;
+        return si;
+    }
+
+    // Return the definition index for state 'stateId', or -1.
+    static constexpr int defIndex(int stateId)
+    {
+        for (int d = 0; d < defNo; d++)
+            if (id(d) == stateId)
+                return d;
+        return -1;
+    }
+
+    static constexpr bool idsValid()
+    {
+        for (int d = 0; d < defNo; d++)
+        {
+            if (id(d) < 0 || id(d) >= stateNo)
+                return false;
+            if (defIndex(id(d)) != d)
+                return false;
+        }
+        return true;
+    }
+
+    static constexpr bool parentsListed()
+    {
+        for (int d = 0; d < defNo; d++)
+            if (defIndex(parent(d)) < 0)
+                return false;
+        return true;
+    }
+
+    // Return the level of definition 'd', or -1 if the parent chain is
+    // broken or cyclic.
+    static constexpr int level(int d)
+    {
+        int lvl = 0;
+        while (d >= 0 && parent(d) != id(d))
+        {
+            d = defIndex(parent(d));
+            if (++lvl >= defNo)
+                return -1;
+        }
+        return d < 0 ? -1 : lvl;
+    }
+
+    static constexpr bool acyclic()
+    {
+        for (int d = 0; d < defNo; d++)
+            if (level(d) < 0)
+                return false;
+        return true;
+    }
+
+    static constexpr int levelNo()
+    {
+        int levels = 1;
+        for (int d = 0; d < defNo; d++)
+            if (level(d) + 1 > levels)
+                levels = level(d) + 1;
+        return levels;
+    }
+
+    static constexpr bool hasLca()
+    {
+        return FsmStaticData::hasLcaTable(stateNo, levelNo());
+    }
+
+    // Number of regions, see FsmStaticData::countRegions.
+    static constexpr int regionNo()
+    {
+        StateInfo states[stateNo] = {};
+        for (int d = 0; d < defNo; d++)
+            if (level(d) >= 0)
+                states[id(d)] = info(d, level(d));
+        return FsmStaticData::countRegions(states, stateNo);
+    }
+
+    using Table =
+        FsmConstTable<stateNo, levelNo(), hasLca() ? stateNo * stateNo : 1,
+                      (eventIdNo > 0 ? stateNo * eventIdNo : 1),
+                      (regionNo() > 0 ? regionNo() : 1)>;
+
+    static constexpr Table build()
+    {
+        Table t{};
+        for (int d = 0; d < defNo; d++)
+        {
+            const int lvl = level(d);
+            if (lvl < 0)
+                continue;
+            t.states[id(d)] = info(d, lvl);
+        }
+        FsmStaticData::planPaths(t.states, stateNo, levelNo(), t.paths);
+        FsmStaticData::countRegions(t.states, stateNo);
+        FsmStaticData::planRegions(t.states, stateNo, t.regions);
+        FsmStaticData::planHistory(t.states, stateNo);
+        t.storageSize = FsmStaticData::planOffsets(
+            t.states, stateNo, levelNo(), t.regions, &t.frameNo);
+        if (hasLca())
+            FsmStaticData::planLca(t.states, stateNo, levelNo(), t.paths,
+                                   t.lca);
+        FsmStaticData::planDispatch(t.states, stateNo, levelNo(), t.paths,
+                                    eventIdNo, t.firstHandler);
+        return t;
+    }
+};
+
+/**
+ * Static data for an FsmDesc with a 'States' type list. Both the tables
+ * and the FsmStaticData view are constant expressions.
+ */
+template <class FsmDesc>
+class FsmConstSetup
+{
+    using Plan = FsmConstPlan<FsmDesc, typename FsmDesc::States>;
+
+    static_assert(Plan::idsValid(),
+                  "state id out of range or listed twice in States.");
+    static_assert(Plan::parentsListed(), "parent state missing in States.");
+    static_assert(Plan::acyclic(), "cyclic parent chain in States.");
+
+  public:
+    static constexpr typename Plan::Table table = Plan::build();
+
+    static_assert(FsmStaticData::regionsValid(table.states, Plan::stateNo,
+                                              table.regions),
+                  "mixed plain and region sub states, or empty region.");
+    static_assert(FsmStaticData::historyValid(table.states, Plan::stateNo),
+                  "state keeping history with orthogonal regions.");
+    static_assert(FsmStaticData::choicesValid(table.states, Plan::stateNo),
+                  "choice with a parent or sub states.");
+
+    static constexpr FsmStaticData data{
+        table.states,      Plan::stateNo,
+        Plan::levelNo(),   table.storageSize,
+        table.paths,       Plan::hasLca() ? table.lca : nullptr,
+        Plan::eventIdNo,   table.firstHandler,
+        table.regions,     Plan::regionNo(),
+        table.frameNo};
+};
+
+template <class FsmDesc>
+constexpr typename FsmConstSetup<FsmDesc>::Plan::Table
+    FsmConstSetup<FsmDesc>::table;
+
+template <class FsmDesc>
+constexpr FsmStaticData FsmConstSetup<FsmDesc>::data;
+
+/**
+ * Select how the static data for an FsmDesc is set up. Through
+ * 'setupStates' on first use, or at compile time if the description
+ * has a 'States' type list.
+ */
+template <class FsmDesc, class = void>
+struct FsmStaticInstance
+{
+    static const FsmStaticData& get()
+    {
+        static FsmSetup<FsmDesc> base;
+        return base.data();
+    }
+};
+
+template <class FsmDesc>
+struct FsmStaticInstance<FsmDesc,
+                         typename FsmVoid<typename FsmDesc::States>::type>
+{
+    static const FsmStaticData& get()
+    {
+        return FsmConstSetup<FsmDesc>::data;
+    }
+};
+
+/**
+ * Number of events the queue of an FSM holds before it allocates.
+ * Set by an optional 'static constexpr size_t queueCapacity' in the FsmDesc.
+ */
+template <class FsmDesc, class = void>
+struct FsmQueueCapacity
+{
+    static const constexpr size_t value = 16;
+};
+
+template <class FsmDesc>
+struct FsmQueueCapacity<FsmDesc,
+                        typename FsmVoid<decltype(FsmDesc::queueCapacity)>::type>
+{
+    static const constexpr size_t value = FsmDesc::queueCapacity;
+};
+
+/**
+ * Queue type used for the events of an FSM. Set by an optional
+ * 'using Queue = ...' in the FsmDesc. Available queues:
+ * - RingQueue<Event>: Single threaded ring buffer. (default)
+ * - VecQueue<Event, BufferAllocator<Event>>: Single threaded, vector based.
+ * - MpscQueue<Event>: Events can be posted from any thread.
+ *
+ * A queue type has a constructor taking initial storage (El*, capacity),
+ * a static 'bufferBytes(capacity)' giving the storage it wants in the
+ * instance block and a static bool 'concurrent'.
+ */
+template <class FsmDesc, class = void>
+struct FsmQueueType
+{
+    using type = RingQueue<typename FsmDesc::Event>;
+};
+
+template <class FsmDesc>
+struct FsmQueueType<FsmDesc, typename FsmVoid<typename FsmDesc::Queue>::type>
+{
+    using type = typename FsmDesc::Queue;
+};
+
+template <class Event, class Queue = RingQueue<Event>,
+          class EventIds = FsmEventIds<void>>
+class FsmBaseEvent : public FsmBaseBase
+{
+    static_assert(alignof(Event) <= alignof(std::max_align_t),
+                  "over aligned events are not supported.");
+
+  public:
+    // The initial queue capacity is placed in the FSM instance block.
+    FsmBaseEvent(const FsmStaticData& setup, size_t queueCapacity)
+        : FsmBaseBase(setup, Queue::bufferBytes(queueCapacity)),
+          m_eventQueue(static_cast<Event*>(member().queueStorage()),
+                       queueCapacity)
+    {
+    }
+
+    /**
+     * Post an event and process it unless the FSM is already processing
+     * an event. Recommended unless finer grained control is needed.
+     *
+     * When the FSM is idle and the queue is empty the event is dispatched
+     * directly, without going through the queue. Events posted from
+     * handlers are queued and processed before postEvent returns.
+     *
+     * With a concurrent queue this may be called from any thread and only
+     * enqueues the event. A single consumer thread calls processQueue.
+     * Events posted from handlers end up in the same queue and are
+     * processed by the running processQueue call.
+     */
+    void postEvent(const Event& ev) STATECHART_NOEXCEPT
+    {
+        if (idle())
+            processDirect(ev);
+        else
+            m_eventQueue.push(ev);
+    }
+
+    void postEvent(Event&& ev) STATECHART_NOEXCEPT
+    {
+        if (idle())
+            processDirect(ev);
+        else
+            m_eventQueue.push(std::move(ev));
+    }
+
+    // Construct an event in place, then process it like postEvent.
+    template <class... Args>
+    void emplaceEvent(Args&&... args) STATECHART_NOEXCEPT
+    {
+        if (idle())
+        {
+            const Event ev(std::forward<Args>(args)...);
+            processDirect(ev);
+        }
+        else
+            m_eventQueue.emplace(std::forward<Args>(args)...);
+    }
+
+    // Add an event to the queue without processing it.
+    void addEvent(const Event& ev) STATECHART_NOEXCEPT
+    {
+        m_eventQueue.push(ev);
+    }
+
+    void addEvent(Event&& ev) STATECHART_NOEXCEPT
+    {
+        m_eventQueue.push(std::move(ev));
+    }
+
+    // Process the queue. Does nothing when called from a handler.
+    // With a concurrent queue, only call this from one thread at a time.
+    void processQueue() STATECHART_NOEXCEPT
+    {
+        if (m_processing)
+            return;
+
+        ProcessingScope scope(m_processing);
+        processPending();
+    }
+
+  private:
+    // Mark the FSM as processing events for the life time of the object.
+    struct ProcessingScope
+    {
+        explicit ProcessingScope(bool& processing) : m_processing(processing)
+        {
+            m_processing = true;
+        }
+        ~ProcessingScope()
+        {
+            m_processing = false;
+        }
+        bool& m_processing;
+    };
+
+    // True when a posted event can be dispatched without the queue.
+    bool idle() const
+    {
+        return !Queue::concurrent && !m_processing && m_eventQueue.empty();
+    }
+
+    void processDirect(const Event& ev) STATECHART_NOEXCEPT
+    {
+        ProcessingScope scope(m_processing);
+        processEvent(ev);
+        processPending();
+    }
+
+    // Require m_processing to be set, so posts from the handlers are
+    // only queued.
+    void processPending() STATECHART_NOEXCEPT
+    {
+        while (!m_eventQueue.empty())
+        {
+            // Move the event out in case the queue reallocate during the
+            // event processing. (due to internal event posting.)
+            Event ev(std::move(m_eventQueue.front()));
+            m_eventQueue.pop();
+            processEvent(ev);
+        }
+    }
+
+    void processEvent(const Event& ev) STATECHART_NOEXCEPT
+    {
+        auto activeInfo = member().activeStateInfo();
+        if (!activeInfo)
+            return;
+
+        const int id = EventIds::eventIdNo > 0 ? EventIds::id(ev) : -1;
+        assert(EventIds::eventIdNo == 0 ||
+               (id >= 0 && id < EventIds::eventIdNo));
+        if (member().hasRegions())
+            member().dispatchRegions(id, &ev);
+        else if (EventIds::eventIdNo > 0)
+            member().dispatchCached(id, &ev);
+        else
+        {
+            bool eventHandled = false;
+            int level = activeInfo->m_level;
+            while (!eventHandled && level >= 0)
+            {
+                eventHandled = member().dispatch(level, &ev);
+                level--;
+            }
+        }
+        member().possiblyDoTransition(this);
+    }
+
+    Queue m_eventQueue;
+
+    // Set while events are processed. Posts are then only queued.
+    bool m_processing = false;
+};
+
+/**
+ * Set of states of an FSM, checked against the active states in one pass
+ * by FsmBase::isInAny and isInAll. Built at compile time with
+ *
+ *   constexpr auto guard = FsmStateSet<Desc>::of<StateA, StateB>();
+ */
+template <class FsmDesc>
+class FsmStateSet
+{
+  public:
+    using StateId = typename FsmDesc::StateId;
+    using Word = FsmBaseMember::ActiveWord;
+
+    static const constexpr int wordNo = FsmBaseMember::activeWordNo(
+        static_cast<int>(StateId::stateIdNo));
+
+    constexpr FsmStateSet() : m_words{} {}
+
+    constexpr FsmStateSet(std::initializer_list<StateId> ids) : m_words{}
+    {
+        for (StateId id : ids)
+            add(id);
+    }
+
+    template <class... States>
+    static constexpr FsmStateSet of()
+    {
+        return FsmStateSet{States::stateId...};
+    }
+
+    constexpr FsmStateSet& add(StateId id)
+    {
+        const int i = static_cast<int>(id);
+        m_words[i / FsmBaseMember::activeWordBits] |=
+            Word(1) << (i % FsmBaseMember::activeWordBits);
+        return *this;
+    }
+
+    constexpr bool contains(StateId id) const
+    {
+        const int i = static_cast<int>(id);
+        return (m_words[i / FsmBaseMember::activeWordBits] >>
+                (i % FsmBaseMember::activeWordBits)) &
+               1;
+    }
+
+    const Word* words() const
+    {
+        return m_words;
+    }
+
+  private:
+    Word m_words[wordNo];
 };
 
 /**
  * Base class for the custom FSM.
  */
 template <class FsmDesc>
-class FsmBase : public FsmBaseEvent<typename FsmDesc::Event>
+class FsmBase
+    : public FsmBaseEvent<typename FsmDesc::Event,
+                          typename FsmQueueType<FsmDesc>::type,
+                          FsmEventIds<FsmDesc>>
 {
   public:
     using StateId = typename FsmDesc::StateId;
     using Event = typename FsmDesc::Event;
+    using Queue = typename FsmQueueType<FsmDesc>::type;
     using FsmDescription = FsmDesc;
     using FsmBaseBase::member;
 
@@ -503,7 +2466,11 @@ class FsmBase : public FsmBaseEvent<typename FsmDesc::Event>
         return static_cast<StateId>(FsmStaticData::nullStateId);
     }
 
-    FsmBase() : FsmBaseEvent<Event>(instance()) {}
+    FsmBase()
+        : FsmBaseEvent<Event, Queue, FsmEventIds<FsmDesc>>(
+              instance(), FsmQueueCapacity<FsmDesc>::value)
+    {
+    }
 
     ~FsmBase() = default;
 
@@ -511,7 +2478,7 @@ class FsmBase : public FsmBaseEvent<typename FsmDesc::Event>
      * Set start state and perform initial jump to that state.
      * After this, it is legal to send events into the HSM.
      */
-    void setStartState(StateId id)
+    void setStartState(StateId id) STATECHART_NOEXCEPT
     {
         member().setStartState(static_cast<int>(id), this);
     }
@@ -519,7 +2486,7 @@ class FsmBase : public FsmBaseEvent<typename FsmDesc::Event>
     /**
      * Return the identifier of the currently active state.
      */
-    StateId currentStateId() const
+    StateId currentStateId() const noexcept
     {
         return static_cast<StateId>(member().activeStateId());
     }
@@ -528,20 +2495,68 @@ class FsmBase : public FsmBaseEvent<typename FsmDesc::Event>
      * Return the current active state object. Do note that this
      * requires knowledge of the active state and it's type. If the
      * State type is a mismatch, nullptr will be returned. Typically used
-     * in conjunction with currentStateId. Also, not very fast.
+     * in conjunction with currentStateId. With a 'States' type list the
+     * state and its frame are constants, so this is a compare and a load.
      */
     template <class State>
-    const State* currentState() const;
+    const State* currentState() const noexcept;
 
     /**
      * Return an active state object. This is one of the current state
      * or one of its substates that are currently active. Which one
      * is determined by the supplied template class. If the
      * State type is a mismatch, nullptr will be returned. Typically used
-     * in conjunction with currentStateId. Also, not very fast.
+     * in conjunction with currentStateId. Cheap like currentState.
      */
     template <class State>
-    const State* activeState() const;
+    const State* activeState() const noexcept;
+
+    // True if state 'id' is active. A single bit test.
+    bool isIn(StateId id) const noexcept
+    {
+        return member().isIn(static_cast<int>(id));
+    }
+
+    template <class State>
+    bool isIn() const noexcept
+    {
+        return member().isIn(static_cast<int>(State::stateId));
+    }
+
+    // True if any, or all, of the states in 'set' are active.
+    bool isInAny(const FsmStateSet<FsmDesc>& set) const noexcept
+    {
+        return member().isInAny(set.words());
+    }
+
+    bool isInAll(const FsmStateSet<FsmDesc>& set) const noexcept
+    {
+        return member().isInAll(set.words());
+    }
+
+    /**
+     * Dispatch the orthogonal regions of each event in parallel on
+     * 'executor' (see RegionPool), or sequentially with nullptr. The
+     * event is done, and the transitions applied, when all regions are
+     * done. Handlers in different regions then run concurrently, and
+     * may only share data that is safe to use from several threads.
+     * Posting events from them needs a concurrent queue.
+     */
+    void setRegionExecutor(RegionExecutor* executor)
+    {
+        member().setRegionExecutor(executor);
+    }
+
+    /**
+     * Tell 'observer' the id of each state exited, see FsmTimeouts.
+     * nullptr removes it. The observer must be removed before it is
+     * destroyed, or outlive the FSM, which exits its states when
+     * destroyed.
+     */
+    void setExitObserver(StateExitObserver* observer)
+    {
+        member().setExitObserver(observer);
+    }
 
   private:
     template <class FD, typename FD::StateId id>
@@ -549,54 +2564,171 @@ class FsmBase : public FsmBaseEvent<typename FsmDesc::Event>
 
     static const FsmStaticData& instance()
     {
-        static FsmSetup<FsmDesc> base;
-        return base.data();
+        return FsmStaticInstance<FsmDesc>::get();
+    }
+
+  public:
+    // Size of the instance block of every FSM of this type.
+    static size_t instanceBlockSize()
+    {
+        return FsmBaseMember::blockSizeFor(
+            instance(), Queue::bufferBytes(FsmQueueCapacity<FsmDesc>::value));
+    }
+};
+
+/**
+ * StateInfo and frame of 'State'. Constant expressions when the state
+ * tables are computed at compile time, so an active state object is one
+ * load from its frame. Otherwise read from the static data.
+ */
+template <class FsmDesc, class State, class = void>
+struct FsmStateLookup
+{
+    static const constexpr int id = static_cast<int>(State::stateId);
+
+    static const FsmStaticData::StateInfo* info(const FsmStaticData& setup)
+    {
+        return setup.findState(id);
+    }
+
+    static int frame(const FsmStaticData& setup)
+    {
+        return info(setup)->m_frame;
+    }
+
+    // Not known until the tables are set up. Checked by assert instead.
+    static constexpr bool isAncestorOf(int)
+    {
+        return true;
+    }
+};
+
+template <class FsmDesc, class State>
+struct FsmStateLookup<FsmDesc, State,
+                      typename FsmVoid<typename FsmDesc::States>::type>
+{
+    using Setup = FsmConstSetup<FsmDesc>;
+
+    static const constexpr int id = static_cast<int>(State::stateId);
+
+    static constexpr const FsmStaticData::StateInfo*
+    info(const FsmStaticData&)
+    {
+        return &Setup::table.states[id];
+    }
+
+    static constexpr int frame(const FsmStaticData&)
+    {
+        return Setup::table.states[id].m_frame;
+    }
+
+    // True if 'State' is a parent of 'stateId', at any distance.
+    static constexpr bool isAncestorOf(int stateId)
+    {
+        return Setup::table.states[id].valid() &&
+               Setup::table.states[id].m_level <
+                   Setup::table.states[stateId].m_level &&
+               Setup::table.paths[stateId * Setup::data.levelNo() +
+                                  Setup::table.states[id].m_level] == id;
     }
 };
 
 template <typename FsmDesc, typename FsmDesc::StateId stId>
 template <class ParentState>
 ParentState&
-StateBase<FsmDesc, stId>::parent()
+StateBase<FsmDesc, stId>::parent() noexcept
 {
-    StateId parentId = ParentState::stateId;
-    ModelBase* mb = fsm().member().parent(static_cast<int>(parentId));
-    return static_cast<StateModel<FsmDesc, ParentState>*>(mb)->m_state;
+    using Lookup = FsmStateLookup<FsmDesc, ParentState>;
+    static_assert(Lookup::isAncestorOf(static_cast<int>(stId)),
+                  "ParentState is not a parent of this state.");
+
+    FsmBaseMember& member = fsm().member();
+    assert(member.isActive(Lookup::info(member.setup())));
+    void* p = member.getState(Lookup::frame(member.setup()));
+    return *static_cast<ParentState*>(p);
 }
 
+// Request a transition to a state or a history pseudo-state.
+template <class Target>
+struct FsmTarget
+{
+    static void request(FsmBaseMember& member) noexcept
+    {
+        member.transition(static_cast<int>(Target::stateId));
+    }
+};
+
+template <class State, bool deep>
+struct FsmHistoryTarget
+{
+    static_assert(StateKeepsHistory<State>::value,
+                  "history target must declare keepHistory.");
+
+    static void request(FsmBaseMember& member) noexcept
+    {
+        member.historyTransition(static_cast<int>(State::stateId), deep);
+    }
+};
+
+template <class State>
+struct FsmTarget<ShallowHistory<State>> : FsmHistoryTarget<State, false>
+{
+};
+
+template <class State>
+struct FsmTarget<DeepHistory<State>> : FsmHistoryTarget<State, true>
+{
+};
+
 template <typename FsmDesc, typename FsmDesc::StateId stId>
 template <typename TargetState>
 void
-StateBase<FsmDesc, stId>::transition()
+StateBase<FsmDesc, stId>::transition() noexcept
 {
-    static constexpr const StateId targetId = TargetState::stateId;
-    m_fsm->member().transition(static_cast<int>(targetId));
+    FsmTarget<TargetState>::request(m_fsm->member());
+}
+
+template <typename FsmDesc, typename FsmDesc::StateId stId>
+template <typename TargetState, typename Arg, typename... Args>
+void
+StateBase<FsmDesc, stId>::transition(Arg&& arg,
+                                     Args&&... args) STATECHART_NOEXCEPT
+{
+    using Payload = FsmPayload<TargetState, typename std::decay<Arg>::type,
+                               typename std::decay<Args>::type...>;
+    static_assert(alignof(Payload) <= alignof(std::max_align_t),
+                  "over aligned payloads are not supported.");
+
+    FsmBaseMember& member = m_fsm->member();
+    new (member.payloadStore(sizeof(Payload)))
+        Payload(std::forward<Arg>(arg), std::forward<Args>(args)...);
+    const int id = static_cast<int>(TargetState::stateId);
+    member.setPayload(id, &Payload::make, &Payload::destroy);
+    member.transition(id);
 }
 
 template <class FsmDesc>
 template <class State>
 const State*
-FsmBase<FsmDesc>::currentState() const
+FsmBase<FsmDesc>::currentState() const noexcept
 {
-    if (State::stateId !=
-        static_cast<StateId>(member().activeStateId()))
+    using Lookup = FsmStateLookup<FsmDesc, State>;
+    if (member().activeStateInfo() != Lookup::info(member().setup()))
         return nullptr;
-
-    const FsmStaticData::StateInfo* p = member().activeStateInfo();
-
-    const auto* mb = member().getModelBase(p->m_level);
-    return &(static_cast<const StateModel<FsmDesc, State>*>(mb)->m_state);
+    return static_cast<const State*>(
+        member().getState(Lookup::frame(member().setup())));
 }
 
 template <class FsmDesc>
 template <class State>
 const State*
-FsmBase<FsmDesc>::activeState() const
+FsmBase<FsmDesc>::activeState() const noexcept
 {
-    int targetId = static_cast<int>(State::stateId);
-    const ModelBase* mb = member().activeState(targetId);
-    return mb ? &(static_cast<const StateModel<FsmDesc, State>*>(mb)->m_state)
-              : nullptr;
+    using Lookup = FsmStateLookup<FsmDesc, State>;
+    if (!member().isActive(Lookup::info(member().setup())))
+        return nullptr;
+    return static_cast<const State*>(
+        member().getState(Lookup::frame(member().setup())));
 }
 
 #endif /* SRC_STATECHART_STATECHART_H_ */
@@ -0,0 +1,216 @@
+/*
+ * TimerWheel.cpp
+ *
+ *  Created on: 15 okt. 2026
+ *      Author: mikaelr
+ */
+
+#include "TimerWheel.h"
+
+const constexpr TimerWheel::Tick TimerWheel::never;
+const constexpr int TimerWheel::levelNo;
+const constexpr int TimerWheel::level0Bits;
+const constexpr int TimerWheel::levelBits;
+const constexpr int TimerWheel::level0Slots;
+const constexpr int TimerWheel::levelSlots;
+
+void
+TimerWheel::Timer::cancel()
+{
+    if (armed())
+        m_wheel->unlink(*this);
+}
+
+TimerWheel::TimerWheel(Tick now) : m_now(now)
+{
+    for (auto& level : m_levels)
+        for (auto& head : level)
+            head.m_next = head.m_prev = &head;
+}
+
+TimerWheel::~TimerWheel()
+{
+    for (int level = 0; level < levelNo; level++)
+        for (int i = 0; i < slotNo(level); i++)
+        {
+            Link& head = m_levels[level][i];
+            while (!empty(head))
+                unlink(*static_cast<Timer*>(head.m_next));
+        }
+}
+
+void
+TimerWheel::arm(Timer& timer, Tick expiry)
+{
+    timer.cancel();
+    timer.m_wheel = this;
+    timer.m_expiry = expiry > m_now ? expiry : m_now + 1;
+    place(timer);
+    m_size++;
+}
+
+void
+TimerWheel::place(Timer& timer)
+{
+    const Tick delta = timer.m_expiry - m_now;
+    // Level 'l' holds the timers expiring within 2^shift(l + 1) ticks.
+    int level = 0;
+    while (level < levelNo - 1 && delta >= Tick(1) << shift(level + 1))
+        level++;
+
+    // Beyond the top level, wait in its furthest slot and cascade again.
+    Tick at = timer.m_expiry;
+    const Tick span = Tick(levelSlots - 1) << shift(levelNo - 1);
+    if (level == levelNo - 1 && delta > span)
+        at = m_now + span;
+
+    timer.m_level = level;
+    m_levelSize[level]++;
+    Link& head = slot(level, at);
+    timer.m_prev = head.m_prev;
+    timer.m_next = &head;
+    head.m_prev->m_next = &timer;
+    head.m_prev = &timer;
+}
+
+void
+TimerWheel::unlink(Timer& timer)
+{
+    timer.m_prev->m_next = timer.m_next;
+    timer.m_next->m_prev = timer.m_prev;
+    timer.m_next = timer.m_prev = nullptr;
+    m_levelSize[timer.m_level]--;
+    m_size--;
+}
+
+void
+TimerWheel::cascade(int level)
+{
+    Link& head = slot(level, m_now);
+    while (!empty(head))
+    {
+        Timer& timer = *static_cast<Timer*>(head.m_next);
+        timer.m_prev->m_next = timer.m_next;
+        timer.m_next->m_prev = timer.m_prev;
+        m_levelSize[level]--;
+        place(timer);
+    }
+}
+
+void
+TimerWheel::advance(Tick now)
+{
+    while (m_now < now)
+    {
+        if (m_size == 0)
+        {
+            m_now = now;
+            break;
+        }
+        // Nothing to fire before level 0 wraps, skip ahead.
+        if (m_levelSize[0] == 0)
+        {
+            const Tick wrap = (m_now | (level0Slots - 1)) + 1;
+            if (wrap > now)
+            {
+                m_now = now;
+                break;
+            }
+            m_now = wrap - 1;
+        }
+        m_now++;
+
+        // When a level wraps, bring down the next slot of the level above.
+        for (int level = 1; level < levelNo; level++)
+        {
+            if (m_now & ((Tick(1) << shift(level)) - 1))
+                break;
+            cascade(level);
+        }
+
+        Link& head = slot(0, m_now);
+        while (!empty(head))
+        {
+            Timer& timer = *static_cast<Timer*>(head.m_next);
+            unlink(timer);
+            timer.m_fire(&timer);
+        }
+    }
+}
+
+TimerWheel::Tick
+TimerWheel::nextExpiry() const
+{
+    if (m_size == 0)
+        return never;
+
+    for (Tick t = m_now + 1; t <= m_now + level0Slots; t++)
+        if (!empty(m_levels[0][t & (level0Slots - 1)]))
+            return t;
+
+    // The timers of a higher level slot expire no earlier than the tick
+    // where the slot is cascaded.
+    Tick earliest = never;
+    for (int level = 1; level < levelNo; level++)
+    {
+        const Tick slotTicks = Tick(1) << shift(level);
+        const Tick current = m_now >> shift(level);
+        for (Tick s = current + 1; s <= current + levelSlots; s++)
+            if (!empty(m_levels[level][s & (levelSlots - 1)]))
+            {
+                if (s * slotTicks < earliest)
+                    earliest = s * slotTicks;
+                break;
+            }
+    }
+    return earliest;
+}
+
+TimerService::TimerService(Duration resolution, Clock::time_point start)
+    : m_start(start), m_resolution(resolution)
+{
+}
+
+TimerWheel::Tick
+TimerService::ticks(Duration d) const
+{
+    if (d <= Duration::zero())
+        return 0;
+    return (d + m_resolution - Duration(1)) / m_resolution;
+}
+
+TimerWheel::Tick
+TimerService::tickAt(Clock::time_point time) const
+{
+    return ticks(time - m_start);
+}
+
+void
+TimerService::arm(Timer& timer, Duration after)
+{
+    m_wheel.arm(timer, tickAt(Clock::now() + after));
+}
+
+void
+TimerService::rearm(Timer& timer, Duration period)
+{
+    m_wheel.arm(timer, timer.expiry() + ticks(period));
+}
+
+void
+TimerService::advance(Clock::time_point now)
+{
+    // Only whole ticks that have passed.
+    if (now > m_start)
+        m_wheel.advance((now - m_start) / m_resolution);
+}
+
+TimerService::Duration
+TimerService::timeUntilNext(Clock::time_point now) const
+{
+    const auto next = m_wheel.nextExpiry();
+    if (next == TimerWheel::never)
+        return Duration::max();
+    const auto at = m_start + m_resolution * static_cast<Duration::rep>(next);
+    return at > now ? at - now : Duration::zero();
+}
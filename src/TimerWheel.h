@@ -0,0 +1,402 @@
+/*
+ * TimerWheel.h
+ *
+ *  Created on: 15 okt. 2026
+ *      Author: mikaelr
+ */
+
+#ifndef SRC_STATECHART_TIMERWHEEL_H_
+#define SRC_STATECHART_TIMERWHEEL_H_
+
+#include "StateChart.h"
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/**
+ * Hierarchical timing wheel. Time is counted in ticks. Level 0 has one
+ * slot per tick for the next 256 ticks, each higher level has 64 slots
+ * covering 64 slots of the level below. Timers are intrusive list nodes,
+ * so arm and cancel are O(1) and need no allocation. Advancing moves the
+ * timers of a higher level slot down when the level below wraps.
+ *
+ * Not thread safe. Use one wheel per thread.
+ */
+class TimerWheel
+{
+  public:
+    using Tick = std::uint64_t;
+
+    static const constexpr Tick never = ~Tick(0);
+
+  private:
+    struct Link
+    {
+        Link* m_next = nullptr;
+        Link* m_prev = nullptr;
+    };
+
+  public:
+    /**
+     * A timer. Calls its fire function on expiry. Cancelled when
+     * destructed.
+     */
+    class Timer : private Link
+    {
+      public:
+        using FireFkn = void (*)(Timer*);
+
+        explicit Timer(FireFkn fire) : m_fire(fire) {}
+        Timer(const Timer&) = delete;
+        Timer& operator=(const Timer&) = delete;
+
+        ~Timer()
+        {
+            cancel();
+        }
+
+        bool armed() const
+        {
+            return m_next != nullptr;
+        }
+
+        // Tick of the last arm.
+        Tick expiry() const
+        {
+            return m_expiry;
+        }
+
+        void cancel();
+
+      private:
+        friend class TimerWheel;
+
+        TimerWheel* m_wheel = nullptr;
+        Tick m_expiry = 0;
+        int m_level = 0;
+        FireFkn m_fire;
+    };
+
+    explicit TimerWheel(Tick now = 0);
+
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    // Armed timers are cancelled.
+    ~TimerWheel();
+
+    /**
+     * Arm 'timer' to fire at tick 'expiry', cancelling any earlier arm.
+     * An expiry not after now fires on the next tick.
+     */
+    void arm(Timer& timer, Tick expiry);
+
+    /**
+     * Move time forward to 'now', firing the timers that expire on the
+     * way, in expiry order. The fire functions may arm and cancel timers.
+     */
+    void advance(Tick now);
+
+    Tick now() const
+    {
+        return m_now;
+    }
+
+    // Number of armed timers.
+    int size() const
+    {
+        return m_size;
+    }
+
+    /**
+     * Lower bound of the next expiry, exact when it is within 256 ticks.
+     * Return 'never' when no timer is armed.
+     */
+    Tick nextExpiry() const;
+
+  private:
+    static const constexpr int levelNo = 5;
+    static const constexpr int level0Bits = 8;
+    static const constexpr int levelBits = 6;
+    static const constexpr int level0Slots = 1 << level0Bits;
+    static const constexpr int levelSlots = 1 << levelBits;
+
+    static constexpr int shift(int level)
+    {
+        return level == 0 ? 0 : level0Bits + (level - 1) * levelBits;
+    }
+
+    static constexpr int slotNo(int level)
+    {
+        return level == 0 ? level0Slots : levelSlots;
+    }
+
+    Link& slot(int level, Tick tick)
+    {
+        return m_levels[level][(tick >> shift(level)) & (slotNo(level) - 1)];
+    }
+
+    static bool empty(const Link& head)
+    {
+        return head.m_next == &head;
+    }
+
+    // Put an armed timer in the slot given by its expiry. Require
+    // m_expiry >= m_now.
+    void place(Timer& timer);
+
+    void unlink(Timer& timer);
+
+    // Move the timers of a slot down to the lower levels.
+    void cascade(int level);
+
+    Tick m_now;
+    int m_size = 0;
+
+    // Armed timers at each level.
+    int m_levelSize[levelNo] = {};
+
+    // List heads. Level 0 uses all slots, the others the first 64.
+    Link m_levels[levelNo][level0Slots];
+};
+
+/**
+ * TimerWheel driven by a steady clock.
+ */
+class TimerService
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+    using Duration = Clock::duration;
+    using Timer = TimerWheel::Timer;
+
+    explicit TimerService(Duration resolution = std::chrono::milliseconds(1),
+                          Clock::time_point start = Clock::now());
+
+    // Arm 'timer' to fire 'after' from now. Never fires early.
+    void arm(Timer& timer, Duration after);
+
+    // Arm 'timer' to fire 'period' after its previous expiry.
+    void rearm(Timer& timer, Duration period);
+
+    // Fire the timers that expired up to 'now'.
+    void advance(Clock::time_point now = Clock::now());
+
+    /**
+     * Time from 'now' until the next timer may expire. Zero if one already
+     * has, Duration::max() if no timer is armed.
+     */
+    Duration timeUntilNext(Clock::time_point now = Clock::now()) const;
+
+    TimerWheel& wheel()
+    {
+        return m_wheel;
+    }
+
+  private:
+    TimerWheel::Tick ticks(Duration d) const;
+
+    // Tick at or after 'time'.
+    TimerWheel::Tick tickAt(Clock::time_point time) const;
+
+    Clock::time_point m_start;
+    Duration m_resolution;
+    TimerWheel m_wheel;
+};
+
+/**
+ * Timeout delivering an event to an FSM. Meant as a member of a state
+ * class: arm it in the state constructor and it is cancelled when the
+ * state is exited. With a 'period' it is rearmed at every expiry, in phase
+ * with the first one, before the event is posted.
+ */
+template <class Fsm>
+class FsmTimeout : public TimerWheel::Timer
+{
+  public:
+    using Event = typename Fsm::Event;
+
+    FsmTimeout(TimerService& service, Fsm& fsm, TimerService::Duration after,
+               const Event& ev,
+               TimerService::Duration period = TimerService::Duration{})
+        : Timer(&FsmTimeout::expired), m_service(service), m_fsm(fsm),
+          m_event(ev), m_period(period)
+    {
+        m_service.arm(*this, after);
+    }
+
+    // Arm again, 'after' from now.
+    void restart(TimerService::Duration after)
+    {
+        m_service.arm(*this, after);
+    }
+
+  private:
+    static void expired(Timer* timer)
+    {
+        auto self = static_cast<FsmTimeout*>(timer);
+        if (self->m_period != TimerService::Duration{})
+            self->m_service.rearm(*self, self->m_period);
+
+        // The event may exit the state owning the timeout, so do not
+        // touch 'self' after posting.
+        Fsm& fsm = self->m_fsm;
+        Event ev = self->m_event;
+        fsm.postEvent(ev);
+    }
+
+    TimerService& m_service;
+    Fsm& m_fsm;
+    Event m_event;
+    TimerService::Duration m_period;
+};
+
+/**
+ * Timeouts of an FSM, owned by its states. Kept as a member of the FSM
+ * class, after the TimerService driving it:
+ *
+ *   class Watch : public FsmBase<WatchDesc>
+ *   {
+ *     public:
+ *       TimerService timers;
+ *       FsmTimeouts<Watch> timeouts{timers, *this};
+ *   };
+ *
+ * A state arms a timeout with fsm().timeouts.start(*this, after, ev), in
+ * its constructor or in a handler, without a timer member of its own. The
+ * timeouts of a state are cancelled with cancel(*this), and when the state
+ * is exited, so no event is posted for a state that is no longer active.
+ *
+ * Timeout entries are reused, only arming more timeouts than ever before
+ * at once allocates. Not thread safe, like the TimerService. Do not arm
+ * timeouts from regions dispatched in parallel.
+ */
+template <class Fsm>
+class FsmTimeouts : private StateExitObserver
+{
+  public:
+    using Event = typename Fsm::Event;
+    using Duration = TimerService::Duration;
+
+    FsmTimeouts(TimerService& service, Fsm& fsm)
+        : m_service(service), m_fsm(fsm), m_ownedNo(Fsm::stateNo, 0)
+    {
+        m_fsm.setExitObserver(this);
+    }
+
+    FsmTimeouts(const FsmTimeouts&) = delete;
+    FsmTimeouts& operator=(const FsmTimeouts&) = delete;
+
+    // Armed timeouts are cancelled by their timers.
+    ~FsmTimeouts()
+    {
+        m_fsm.setExitObserver(nullptr);
+    }
+
+    /**
+     * Post 'ev' 'after' from now, unless 'owner' is exited first. With a
+     * 'period' it is rearmed at every expiry, in phase with the first
+     * one, before the event is posted.
+     */
+    template <class State>
+    void start(const State& owner, Duration after, const Event& ev,
+               Duration period = Duration{})
+    {
+        (void)owner;
+        const int id = static_cast<int>(State::stateId);
+        Timeout& timeout = freeTimeout(ev);
+        timeout.m_owner = id;
+        timeout.m_period = period;
+        m_ownedNo[id]++;
+        m_service.arm(timeout, after);
+    }
+
+    // Cancel the timeouts of 'owner'.
+    template <class State>
+    void cancel(const State& owner)
+    {
+        (void)owner;
+        exited(static_cast<int>(State::stateId));
+    }
+
+    // Number of armed timeouts of all states.
+    int armedNo() const
+    {
+        int armed = 0;
+        for (int owned : m_ownedNo)
+            armed += owned;
+        return armed;
+    }
+
+  private:
+    struct Timeout : public TimerWheel::Timer
+    {
+        Timeout(FsmTimeouts& timeouts, const Event& ev)
+            : Timer(&FsmTimeouts::expired), m_timeouts(timeouts), m_event(ev)
+        {
+        }
+
+        FsmTimeouts& m_timeouts;
+
+        // Owning state, nullStateId while free.
+        int m_owner = FsmStaticData::nullStateId;
+        Event m_event;
+        Duration m_period{};
+    };
+
+    // A free timeout holding 'ev'.
+    Timeout& freeTimeout(const Event& ev)
+    {
+        for (auto& timeout : m_timeouts)
+            if (timeout->m_owner == FsmStaticData::nullStateId)
+            {
+                timeout->m_event = ev;
+                return *timeout;
+            }
+        m_timeouts.emplace_back(new Timeout(*this, ev));
+        return *m_timeouts.back();
+    }
+
+    void release(Timeout& timeout)
+    {
+        timeout.cancel();
+        m_ownedNo[timeout.m_owner]--;
+        timeout.m_owner = FsmStaticData::nullStateId;
+    }
+
+    void exited(int stateId) override
+    {
+        if (m_ownedNo[stateId] == 0)
+            return;
+        for (auto& timeout : m_timeouts)
+            if (timeout->m_owner == stateId)
+                release(*timeout);
+    }
+
+    static void expired(TimerWheel::Timer* timer)
+    {
+        auto self = static_cast<Timeout*>(timer);
+        FsmTimeouts& timeouts = self->m_timeouts;
+        if (self->m_period != Duration{})
+            timeouts.m_service.rearm(*self, self->m_period);
+        else
+            timeouts.release(*self);
+
+        // The event may exit the owner, which releases 'self' for reuse.
+        Event ev = self->m_event;
+        timeouts.m_fsm.postEvent(ev);
+    }
+
+    TimerService& m_service;
+    Fsm& m_fsm;
+
+    // Armed and free timeouts. Never moved while armed.
+    std::vector<std::unique_ptr<Timeout>> m_timeouts;
+
+    // Armed timeouts per owning state.
+    std::vector<int> m_ownedNo;
+};
+
+#endif /* SRC_STATECHART_TIMERWHEEL_H_ */
@@ -8,6 +8,8 @@
 #ifndef SRC_UTILITY_VECQUEUE_H_
 #define SRC_UTILITY_VECQUEUE_H_
 
+#include <memory>
+#include <utility>
 #include <vector>
 
 /**
@@ -17,22 +19,56 @@
  * conditions.
  * Partial protection is built in to force elements to the beginning after a
  * while.
+ * The allocator and an initial capacity can be given to let the storage
+ * start out in preallocated memory. (See BufferAllocator.)
  */
-template <class El>
+template <class El, class Alloc = std::allocator<El>>
 class VecQueue
 {
   public:
-    VecQueue() : m_headPos(0){};
+    // Single threaded. Events are processed by the thread posting them.
+    static const constexpr bool concurrent = false;
+
+    // Bytes of initial storage used for 'capacity' elements.
+    static constexpr std::size_t bufferBytes(std::size_t capacity)
+    {
+        return capacity * sizeof(El);
+    }
+
+    explicit VecQueue(const Alloc& alloc = Alloc(), std::size_t capacity = 0)
+        : m_store(alloc), m_headPos(0)
+    {
+        m_store.reserve(capacity);
+    }
+
+    // Start out in 'buffer'. Require an allocator like BufferAllocator.
+    VecQueue(El* buffer, std::size_t capacity)
+        : VecQueue(Alloc(buffer, capacity), capacity)
+    {
+    }
     ~VecQueue(){};
 
     template <int normLimit = 15>
     void push(const El& el)
+    {
+        emplace<normLimit>(el);
+    }
+
+    template <int normLimit = 15>
+    void push(El&& el)
+    {
+        emplace<normLimit>(std::move(el));
+    }
+
+    // Construct an element in place at the back.
+    template <int normLimit = 15, class... Args>
+    void emplace(Args&&... args)
     {
         if (m_store.size() > normLimit)
         {
             checkRenormalization();
         }
-        m_store.push_back(el);
+        m_store.emplace_back(std::forward<Args>(args)...);
     }
 
     void pop()
@@ -88,7 +124,7 @@ class VecQueue
         }
     }
 
-    std::vector<El> m_store;
+    std::vector<El, Alloc> m_store;
     std::size_t m_headPos;
 };
 
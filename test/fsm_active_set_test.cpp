@@ -0,0 +1,133 @@
+/*
+ * fsm_active_set_test.cpp
+ *
+ *  Created on: 16 okt. 2026
+ *      Author: mikaelr
+ */
+
+#include "StateChart.h"
+
+#include <gtest/gtest.h>
+
+#include <utility>
+
+namespace
+{ // Make sure no other names interfere with testing.
+
+/**
+ * A binary tree of 130 states, so the active set spans three words. The
+ * parent of state i is (i - 1) / 2. An event is the id of the state to
+ * go to.
+ */
+const constexpr int treeSize = 130;
+
+class TreeFsm;
+
+struct TreeDesc
+{
+    enum class StateId
+    {
+        stateIdNo = treeSize // Gives the number of states.
+    };
+    using Event = int;
+    using Fsm = TreeFsm;
+    static void setupStates(FsmSetup<TreeDesc>& sc);
+};
+using StateId = TreeDesc::StateId;
+
+class TreeFsm : public FsmBase<TreeDesc>
+{
+};
+
+template <int id>
+class Node : public StateBase<TreeDesc, StateId(id)>
+{
+  public:
+    explicit Node(StateArgs& args) : StateBase<TreeDesc, StateId(id)>(args)
+    {
+        // Active from entry.
+        EXPECT_TRUE(this->fsm().isIn(StateId(id)));
+    }
+    bool event(int target)
+    {
+        this->transition(StateId(target));
+        return true;
+    }
+};
+
+template <int... ids>
+void
+addNodes(FsmSetup<TreeDesc>& sc, std::integer_sequence<int, ids...>)
+{
+    sc.addState<Node<0>>();
+    // Parents have lower ids, so they are added first.
+    (void)std::initializer_list<int>{
+        (sc.addState<Node<ids + 1>, Node<ids / 2>>(), 0)...};
+}
+
+void
+TreeDesc::setupStates(FsmSetup<TreeDesc>& sc)
+{
+    addNodes(sc, std::make_integer_sequence<int, treeSize - 1>());
+}
+
+// True if 'id' is on the root path of 'leaf'.
+bool
+onPath(int id, int leaf)
+{
+    for (;;)
+    {
+        if (id == leaf)
+            return true;
+        if (leaf == 0)
+            return false;
+        leaf = (leaf - 1) / 2;
+    }
+}
+
+TEST(ActiveSet, follows_transitions)
+{
+    TreeFsm fsm;
+    EXPECT_FALSE(fsm.isIn(StateId(0)));
+    fsm.setStartState(StateId(129));
+    const int leaves[] = {129, 64, 0, 127, 5, 128, 128, 2};
+    for (int leaf : leaves)
+    {
+        fsm.postEvent(leaf);
+        ASSERT_EQ(fsm.currentStateId(), StateId(leaf));
+        for (int id = 0; id < treeSize; id++)
+            EXPECT_EQ(fsm.isIn(StateId(id)), onPath(id, leaf)) << id;
+    }
+    EXPECT_TRUE(fsm.isIn<Node<2>>());
+    EXPECT_FALSE(fsm.isIn<Node<1>>());
+}
+
+TEST(ActiveSet, masks)
+{
+    using Set = FsmStateSet<TreeDesc>;
+    static_assert(Set::wordNo == 3, "");
+    constexpr Set path = Set::of<Node<0>, Node<1>, Node<3>, Node<7>>();
+    static_assert(path.contains(StateId(7)), "");
+    static_assert(!path.contains(StateId(2)), "");
+    constexpr Set other = Set::of<Node<128>, Node<2>>();
+    const Set empty;
+
+    TreeFsm fsm;
+    fsm.setStartState(StateId(127));
+    EXPECT_TRUE(fsm.isInAll(path));
+    EXPECT_FALSE(fsm.isInAny(other));
+    EXPECT_FALSE(fsm.isInAny(empty));
+    EXPECT_TRUE(fsm.isInAll(empty));
+
+    // 128 is a sibling of 127.
+    fsm.postEvent(128);
+    EXPECT_TRUE(fsm.isInAll(path));
+    EXPECT_TRUE(fsm.isInAny(other));
+    EXPECT_FALSE(fsm.isInAll(other));
+
+    fsm.postEvent(2);
+    EXPECT_FALSE(fsm.isInAll(path));
+    EXPECT_TRUE(fsm.isInAny(path));
+    EXPECT_TRUE(fsm.isInAny(other));
+}
+} // namespace
@@ -0,0 +1,285 @@
+/*
+ * fsm_choice_test.cpp
+ *
+ *  Created on: 16 okt. 2026
+ *      Author: mikaelr
+ */
+
+#include "StateChart.h"
+
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+#include <string>
+
+namespace
+{ // Make sure no other names interfere with testing.
+
+/**
+ * A job runner. A job of a given size is routed through two chained
+ * choices, 'Route' and 'BySize', to a sub state of 'Work'. A job of
+ * size 0 is routed back to 'Idle'.
+ */
+template <class Desc>
+class JobFsm;
+template <class Desc>
+class Idle;
+template <class Desc>
+class Work;
+template <class Desc>
+class Small;
+template <class Desc>
+class Large;
+template <class Desc>
+class Route;
+template <class Desc>
+class BySize;
+
+// Shared by a runtime and a compile time description below.
+struct JobIds
+{
+    enum class StateId
+    {
+        idle,
+        work,
+        small,
+        large,
+        route,
+        bySize,
+        unused, // Not in the chart.
+        stateIdNo // Keep this last. Gives the number of states.
+    };
+    using Event = int;
+};
+
+struct RuntimeDesc : JobIds
+{
+    using Fsm = JobFsm<RuntimeDesc>;
+    static void setupStates(FsmSetup<RuntimeDesc>& sc)
+    {
+        sc.addState<Idle<RuntimeDesc>>();
+        sc.addState<Work<RuntimeDesc>>();
+        sc.addState<Small<RuntimeDesc>, Work<RuntimeDesc>>();
+        sc.addState<Large<RuntimeDesc>, Work<RuntimeDesc>>();
+        sc.addChoice<Route<RuntimeDesc>>();
+        sc.addChoice<BySize<RuntimeDesc>>();
+    }
+};
+
+struct ConstDesc : JobIds
+{
+    using Fsm = JobFsm<ConstDesc>;
+    using States = StateList<StateDef<Idle<ConstDesc>>,
+                             StateDef<Work<ConstDesc>>,
+                             StateDef<Small<ConstDesc>, Work<ConstDesc>>,
+                             StateDef<Large<ConstDesc>, Work<ConstDesc>>,
+                             StateDef<Route<ConstDesc>>,
+                             StateDef<BySize<ConstDesc>>>;
+};
+
+template <class Desc>
+class JobFsm : public FsmBase<Desc>
+{
+  public:
+    explicit JobFsm(std::string& log) : log(log) {}
+    int size = 0;
+    std::string& log;
+};
+
+// Log entry and exit.
+template <class Desc, typename Desc::StateId id>
+class LogState : public StateBase<Desc, id>
+{
+  public:
+    LogState(StateArgs& args, const char* name)
+        : StateBase<Desc, id>(args), m_name(name)
+    {
+        this->fsm().log += std::string("+") + m_name;
+    }
+    ~LogState()
+    {
+        this->fsm().log += std::string("-") + m_name;
+    }
+    const char* m_name;
+};
+
+template <class Desc>
+class Idle : public LogState<Desc, Desc::StateId::idle>
+{
+  public:
+    explicit Idle(StateArgs& args)
+        : LogState<Desc, Desc::StateId::idle>(args, "idle")
+    {
+    }
+    bool event(int size)
+    {
+        this->fsm().size = size;
+        this->template transition<Route<Desc>>();
+        return true;
+    }
+};
+
+template <class Desc>
+class Work : public LogState<Desc, Desc::StateId::work>
+{
+  public:
+    explicit Work(StateArgs& args)
+        : LogState<Desc, Desc::StateId::work>(args, "work")
+    {
+    }
+    bool event(int)
+    {
+        this->template transition<Idle<Desc>>();
+        return true;
+    }
+};
+
+template <class Desc>
+class Small : public LogState<Desc, Desc::StateId::small>
+{
+  public:
+    explicit Small(StateArgs& args)
+        : LogState<Desc, Desc::StateId::small>(args, "small")
+    {
+    }
+};
+
+template <class Desc>
+class Large : public LogState<Desc, Desc::StateId::large>
+{
+  public:
+    explicit Large(StateArgs& args)
+        : LogState<Desc, Desc::StateId::large>(args, "large")
+    {
+    }
+};
+
+template <class Desc>
+class Route : public ChoiceBase<Desc, Desc::StateId::route>
+{
+  public:
+    using StateId = typename Desc::StateId;
+    static StateId choose(const JobFsm<Desc>& fsm)
+    {
+        // A negative size selects no state, or one not in the chart.
+        // Both are errors.
+        if (fsm.size == -1)
+            return static_cast<StateId>(FsmStaticData::nullStateId);
+        if (fsm.size < 0)
+            return StateId::unused;
+        return fsm.size == 0 ? StateId::idle : StateId::bySize;
+    }
+};
+
+template <class Desc>
+class BySize : public ChoiceBase<Desc, Desc::StateId::bySize>
+{
+  public:
+    using StateId = typename Desc::StateId;
+    static StateId choose(const JobFsm<Desc>& fsm)
+    {
+        return fsm.size > 100 ? StateId::large : StateId::small;
+    }
+};
+
+// Choices are in the compile time tables, without an object.
+using Setup = FsmConstSetup<ConstDesc>;
+static_assert(Setup::table.states[int(JobIds::StateId::route)].m_isChoice,
+              "");
+static_assert(Setup::table.states[int(JobIds::StateId::route)].m_size == 0,
+              "");
+static_assert(!Setup::table.states[int(JobIds::StateId::work)].m_isChoice,
+              "");
+
+template <class Desc>
+class Choices : public ::testing::Test
+{
+  protected:
+    // Return the log and clear it.
+    std::string take()
+    {
+        std::string taken = log;
+        log.clear();
+        return taken;
+    }
+
+    // The log outlives the FSM, so the final exits are logged too.
+    std::string log;
+    JobFsm<Desc> fsm{log};
+};
+
+using Descs = ::testing::Types<RuntimeDesc, ConstDesc>;
+TYPED_TEST_SUITE(Choices, Descs);
+
+TYPED_TEST(Choices, routed_in_one_transition)
+{
+    using StateId = JobIds::StateId;
+    auto& fsm = this->fsm;
+    fsm.setStartState(StateId::idle);
+    this->take();
+
+    fsm.postEvent(5);
+    EXPECT_EQ(this->take(), "-idle+work+small");
+    EXPECT_EQ(fsm.currentStateId(), StateId::small);
+    EXPECT_FALSE(fsm.isIn(StateId::route));
+
+    fsm.postEvent(0);
+    EXPECT_EQ(this->take(), "-small-work+idle");
+    fsm.postEvent(500);
+    EXPECT_EQ(this->take(), "-idle+work+large");
+
+    // Routed back to the source, which is exited and entered.
+    fsm.postEvent(0);
+    this->take();
+    fsm.postEvent(0);
+    EXPECT_EQ(this->take(), "-idle+idle");
+}
+
+TYPED_TEST(Choices, start_state)
+{
+    using StateId = JobIds::StateId;
+    auto& fsm = this->fsm;
+    fsm.size = 500;
+    fsm.setStartState(StateId::route);
+    EXPECT_EQ(this->take(), "+work+large");
+    EXPECT_EQ(fsm.currentStateId(), StateId::large);
+}
+
+#ifndef NDEBUG
+TYPED_TEST(Choices, no_state_selected)
+{
+    auto& fsm = this->fsm;
+    fsm.setStartState(JobIds::StateId::idle);
+    EXPECT_DEATH(fsm.postEvent(-1), "id >= 0");
+}
+
+TYPED_TEST(Choices, unregistered_state_selected)
+{
+    auto& fsm = this->fsm;
+    fsm.setStartState(JobIds::StateId::idle);
+    EXPECT_DEATH(fsm.postEvent(-2), "si && si->valid");
+}
+#endif
+
+int
+chooseNothing(const FsmBaseBase*)
+{
+    return 0;
+}
+
+// A choice below another state is a setup error.
+TEST(ChoiceSetup, choice_with_parent)
+{
+    FsmStaticBuilder builder(2);
+    FsmStaticData::StateInfo choice;
+    choice.m_choice = &chooseNothing;
+    choice.m_isChoice = true;
+    builder.addStateBase(0, 0, FsmStaticData::StateInfo());
+    builder.addStateBase(1, 0, choice);
+#ifdef STATECHART_NO_EXCEPTIONS
+    EXPECT_DEATH(builder.finalize(), "Choice with a parent");
+#else
+    EXPECT_THROW(builder.finalize(), std::runtime_error);
+#endif
+}
+} // namespace
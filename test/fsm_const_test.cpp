@@ -0,0 +1,298 @@
+/*
+ * fsm_const_test.cpp
+ *
+ *  Created on: 15 okt. 2026
+ *      Author: mikaelr
+ */
+
+#include "StateChart.h"
+
+#include <gtest/gtest.h>
+
+#include <utility>
+
+namespace
+{ // Make sure no other names interfere with testing.
+
+class ConstFsm;
+class Root;
+class Mid;
+class Leaf;
+class Other;
+
+// Description class using a compile time state list instead of
+// 'setupStates'.
+class ConstFsmDesc
+{
+  public:
+    enum class StateId
+    {
+        root,
+        mid,
+        leaf,
+        other,
+        stateIdNo // Keep this last. Gives the number of states.
+    };
+
+    using Event = int;
+    using Fsm = ConstFsm;
+
+    // Order in the list is free. Parents need not come first.
+    using States = StateList<StateDef<Leaf, Mid>, StateDef<Root>,
+                             StateDef<Mid, Root>, StateDef<Other>>;
+};
+
+class ConstFsm : public FsmBase<ConstFsmDesc>
+{
+  public:
+    int entries = 0;
+    int exits = 0;
+};
+
+using StateId = ConstFsmDesc::StateId;
+
+template <StateId id>
+class CountState : public StateBase<ConstFsmDesc, id>
+{
+  public:
+    explicit CountState(StateArgs& args) : StateBase<ConstFsmDesc, id>(args)
+    {
+        this->fsm().entries++;
+    }
+    ~CountState()
+    {
+        this->fsm().exits++;
+    }
+};
+
+class Root : public CountState<StateId::root>
+{
+  public:
+    explicit Root(StateArgs& args) : CountState(args) {}
+    bool event(int ev)
+    {
+        if (ev == 1)
+            transition<Other>();
+        return false;
+    }
+};
+
+class Mid : public CountState<StateId::mid>
+{
+  public:
+    explicit Mid(StateArgs& args) : CountState(args) {}
+    bool event(int)
+    {
+        return false;
+    }
+    int midVar = 7;
+};
+
+class Leaf : public CountState<StateId::leaf>
+{
+  public:
+    explicit Leaf(StateArgs& args) : CountState(args) {}
+    bool event(int ev)
+    {
+        if (ev == 2)
+            transition<Mid>();
+        if (ev == 4)
+            parent<Mid>().midVar++;
+        return ev == 3 || ev == 4;
+    }
+};
+
+class Other : public CountState<StateId::other>
+{
+  public:
+    explicit Other(StateArgs& args) : CountState(args) {}
+    bool event(int ev)
+    {
+        if (ev == 1)
+            transition<Leaf>();
+        return false;
+    }
+
+    // Large state at level 0. Shares storage with the deep states.
+    char buffer[512] = {};
+};
+
+using Setup = FsmConstSetup<ConstFsmDesc>;
+
+// The tables are constant expressions.
+static_assert(Setup::table.states[int(StateId::leaf)].m_level == 2, "");
+static_assert(Setup::table.states[int(StateId::mid)].m_parentId ==
+                  int(StateId::root),
+              "");
+static_assert(Setup::table.paths[int(StateId::leaf) * 3 + 0] ==
+                  int(StateId::root),
+              "");
+static_assert(Setup::table.lca[int(StateId::leaf) * 4 + int(StateId::mid)] ==
+                  1,
+              "");
+static_assert(Setup::table.lca[int(StateId::leaf) * 4 + int(StateId::other)] ==
+                  -1,
+              "");
+
+// So are the state lookups. parent<Other>() in Leaf does not compile.
+using MidLookup = FsmStateLookup<ConstFsmDesc, Mid>;
+static_assert(MidLookup::frame(Setup::data) == 1, "");
+static_assert(MidLookup::info(Setup::data) ==
+                  &Setup::table.states[int(StateId::mid)],
+              "");
+static_assert(MidLookup::isAncestorOf(int(StateId::leaf)), "");
+static_assert(!MidLookup::isAncestorOf(int(StateId::mid)), "");
+static_assert(!FsmStateLookup<ConstFsmDesc, Other>::isAncestorOf(
+                  int(StateId::leaf)),
+              "");
+
+TEST(StateChartConst, tables)
+{
+    const FsmStaticData& data = Setup::data;
+    EXPECT_EQ(data.levelNo(), 3);
+    EXPECT_EQ(data.findState(int(StateId::mid))->m_offset,
+              FsmStaticData::alignUp(sizeof(Root)));
+    const auto* leaf = data.findState(int(StateId::leaf));
+    ASSERT_TRUE(leaf);
+    EXPECT_EQ(data.ancestor(leaf, 1), data.findState(int(StateId::mid)));
+}
+
+TEST(StateChartConst, storage)
+{
+    // Storage fits the largest root path rather than the largest state
+    // at each level.
+    const FsmStaticData& data = Setup::data;
+    const size_t deepPath = FsmStaticData::alignUp(sizeof(Root)) +
+                            FsmStaticData::alignUp(sizeof(Mid)) +
+                            FsmStaticData::alignUp(sizeof(Leaf));
+    ASSERT_LT(deepPath, sizeof(Other));
+    EXPECT_EQ(data.storageSize(), FsmStaticData::alignUp(sizeof(Other)));
+    EXPECT_EQ(data.findState(int(StateId::other))->m_offset, 0u);
+    EXPECT_EQ(data.findState(int(StateId::leaf))->m_offset,
+              deepPath - FsmStaticData::alignUp(sizeof(Leaf)));
+}
+
+TEST(StateChartConst, transitions)
+{
+    ConstFsm fsm;
+    EXPECT_EQ(fsm.currentStateId(), ConstFsm::nullStateId());
+
+    fsm.setStartState(StateId::leaf);
+    EXPECT_EQ(fsm.currentStateId(), StateId::leaf);
+    EXPECT_EQ(fsm.entries, 3);
+    EXPECT_EQ(fsm.activeState<Mid>()->midVar, 7);
+    EXPECT_TRUE(fsm.currentState<Leaf>());
+    EXPECT_FALSE(fsm.currentState<Mid>());
+    EXPECT_FALSE(fsm.activeState<Other>());
+
+    fsm.postEvent(4);
+    EXPECT_EQ(fsm.activeState<Mid>()->midVar, 8);
+
+    // Handled in leaf, no transition.
+    fsm.postEvent(3);
+    EXPECT_EQ(fsm.currentStateId(), StateId::leaf);
+
+    // Leaf to parent. Only leaf is exited.
+    fsm.postEvent(2);
+    EXPECT_EQ(fsm.currentStateId(), StateId::mid);
+    EXPECT_EQ(fsm.exits, 1);
+
+    // Root handler moves to a separate bottom level state.
+    fsm.postEvent(1);
+    EXPECT_EQ(fsm.currentStateId(), StateId::other);
+    EXPECT_EQ(fsm.exits, 3);
+    EXPECT_EQ(fsm.entries, 4);
+
+    // And back into the deep state.
+    fsm.postEvent(1);
+    EXPECT_EQ(fsm.currentStateId(), StateId::leaf);
+    EXPECT_EQ(fsm.exits, 4);
+    EXPECT_EQ(fsm.entries, 7);
+}
+
+/**
+ * A chain 140 deep with two leaves, 'chainDepth' and 'chainDepth + 1'.
+ * Deeper than the levels kept in the common ancestor table.
+ */
+const constexpr int chainDepth = 140;
+
+class ChainFsm;
+template <int id>
+class Link;
+
+constexpr int
+chainParent(int id)
+{
+    return id == chainDepth + 1 ? chainDepth - 1 : id - 1;
+}
+
+template <class Seq>
+struct ChainStates;
+
+template <int... ids>
+struct ChainStates<std::integer_sequence<int, ids...>>
+{
+    using type =
+        StateList<StateDef<Link<0>>,
+                  StateDef<Link<ids + 1>, Link<chainParent(ids + 1)>>...>;
+};
+
+struct ChainFsmDesc
+{
+    enum class StateId
+    {
+        stateIdNo = chainDepth + 2
+    };
+    using Event = int;
+    using Fsm = ChainFsm;
+    using States =
+        ChainStates<std::make_integer_sequence<int, chainDepth + 1>>::type;
+};
+
+class ChainFsm : public FsmBase<ChainFsmDesc>
+{
+  public:
+    int entries = 0;
+    int exits = 0;
+};
+
+template <int id>
+class Link
+    : public StateBase<ChainFsmDesc, static_cast<ChainFsmDesc::StateId>(id)>
+{
+  public:
+    using Base =
+        StateBase<ChainFsmDesc, static_cast<ChainFsmDesc::StateId>(id)>;
+    explicit Link(StateArgs& args) : Base(args)
+    {
+        this->fsm().entries++;
+    }
+    ~Link()
+    {
+        this->fsm().exits++;
+    }
+    bool event(int)
+    {
+        if (id == chainDepth)
+            this->template transition<Link<chainDepth + 1>>();
+        return true;
+    }
+};
+
+static_assert(FsmConstSetup<ChainFsmDesc>::data.levelNo() == chainDepth + 1,
+              "");
+
+TEST(StateChartConst, deep_chain)
+{
+    ChainFsm fsm;
+    fsm.setStartState(static_cast<ChainFsmDesc::StateId>(chainDepth));
+    EXPECT_EQ(fsm.entries, chainDepth + 1);
+
+    // Sibling leaves, only the leaf is exited and entered.
+    fsm.postEvent(0);
+    EXPECT_EQ(fsm.currentStateId(),
+              static_cast<ChainFsmDesc::StateId>(chainDepth + 1));
+    EXPECT_EQ(fsm.exits, 1);
+    EXPECT_EQ(fsm.entries, chainDepth + 2);
+}
+} // namespace
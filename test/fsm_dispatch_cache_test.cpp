@@ -0,0 +1,248 @@
+/*
+ * fsm_dispatch_cache_test.cpp
+ *
+ *  Created on: 15 okt. 2026
+ *      Author: mikaelr
+ */
+
+#include "StateChart.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+namespace
+{ // Make sure no other names interfere with testing.
+
+enum class Kind
+{
+    a,
+    b,
+    c,
+    kindNo
+};
+
+struct Ev
+{
+    Kind kind;
+    bool consume;
+};
+
+template <class Desc>
+class CacheFsm;
+template <class Desc>
+class Top;
+template <class Desc>
+class Middle;
+template <class Desc>
+class Bottom;
+template <class Desc>
+class Side;
+
+// Shared by a runtime and a compile time description below.
+struct CacheIds
+{
+    enum class StateId
+    {
+        top,
+        middle,
+        bottom,
+        side,
+        stateIdNo // Keep this last. Gives the number of states.
+    };
+    using Event = Ev;
+
+    static constexpr int eventIdNo = static_cast<int>(Kind::kindNo);
+    static int eventId(const Ev& ev)
+    {
+        return static_cast<int>(ev.kind);
+    }
+};
+
+struct RuntimeDesc : CacheIds
+{
+    using Fsm = CacheFsm<RuntimeDesc>;
+    static void setupStates(FsmSetup<RuntimeDesc>& sc)
+    {
+        sc.addState<Top<RuntimeDesc>>();
+        sc.addState<Middle<RuntimeDesc>, Top<RuntimeDesc>>();
+        sc.addState<Bottom<RuntimeDesc>, Middle<RuntimeDesc>>();
+        sc.addState<Side<RuntimeDesc>, Top<RuntimeDesc>>();
+    }
+};
+
+struct ConstDesc : CacheIds
+{
+    using Fsm = CacheFsm<ConstDesc>;
+    using States = StateList<StateDef<Top<ConstDesc>>,
+                             StateDef<Middle<ConstDesc>, Top<ConstDesc>>,
+                             StateDef<Bottom<ConstDesc>, Middle<ConstDesc>>,
+                             StateDef<Side<ConstDesc>, Top<ConstDesc>>>;
+};
+
+// Record the states the events are passed to.
+template <class Desc>
+class CacheFsm : public FsmBase<Desc>
+{
+  public:
+    std::string calls;
+};
+
+// Handles all events, no HandledEvents.
+template <class Desc>
+class Top : public StateBase<Desc, Desc::StateId::top>
+{
+  public:
+    explicit Top(StateArgs& args) : StateBase<Desc, Desc::StateId::top>(args)
+    {
+    }
+    bool event(const Ev& ev)
+    {
+        this->fsm().calls += 't';
+        if (ev.kind == Kind::c)
+            this->template transition<Side<Desc>>();
+        return true;
+    }
+};
+
+// No event function. Never called.
+template <class Desc>
+class Middle : public StateBase<Desc, Desc::StateId::middle>
+{
+  public:
+    explicit Middle(StateArgs& args)
+        : StateBase<Desc, Desc::StateId::middle>(args)
+    {
+    }
+};
+
+// Passed 'a' only. Lets it bubble unless consumed.
+template <class Desc>
+class Bottom : public StateBase<Desc, Desc::StateId::bottom>
+{
+  public:
+    using HandledEvents = EventSet<Kind, Kind::a>;
+
+    explicit Bottom(StateArgs& args)
+        : StateBase<Desc, Desc::StateId::bottom>(args)
+    {
+    }
+    bool event(const Ev& ev)
+    {
+        EXPECT_EQ(ev.kind, Kind::a);
+        this->fsm().calls += 'b';
+        return ev.consume;
+    }
+};
+
+// Passed 'b' and 'c'.
+template <class Desc>
+class Side : public StateBase<Desc, Desc::StateId::side>
+{
+  public:
+    using HandledEvents = EventSet<Kind, Kind::b, Kind::c>;
+
+    explicit Side(StateArgs& args) : StateBase<Desc, Desc::StateId::side>(args)
+    {
+    }
+    bool event(const Ev& ev)
+    {
+        this->fsm().calls += 's';
+        if (ev.kind == Kind::b)
+            this->template transition<Bottom<Desc>>();
+        return ev.consume;
+    }
+};
+
+// Compile time cache: first handling level per (state, event).
+using Setup = FsmConstSetup<ConstDesc>;
+static_assert(Setup::data.firstHandler(int(CacheIds::StateId::bottom),
+                                       int(Kind::a)) == 2,
+              "");
+static_assert(Setup::data.firstHandler(int(CacheIds::StateId::bottom),
+                                       int(Kind::b)) == 0,
+              "");
+static_assert(Setup::data.firstHandler(int(CacheIds::StateId::side),
+                                       int(Kind::c)) == 1,
+              "");
+
+// A state naming 'event' must be able to take events. These signatures
+// fail the static_assert in StateEventMask.
+struct NonConstEvent
+{
+    bool event(Ev&);
+};
+struct VoidEvent
+{
+    void event(const Ev&);
+};
+struct OverloadedEvent
+{
+    bool event(const Ev&);
+    bool event(int);
+};
+struct NoEvent
+{
+};
+struct FinalEvent final
+{
+    bool event(const Ev&);
+};
+static_assert(StateNamesEvent<NonConstEvent>::value &&
+                  !StateHasEvent<NonConstEvent, Ev>::value,
+              "");
+static_assert(StateNamesEvent<VoidEvent>::value &&
+                  !StateHasEvent<VoidEvent, Ev>::value,
+              "");
+static_assert(StateNamesEvent<OverloadedEvent>::value &&
+                  StateHasEvent<OverloadedEvent, Ev>::value,
+              "");
+static_assert(!StateNamesEvent<NoEvent>::value, "");
+static_assert(StateHasEvent<FinalEvent, Ev>::value, "");
+
+template <class Desc>
+class DispatchCache : public ::testing::Test
+{
+};
+
+using Descs = ::testing::Types<RuntimeDesc, ConstDesc>;
+TYPED_TEST_SUITE(DispatchCache, Descs);
+
+TYPED_TEST(DispatchCache, skips_levels)
+{
+    using StateId = CacheIds::StateId;
+    CacheFsm<TypeParam> fsm;
+    fsm.setStartState(StateId::bottom);
+
+    const auto& data = FsmStaticInstance<TypeParam>::get();
+    EXPECT_EQ(data.eventIdNo(), 3);
+    EXPECT_EQ(data.firstHandler(int(StateId::middle), int(Kind::a)), 0);
+    EXPECT_EQ(data.firstHandler(int(StateId::bottom), int(Kind::c)), 0);
+
+    // Consumed by the leaf.
+    fsm.postEvent(Ev{Kind::a, true});
+    EXPECT_EQ(fsm.calls, "b");
+
+    // Bubbles past the middle level without calling it.
+    fsm.calls.clear();
+    fsm.postEvent(Ev{Kind::a, false});
+    EXPECT_EQ(fsm.calls, "bt");
+
+    // Not listed by the leaf, goes straight to the top.
+    fsm.calls.clear();
+    fsm.postEvent(Ev{Kind::c, false});
+    EXPECT_EQ(fsm.calls, "t");
+    EXPECT_EQ(fsm.currentStateId(), StateId::side);
+
+    fsm.calls.clear();
+    fsm.postEvent(Ev{Kind::c, false});
+    EXPECT_EQ(fsm.calls, "st");
+    fsm.calls.clear();
+    fsm.postEvent(Ev{Kind::a, false});
+    EXPECT_EQ(fsm.calls, "t");
+    fsm.calls.clear();
+    fsm.postEvent(Ev{Kind::b, true});
+    EXPECT_EQ(fsm.calls, "s");
+    EXPECT_EQ(fsm.currentStateId(), StateId::bottom);
+}
+} // namespace
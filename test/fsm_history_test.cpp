@@ -0,0 +1,297 @@
+/*
+ * fsm_history_test.cpp
+ *
+ *  Created on: 16 okt. 2026
+ *      Author: mikaelr
+ */
+
+#include "StateChart.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+namespace
+{ // Make sure no other names interfere with testing.
+
+/**
+ * A player. 'On' and 'Playing' keep history, so the player resumes where
+ * it was when switched off or paused.
+ */
+enum class Cmd
+{
+    power,
+    play,
+    next,
+    pause,
+    resumeShallow,
+    resumeDeep,
+};
+
+template <class Desc>
+class PlayerFsm;
+template <class Desc>
+class Off;
+template <class Desc>
+class On;
+template <class Desc>
+class Playing;
+template <class Desc>
+class Track1;
+template <class Desc>
+class Track2;
+template <class Desc>
+class Paused;
+
+// Shared by a runtime and a compile time description below.
+struct PlayerIds
+{
+    enum class StateId
+    {
+        off,
+        on,
+        playing,
+        track1,
+        track2,
+        paused,
+        stateIdNo // Keep this last. Gives the number of states.
+    };
+    using Event = Cmd;
+};
+
+struct RuntimeDesc : PlayerIds
+{
+    using Fsm = PlayerFsm<RuntimeDesc>;
+    static void setupStates(FsmSetup<RuntimeDesc>& sc)
+    {
+        sc.addState<Off<RuntimeDesc>>();
+        sc.addState<On<RuntimeDesc>>();
+        sc.addState<Playing<RuntimeDesc>, On<RuntimeDesc>>();
+        sc.addState<Track1<RuntimeDesc>, Playing<RuntimeDesc>>();
+        sc.addState<Track2<RuntimeDesc>, Playing<RuntimeDesc>>();
+        sc.addState<Paused<RuntimeDesc>, On<RuntimeDesc>>();
+    }
+};
+
+struct ConstDesc : PlayerIds
+{
+    using Fsm = PlayerFsm<ConstDesc>;
+    using States =
+        StateList<StateDef<Off<ConstDesc>>, StateDef<On<ConstDesc>>,
+                  StateDef<Playing<ConstDesc>, On<ConstDesc>>,
+                  StateDef<Track1<ConstDesc>, Playing<ConstDesc>>,
+                  StateDef<Track2<ConstDesc>, Playing<ConstDesc>>,
+                  StateDef<Paused<ConstDesc>, On<ConstDesc>>>;
+};
+
+// The log outlives the FSM, so the final exits are logged too.
+template <class Desc>
+class PlayerFsm : public FsmBase<Desc>
+{
+  public:
+    explicit PlayerFsm(std::string& log) : log(log) {}
+    std::string& log;
+};
+
+// Log entry and exit.
+template <class Desc, typename Desc::StateId id>
+class LogState : public StateBase<Desc, id>
+{
+  public:
+    LogState(StateArgs& args, const char* name)
+        : StateBase<Desc, id>(args), m_name(name)
+    {
+        this->fsm().log += std::string("+") + m_name;
+    }
+    ~LogState()
+    {
+        this->fsm().log += std::string("-") + m_name;
+    }
+    const char* m_name;
+};
+
+template <class Desc>
+class Off : public LogState<Desc, Desc::StateId::off>
+{
+  public:
+    explicit Off(StateArgs& args)
+        : LogState<Desc, Desc::StateId::off>(args, "off")
+    {
+    }
+    bool event(Cmd cmd)
+    {
+        if (cmd == Cmd::resumeShallow)
+            this->template transition<ShallowHistory<On<Desc>>>();
+        else if (cmd == Cmd::resumeDeep)
+            this->template transition<DeepHistory<On<Desc>>>();
+        else if (cmd == Cmd::power)
+            this->template transition<On<Desc>>();
+        return true;
+    }
+};
+
+template <class Desc>
+class On : public LogState<Desc, Desc::StateId::on>
+{
+  public:
+    static const constexpr bool keepHistory = true;
+
+    explicit On(StateArgs& args)
+        : LogState<Desc, Desc::StateId::on>(args, "on")
+    {
+    }
+    bool event(Cmd cmd)
+    {
+        if (cmd == Cmd::power)
+            this->template transition<Off<Desc>>();
+        else if (cmd == Cmd::play)
+            this->template transition<Track1<Desc>>();
+        return true;
+    }
+};
+
+template <class Desc>
+class Playing : public LogState<Desc, Desc::StateId::playing>
+{
+  public:
+    static const constexpr bool keepHistory = true;
+
+    explicit Playing(StateArgs& args)
+        : LogState<Desc, Desc::StateId::playing>(args, "playing")
+    {
+    }
+    bool event(Cmd cmd)
+    {
+        if (cmd != Cmd::pause)
+            return false;
+        this->template transition<Paused<Desc>>();
+        return true;
+    }
+};
+
+template <class Desc>
+class Track1 : public LogState<Desc, Desc::StateId::track1>
+{
+  public:
+    explicit Track1(StateArgs& args)
+        : LogState<Desc, Desc::StateId::track1>(args, "track1")
+    {
+    }
+    bool event(Cmd cmd)
+    {
+        if (cmd != Cmd::next)
+            return false;
+        this->template transition<Track2<Desc>>();
+        return true;
+    }
+};
+
+template <class Desc>
+class Track2 : public LogState<Desc, Desc::StateId::track2>
+{
+  public:
+    explicit Track2(StateArgs& args)
+        : LogState<Desc, Desc::StateId::track2>(args, "track2")
+    {
+    }
+    bool event(Cmd cmd)
+    {
+        if (cmd != Cmd::next)
+            return false;
+        this->template transition<Track1<Desc>>();
+        return true;
+    }
+};
+
+template <class Desc>
+class Paused : public LogState<Desc, Desc::StateId::paused>
+{
+  public:
+    explicit Paused(StateArgs& args)
+        : LogState<Desc, Desc::StateId::paused>(args, "paused")
+    {
+    }
+    bool event(Cmd cmd)
+    {
+        if (cmd != Cmd::play)
+            return false;
+        this->template transition<DeepHistory<Playing<Desc>>>();
+        return true;
+    }
+};
+
+template <class Desc>
+class History : public ::testing::Test
+{
+  protected:
+    // Post 'cmd' and return the log, cleared.
+    std::string post(Cmd cmd)
+    {
+        log.clear();
+        fsm.postEvent(cmd);
+        return log;
+    }
+
+    std::string log;
+    PlayerFsm<Desc> fsm{log};
+};
+
+using Descs = ::testing::Types<RuntimeDesc, ConstDesc>;
+TYPED_TEST_SUITE(History, Descs);
+
+TYPED_TEST(History, slots)
+{
+    using StateId = PlayerIds::StateId;
+    const FsmStaticData& data = FsmStaticInstance<TypeParam>::get();
+    EXPECT_EQ(data.historyNo(), 2);
+    EXPECT_EQ(data.findState(int(StateId::on))->m_history, 0);
+    EXPECT_EQ(data.findState(int(StateId::playing))->m_history, 1);
+    EXPECT_EQ(data.findState(int(StateId::paused))->m_history, -1);
+}
+
+TYPED_TEST(History, shallow_and_deep)
+{
+    using StateId = PlayerIds::StateId;
+    this->fsm.setStartState(StateId::off);
+
+    // No history yet, the state itself is entered.
+    EXPECT_EQ(this->post(Cmd::resumeDeep), "-off+on");
+    EXPECT_EQ(this->post(Cmd::play), "+playing+track1");
+    EXPECT_EQ(this->post(Cmd::next), "-track1+track2");
+    EXPECT_EQ(this->post(Cmd::power), "-track2-playing-on+off");
+
+    // The whole path is entered in one transition.
+    EXPECT_EQ(this->post(Cmd::resumeDeep), "-off+on+playing+track2");
+    EXPECT_EQ(this->fsm.currentStateId(), StateId::track2);
+
+    EXPECT_EQ(this->post(Cmd::pause), "-track2-playing+paused");
+    EXPECT_EQ(this->post(Cmd::power), "-paused-on+off");
+    EXPECT_EQ(this->post(Cmd::resumeShallow), "-off+on+paused");
+
+    // History of a nested state, kept since 'pause'.
+    EXPECT_EQ(this->post(Cmd::play), "-paused+playing+track2");
+
+    // Shallow history enters the sub state only.
+    this->post(Cmd::power);
+    EXPECT_EQ(this->post(Cmd::resumeShallow), "-off+on+playing");
+
+    // 'Playing' was left without a sub state.
+    EXPECT_EQ(this->post(Cmd::power), "-playing-on+off");
+    EXPECT_EQ(this->post(Cmd::resumeDeep), "-off+on+playing");
+}
+
+TYPED_TEST(History, kept_per_instance)
+{
+    using StateId = PlayerIds::StateId;
+    std::string otherLog;
+    PlayerFsm<TypeParam> other(otherLog);
+    other.setStartState(StateId::off);
+    this->fsm.setStartState(StateId::track2);
+
+    // Restarting exits the active states, which keeps their history.
+    this->fsm.setStartState(StateId::off);
+    EXPECT_EQ(this->post(Cmd::resumeDeep), "-off+on+playing+track2");
+    other.postEvent(Cmd::resumeDeep);
+    EXPECT_EQ(other.currentStateId(), StateId::on);
+}
+} // namespace
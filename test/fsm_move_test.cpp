@@ -0,0 +1,124 @@
+/*
+ * fsm_move_test.cpp
+ *
+ *  Created on: 15 okt. 2026
+ *      Author: mikaelr
+ */
+
+#include "StateChart.h"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{ // Make sure no other names interfere with testing.
+
+// Move only event with a heap payload. Any copy is a compile error.
+struct MoveEvent
+{
+    MoveEvent(int id, std::string text)
+        : id(id), payload(new std::string(std::move(text)))
+    {
+    }
+    MoveEvent(MoveEvent&&) = default;
+    MoveEvent& operator=(MoveEvent&&) = default;
+
+    int id;
+    std::unique_ptr<std::string> payload;
+};
+
+template <class Queue>
+class MoveFsm;
+
+template <class Desc>
+class Receiver;
+
+template <class QueueType>
+struct MoveFsmDesc
+{
+    enum class StateId
+    {
+        receiver,
+        stateIdNo // Keep this last. Gives the number of states.
+    };
+    using Event = MoveEvent;
+    using Fsm = MoveFsm<QueueType>;
+    using Queue = QueueType;
+    using States = StateList<StateDef<Receiver<MoveFsmDesc>>>;
+};
+
+template <class Queue>
+class MoveFsm : public FsmBase<MoveFsmDesc<Queue>>
+{
+  public:
+    std::vector<std::string> received;
+};
+
+template <class Desc>
+class Receiver : public StateBase<Desc, Desc::StateId::receiver>
+{
+  public:
+    explicit Receiver(StateArgs& args)
+        : StateBase<Desc, Desc::StateId::receiver>(args)
+    {
+    }
+
+    bool event(const MoveEvent& ev)
+    {
+        this->fsm().received.push_back(*ev.payload);
+        // Post from the handler. Queued behind the current event.
+        if (ev.id == 1)
+            this->fsm().emplaceEvent(2, *ev.payload + "-reply");
+        return true;
+    }
+};
+
+template <class Queue>
+void
+runMoveOnly(bool concurrent)
+{
+    using Fsm = MoveFsm<Queue>;
+    Fsm fsm;
+    fsm.setStartState(MoveFsmDesc<Queue>::StateId::receiver);
+
+    MoveEvent ev(0, "first");
+    fsm.postEvent(std::move(ev));
+    fsm.emplaceEvent(1, "second");
+    fsm.addEvent(MoveEvent(0, "third"));
+    fsm.processQueue();
+
+    ASSERT_EQ(fsm.received.size(), 4u);
+    EXPECT_EQ(fsm.received[0], "first");
+    EXPECT_EQ(fsm.received[1], "second");
+    if (!concurrent)
+    {
+        // The reply is queued before 'third' is added.
+        EXPECT_EQ(fsm.received[2], "second-reply");
+        EXPECT_EQ(fsm.received[3], "third");
+    }
+    else
+    {
+        // Nothing runs until processQueue.
+        EXPECT_EQ(fsm.received[2], "third");
+        EXPECT_EQ(fsm.received[3], "second-reply");
+    }
+}
+
+TEST(StateChartMove, ring_queue)
+{
+    runMoveOnly<RingQueue<MoveEvent>>(false);
+}
+
+TEST(StateChartMove, vec_queue)
+{
+    runMoveOnly<VecQueue<MoveEvent, BufferAllocator<MoveEvent>>>(false);
+}
+
+TEST(StateChartMove, mpsc_queue)
+{
+    runMoveOnly<MpscQueue<MoveEvent>>(true);
+}
+} // namespace
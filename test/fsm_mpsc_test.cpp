@@ -0,0 +1,132 @@
+/*
+ * fsm_mpsc_test.cpp
+ *
+ *  Created on: 15 okt. 2026
+ *      Author: mikaelr
+ */
+
+#include "StateChart.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace
+{ // Make sure no other names interfere with testing.
+
+class MpscFsm;
+
+// Events encode producer number and sequence number.
+struct Ev
+{
+    int producer;
+    int seq;
+};
+
+class MpscFsmDesc
+{
+  public:
+    enum class StateId
+    {
+        counting,
+        stateIdNo // Keep this last. Gives the number of states.
+    };
+
+    using Event = Ev;
+    using Fsm = MpscFsm;
+
+    // Producers post from other threads.
+    using Queue = MpscQueue<Ev>;
+
+    static void setupStates(FsmSetup<MpscFsmDesc>& sc);
+};
+
+static const int producerNo = 4;
+static const int eventNo = 20000;
+
+class MpscFsm : public FsmBase<MpscFsmDesc>
+{
+  public:
+    std::vector<int> lastSeq = std::vector<int>(producerNo + 1, -1);
+    std::atomic<int> handled{0};
+    bool inOrder = true;
+};
+
+class Counting : public StateBase<MpscFsmDesc, MpscFsmDesc::StateId::counting>
+{
+  public:
+    explicit Counting(StateArgs& args) : StateBase(args) {}
+
+    bool event(const Ev& ev)
+    {
+        auto& last = fsm().lastSeq[ev.producer];
+        if (ev.seq != last + 1)
+            fsm().inOrder = false;
+        last = ev.seq;
+
+        // Every 100th event posts a follow up from inside the handler.
+        if (ev.producer < producerNo && ev.seq % 100 == 0)
+            fsm().postEvent(Ev{producerNo, internalPosted++});
+        fsm().handled.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    int internalPosted = 0;
+};
+
+void
+MpscFsmDesc::setupStates(FsmSetup<MpscFsmDesc>& sc)
+{
+    sc.addState<Counting>();
+}
+
+TEST(MpscQueue, fifo)
+{
+    MpscQueue<int> q;
+    EXPECT_TRUE(q.empty());
+    for (int i = 0; i < 5; i++)
+        q.push(i);
+    for (int i = 0; i < 5; i++)
+    {
+        ASSERT_FALSE(q.empty());
+        EXPECT_EQ(q.front(), i);
+        q.pop();
+    }
+    EXPECT_TRUE(q.empty());
+
+    // Elements left at destruction are released.
+    q.push(7);
+}
+
+TEST(StateChartMpsc, producers)
+{
+    MpscFsm fsm;
+    fsm.setStartState(MpscFsmDesc::StateId::counting);
+
+    const int internalNo = producerNo * eventNo / 100;
+    const int total = producerNo * eventNo + internalNo;
+
+    std::thread consumer([&fsm, total] {
+        while (fsm.handled.load(std::memory_order_relaxed) < total)
+            fsm.processQueue();
+    });
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < producerNo; p++)
+        producers.emplace_back([&fsm, p] {
+            for (int i = 0; i < eventNo; i++)
+                fsm.postEvent(Ev{p, i});
+        });
+
+    for (auto& t : producers)
+        t.join();
+    consumer.join();
+
+    EXPECT_EQ(fsm.handled.load(), total);
+    EXPECT_TRUE(fsm.inOrder);
+    for (int p = 0; p < producerNo; p++)
+        EXPECT_EQ(fsm.lastSeq[p], eventNo - 1);
+    EXPECT_EQ(fsm.lastSeq[producerNo], internalNo - 1);
+}
+} // namespace
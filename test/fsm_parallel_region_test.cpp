@@ -0,0 +1,262 @@
+/*
+ * fsm_parallel_region_test.cpp
+ *
+ *  Created on: 15 okt. 2026
+ *      Author: mikaelr
+ */
+
+#include "RegionPool.h"
+#include "StateChart.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+namespace
+{ // Make sure no other names interfere with testing.
+
+TEST(RegionPool, runs_every_task_once)
+{
+    for (int threadNo : {0, 1, 3})
+    {
+        RegionPool pool(threadNo);
+        EXPECT_EQ(pool.threadNo(), threadNo);
+        std::vector<std::atomic<int>> counts(5);
+        for (int batch = 0; batch < 1000; batch++)
+            pool.run(5,
+                     [](void* context, int task) {
+                         static_cast<std::atomic<int>*>(context)[task]++;
+                     },
+                     counts.data());
+        for (auto& count : counts)
+            EXPECT_EQ(count, 1000);
+    }
+}
+
+/**
+ * 'Root' has three regions. The second region holds 'B', which has two
+ * regions of its own, or 'Bx'. Each leaf toggles on its key or on 'all'.
+ */
+enum class Ev
+{
+    a,
+    b,
+    c,
+    d,
+    all,
+    stop,
+    other,
+};
+
+class ParFsm;
+
+struct Desc
+{
+    enum class StateId
+    {
+        idle,
+        root,
+        a1,
+        a2,
+        b,
+        bx,
+        b1,
+        b2,
+        c1,
+        c2,
+        d1,
+        d2,
+        stateIdNo // Keep this last. Gives the number of states.
+    };
+    using Event = Ev;
+    using Fsm = ParFsm;
+    static void setupStates(FsmSetup<Desc>& sc);
+};
+using StateId = Desc::StateId;
+
+// The log is only written on entry and exit, which are never parallel.
+class ParFsm : public FsmBase<Desc>
+{
+  public:
+    explicit ParFsm(std::string& log) : log(log) {}
+    std::string& log;
+    std::atomic<int> calls{0};
+};
+
+template <StateId id>
+class LogState : public StateBase<Desc, id>
+{
+  public:
+    LogState(StateArgs& args, const char* name)
+        : StateBase<Desc, id>(args), m_name(name)
+    {
+        this->fsm().log += std::string("+") + m_name;
+    }
+    ~LogState()
+    {
+        this->fsm().log += std::string("-") + m_name;
+    }
+    const char* m_name;
+};
+
+class Root;
+
+class Idle : public LogState<StateId::idle>
+{
+  public:
+    explicit Idle(StateArgs& args) : LogState(args, "idle") {}
+    bool event(Ev)
+    {
+        transition<Root>();
+        return true;
+    }
+};
+
+class Root : public LogState<StateId::root>
+{
+  public:
+    explicit Root(StateArgs& args) : LogState(args, "root") {}
+    bool event(Ev ev)
+    {
+        // Called after the regions, on the dispatching thread.
+        fsm().log += "!root";
+        return ev == Ev::other;
+    }
+};
+
+// Leaf toggling to 'Next' on 'key'.
+template <StateId id, class Next, Ev key>
+class Toggle : public LogState<id>
+{
+  public:
+    Toggle(StateArgs& args, const char* name) : LogState<id>(args, name) {}
+    bool event(Ev ev)
+    {
+        this->fsm().calls++;
+        if (ev == Ev::stop && id == StateId::d2)
+        {
+            this->template transition<Idle>();
+            return true;
+        }
+        if (ev != key && ev != Ev::all)
+            return false;
+        this->template transition<Next>();
+        return true;
+    }
+};
+
+#define TOGGLE(Name, id, Next, key)                                           \
+    class Next;                                                               \
+    class Name : public Toggle<StateId::id, Next, Ev::key>                    \
+    {                                                                         \
+      public:                                                                 \
+        explicit Name(StateArgs& args) : Toggle(args, #id) {}                 \
+    };
+
+TOGGLE(A1, a1, A2, a)
+TOGGLE(A2, a2, A1, a)
+TOGGLE(Bx, bx, B, all)
+TOGGLE(B1, b1, B2, c)
+TOGGLE(B2, b2, B1, c)
+TOGGLE(C1, c1, C2, c)
+TOGGLE(C2, c2, C1, c)
+TOGGLE(D1, d1, D2, d)
+TOGGLE(D2, d2, D1, d)
+#undef TOGGLE
+
+class B : public LogState<StateId::b>
+{
+  public:
+    explicit B(StateArgs& args) : LogState(args, "b") {}
+    bool event(Ev ev)
+    {
+        if (ev != Ev::b)
+            return false;
+        transition<Bx>();
+        return true;
+    }
+};
+
+void
+Desc::setupStates(FsmSetup<Desc>& sc)
+{
+    sc.addState<Idle>();
+    sc.addState<Root>();
+    sc.addState<A1, Root>(0);
+    sc.addState<A2, Root>(0);
+    sc.addState<B, Root>(1);
+    sc.addState<Bx, Root>(1);
+    sc.addState<B1, B>(0);
+    sc.addState<B2, B>(0);
+    sc.addState<C1, B>(1);
+    sc.addState<C2, B>(1);
+    sc.addState<D1, Root>(2);
+    sc.addState<D2, Root>(2);
+}
+
+class ParallelRegions : public ::testing::Test
+{
+  protected:
+    ParallelRegions()
+    {
+        parallel.setRegionExecutor(&pool);
+        parallel.setStartState(StateId::idle);
+        sequential.setStartState(StateId::idle);
+    }
+
+    // Post to both FSMs. Return the parallel log, expecting the same
+    // sequential one.
+    std::string post(Ev ev)
+    {
+        parallelLog.clear();
+        sequentialLog.clear();
+        parallel.postEvent(ev);
+        sequential.postEvent(ev);
+        EXPECT_EQ(parallelLog, sequentialLog);
+        EXPECT_EQ(parallel.currentStateId(), sequential.currentStateId());
+        EXPECT_EQ(parallel.calls, sequential.calls);
+        return parallelLog;
+    }
+
+    RegionPool pool{2};
+    std::string parallelLog;
+    std::string sequentialLog;
+    ParFsm parallel{parallelLog};
+    ParFsm sequential{sequentialLog};
+};
+
+TEST_F(ParallelRegions, same_as_sequential)
+{
+    EXPECT_EQ(post(Ev::a), "-idle+root+a1+b+b1+c1+d1");
+
+    // Transitions of all regions, nested ones included, in region order.
+    EXPECT_EQ(post(Ev::all), "-a1+a2-b1+b2-c1+c2-d1+d2");
+    EXPECT_EQ(post(Ev::c), "-b2+b1-c2+c1");
+
+    // Bubbles within a region, and past all regions to 'Root'.
+    EXPECT_EQ(post(Ev::b), "-c1-b1-b+bx");
+    EXPECT_EQ(post(Ev::other), "!root");
+    EXPECT_EQ(post(Ev::all), "-a2+a1-bx+b+b1+c1-d2+d1");
+
+    // One region leaves 'Root'.
+    post(Ev::d);
+    EXPECT_EQ(post(Ev::stop), "-d2-c1-b1-b-a1-root+idle");
+    EXPECT_EQ(parallel.currentStateId(), StateId::idle);
+
+    // Back to sequential dispatch.
+    parallel.setRegionExecutor(nullptr);
+    EXPECT_EQ(post(Ev::a), "-idle+root+a1+b+b1+c1+d1");
+    EXPECT_EQ(post(Ev::all), "-a1+a2-b1+b2-c1+c2-d1+d2");
+}
+
+TEST_F(ParallelRegions, many_events)
+{
+    post(Ev::a);
+    const Ev events[] = {Ev::a, Ev::c, Ev::all, Ev::b, Ev::d, Ev::other};
+    for (int i = 0; i < 600; i++)
+        post(events[i * 7 % 6]);
+    EXPECT_GT(parallel.calls, 600);
+}
+} // namespace
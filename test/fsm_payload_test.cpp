@@ -0,0 +1,253 @@
+/*
+ * fsm_payload_test.cpp
+ *
+ *  Created on: 16 okt. 2026
+ *      Author: mikaelr
+ */
+
+#include "StateChart.h"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace
+{ // Make sure no other names interfere with testing.
+
+enum class Cmd
+{
+    load,
+    loadDropped,
+    plain,
+    unload,
+};
+
+// Count the copies and moves of a payload.
+struct Counts
+{
+    int copies = 0;
+    int moves = 0;
+    int destroyed = 0;
+};
+
+struct Buffer
+{
+    Buffer(std::vector<int> data, Counts& counts)
+        : data(std::move(data)), counts(&counts)
+    {
+    }
+    Buffer(const Buffer& other) : data(other.data), counts(other.counts)
+    {
+        counts->copies++;
+    }
+    Buffer(Buffer&& other) : data(std::move(other.data)), counts(other.counts)
+    {
+        counts->moves++;
+    }
+    ~Buffer()
+    {
+        counts->destroyed++;
+    }
+    std::vector<int> data;
+    Counts* counts;
+};
+
+class LoaderFsm;
+
+struct LoaderDesc
+{
+    enum class StateId
+    {
+        idle,
+        loaded,
+        stateIdNo // Keep this last. Gives the number of states.
+    };
+    using Event = Cmd;
+    using Fsm = LoaderFsm;
+    static void setupStates(FsmSetup<LoaderDesc>& sc);
+};
+
+class LoaderFsm : public FsmBase<LoaderDesc>
+{
+  public:
+    Counts counts;
+};
+
+using StateId = LoaderDesc::StateId;
+
+class Loaded;
+
+class Idle : public StateBase<LoaderDesc, StateId::idle>
+{
+  public:
+    explicit Idle(StateArgs& args) : StateBase(args) {}
+
+    bool event(Cmd cmd)
+    {
+        Counts& counts = fsm().counts;
+        if (cmd == Cmd::load)
+            transition<Loaded>(Buffer({1, 2, 3}, counts), 7);
+        else if (cmd == Cmd::loadDropped)
+        {
+            // A later request replaces the one with the payload.
+            transition<Loaded>(Buffer({1}, counts), 1);
+            transition<Idle>();
+        }
+        else if (cmd == Cmd::plain)
+            transition<Loaded>();
+        return true;
+    }
+};
+
+class Loaded : public StateBase<LoaderDesc, StateId::loaded>
+{
+  public:
+    explicit Loaded(StateArgs& args) : StateBase(args), buffer({}, dummy) {}
+
+    Loaded(StateArgs& args, Buffer buffer, int tag)
+        : StateBase(args), buffer(std::move(buffer)), tag(tag)
+    {
+    }
+
+    bool event(Cmd cmd)
+    {
+        if (cmd == Cmd::unload)
+            transition<Idle>();
+        return true;
+    }
+
+    Counts dummy;
+    Buffer buffer;
+    int tag = -1;
+};
+
+void
+LoaderDesc::setupStates(FsmSetup<LoaderDesc>& sc)
+{
+    sc.addState<Idle>();
+    sc.addState<Loaded>();
+}
+
+TEST(Payload, moved_into_target)
+{
+    LoaderFsm fsm;
+    fsm.setStartState(StateId::idle);
+    fsm.postEvent(Cmd::load);
+
+    const Loaded* loaded = fsm.currentState<Loaded>();
+    ASSERT_TRUE(loaded);
+    EXPECT_EQ(loaded->tag, 7);
+    EXPECT_EQ(loaded->buffer.data, (std::vector<int>{1, 2, 3}));
+    EXPECT_EQ(fsm.counts.copies, 0);
+
+    // The payload is destroyed once the target is entered. Only the
+    // state's buffer is left.
+    EXPECT_EQ(fsm.counts.destroyed, fsm.counts.moves);
+
+    // Entered again without a payload.
+    fsm.postEvent(Cmd::unload);
+    fsm.postEvent(Cmd::plain);
+    loaded = fsm.currentState<Loaded>();
+    ASSERT_TRUE(loaded);
+    EXPECT_EQ(loaded->tag, -1);
+    EXPECT_TRUE(loaded->buffer.data.empty());
+}
+
+TEST(Payload, dropped_without_entry)
+{
+    LoaderFsm fsm;
+    fsm.setStartState(StateId::idle);
+    fsm.postEvent(Cmd::loadDropped);
+    EXPECT_EQ(fsm.currentStateId(), StateId::idle);
+
+    // The temporary and the payload.
+    EXPECT_EQ(fsm.counts.destroyed, 2);
+
+    // The next entry does not see the old payload.
+    fsm.postEvent(Cmd::plain);
+    EXPECT_EQ(fsm.currentState<Loaded>()->tag, -1);
+}
+
+/**
+ * A payload passed on by the constructor of its target. 'Relay' forwards
+ * the text, with a larger payload, to 'Last'.
+ */
+class RelayFsm;
+
+struct RelayDesc
+{
+    enum class StateId
+    {
+        start,
+        relay,
+        last,
+        stateIdNo // Keep this last. Gives the number of states.
+    };
+    using Event = int;
+    using Fsm = RelayFsm;
+    static void setupStates(FsmSetup<RelayDesc>& sc);
+};
+
+class RelayFsm : public FsmBase<RelayDesc>
+{
+};
+
+class Relay;
+class Last;
+
+class Start : public StateBase<RelayDesc, RelayDesc::StateId::start>
+{
+  public:
+    explicit Start(StateArgs& args) : StateBase(args) {}
+    bool event(int)
+    {
+        transition<Relay>(std::string("text"));
+        return true;
+    }
+};
+
+class Relay : public StateBase<RelayDesc, RelayDesc::StateId::relay>
+{
+  public:
+    explicit Relay(StateArgs& args) : StateBase(args) {}
+    Relay(StateArgs& args, std::string text) : StateBase(args)
+    {
+        transition<Last>(std::move(text) + " relayed", std::vector<int>(64));
+    }
+};
+
+class Last : public StateBase<RelayDesc, RelayDesc::StateId::last>
+{
+  public:
+    explicit Last(StateArgs& args) : StateBase(args), text("<plain ctor>") {}
+    Last(StateArgs& args, std::string text, std::vector<int> data)
+        : StateBase(args), text(std::move(text)), data(std::move(data))
+    {
+    }
+    std::string text;
+    std::vector<int> data;
+};
+
+void
+RelayDesc::setupStates(FsmSetup<RelayDesc>& sc)
+{
+    sc.addState<Start>();
+    sc.addState<Relay>();
+    sc.addState<Last>();
+}
+
+TEST(Payload, set_by_target_constructor)
+{
+    RelayFsm fsm;
+    fsm.setStartState(RelayDesc::StateId::start);
+    fsm.postEvent(0);
+
+    const Last* last = fsm.currentState<Last>();
+    ASSERT_TRUE(last);
+    EXPECT_EQ(last->text, "text relayed");
+    EXPECT_EQ(last->data.size(), 64u);
+}
+} // namespace
@@ -0,0 +1,195 @@
+/*
+ * fsm_pool_test.cpp
+ *
+ *  Created on: 15 okt. 2026
+ *      Author: mikaelr
+ */
+
+#include "FsmPool.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+namespace
+{ // Make sure no other names interfere with testing.
+
+class PoolFsm;
+class Idle;
+class Busy;
+
+struct PoolFsmDesc
+{
+    enum class StateId
+    {
+        idle,
+        busy,
+        stateIdNo // Keep this last. Gives the number of states.
+    };
+    using Event = int;
+    using Fsm = PoolFsm;
+    using States = StateList<StateDef<Idle>, StateDef<Busy, Idle>>;
+};
+
+int liveStates = 0;
+
+class PoolFsm : public FsmBase<PoolFsmDesc>
+{
+  public:
+    PoolFsm(int tag = 0) : tag(tag) {}
+    int tag;
+    std::vector<int> received;
+};
+
+class Idle : public StateBase<PoolFsmDesc, PoolFsmDesc::StateId::idle>
+{
+  public:
+    explicit Idle(StateArgs& args) : StateBase(args)
+    {
+        liveStates++;
+    }
+    ~Idle()
+    {
+        liveStates--;
+    }
+    bool event(int ev)
+    {
+        fsm().received.push_back(ev);
+        if (ev < 0)
+            transition<Busy>();
+        return true;
+    }
+};
+
+class Busy : public StateBase<PoolFsmDesc, PoolFsmDesc::StateId::busy>
+{
+  public:
+    explicit Busy(StateArgs& args) : StateBase(args)
+    {
+        liveStates++;
+    }
+    ~Busy()
+    {
+        liveStates--;
+    }
+    bool event(int)
+    {
+        return false;
+    }
+};
+
+using Pool = FsmPool<PoolFsmDesc>;
+
+TEST(StateChartPool, instances_live_in_slots)
+{
+    Pool pool(4);
+    std::vector<Pool::Id> ids;
+    pool.createBatch(10, ids);
+    ASSERT_EQ(pool.size(), 10u);
+
+    for (auto id : ids)
+    {
+        auto& fsm = pool[id];
+        fsm.setStartState(PoolFsmDesc::StateId::busy);
+        // The active states are inside the slot of the instance.
+        auto slot = reinterpret_cast<const char*>(&fsm);
+        auto state = static_cast<const char*>(fsm.member().getState(1));
+        EXPECT_GT(state, slot);
+        EXPECT_LT(state, slot + pool.slotSize());
+    }
+    EXPECT_EQ(liveStates, 20);
+
+    pool.destroyBatch(ids);
+    EXPECT_EQ(pool.size(), 0u);
+    EXPECT_EQ(liveStates, 0);
+}
+
+TEST(StateChartPool, destroy_reuses_ids)
+{
+    Pool pool(4);
+    auto a = pool.create(1);
+    auto b = pool.create(2);
+    EXPECT_EQ(pool[b].tag, 2);
+
+    pool.destroy(a);
+    EXPECT_FALSE(pool.live(a));
+    auto c = pool.create(3);
+    EXPECT_EQ(c, a);
+    EXPECT_EQ(pool[c].tag, 3);
+    EXPECT_TRUE(pool.live(b));
+}
+
+// Constructs an FSM of its own before the pooled FSM base.
+struct Scratch
+{
+    Scratch()
+    {
+        PoolFsm scratch;
+        scratchBlockSize = scratch.member().blockSize();
+    }
+    size_t scratchBlockSize;
+};
+
+class NestingFsm;
+class Only;
+
+struct NestingDesc
+{
+    enum class StateId
+    {
+        only,
+        stateIdNo // Keep this last. Gives the number of states.
+    };
+    using Event = int;
+    using Fsm = NestingFsm;
+    using States = StateList<StateDef<Only>>;
+};
+
+class NestingFsm : public Scratch, public FsmBase<NestingDesc>
+{
+};
+
+class Only : public StateBase<NestingDesc, NestingDesc::StateId::only>
+{
+  public:
+    explicit Only(StateArgs& args) : StateBase(args) {}
+};
+
+TEST(StateChartPool, block_taken_by_pooled_instance)
+{
+    FsmPool<NestingDesc> pool(2);
+    auto id = pool.create();
+    auto& fsm = pool[id];
+    fsm.setStartState(NestingDesc::StateId::only);
+
+    // The scratch FSM allocated its own block, the pooled one is in the
+    // slot.
+    EXPECT_GT(fsm.scratchBlockSize, 0u);
+    auto slot = reinterpret_cast<const char*>(&fsm);
+    auto state = static_cast<const char*>(fsm.member().getState(0));
+    EXPECT_GT(state, slot);
+    EXPECT_LT(state, slot + pool.slotSize());
+}
+
+TEST(StateChartPool, dispatch_batch)
+{
+    {
+        Pool pool(2);
+        std::vector<Pool::Id> ids;
+        pool.createBatch(3, ids);
+        for (auto id : ids)
+            pool[id].setStartState(PoolFsmDesc::StateId::idle);
+
+        std::vector<Pool::Id> to = {ids[2], ids[0], ids[2], ids[1], ids[0]};
+        std::vector<int> events = {1, 2, -3, 4, 5};
+        pool.dispatchBatch(to, events);
+
+        EXPECT_EQ(pool[ids[0]].received, (std::vector<int>{2, 5}));
+        EXPECT_EQ(pool[ids[1]].received, (std::vector<int>{4}));
+        EXPECT_EQ(pool[ids[2]].received, (std::vector<int>{1, -3}));
+        EXPECT_EQ(pool[ids[2]].currentStateId(), PoolFsmDesc::StateId::busy);
+    }
+    // The pool destroys the instances still alive.
+    EXPECT_EQ(liveStates, 0);
+}
+} // namespace
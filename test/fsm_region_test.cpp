@@ -0,0 +1,405 @@
+/*
+ * fsm_region_test.cpp
+ *
+ *  Created on: 15 okt. 2026
+ *      Author: mikaelr
+ */
+
+#include "StateChart.h"
+
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+#include <string>
+
+namespace
+{ // Make sure no other names interfere with testing.
+
+/**
+ * A keyboard with two orthogonal regions in the 'On' state, one for caps
+ * lock and one for num lock. 'NumBlink' is a plain sub state inside a
+ * region.
+ */
+enum class Key
+{
+    power,
+    caps,
+    num,
+    both,  // Toggles both locks.
+    reset, // Transition to 'On' itself.
+    crash, // Caps region leaves 'On', num region toggles.
+    blink,
+    blinkLocal, // Local transition to 'NumBlink'.
+    unknown,
+};
+
+template <class Desc>
+class KeyFsm;
+template <class Desc>
+class Off;
+template <class Desc>
+class On;
+template <class Desc>
+class CapsOff;
+template <class Desc>
+class CapsOn;
+template <class Desc>
+class NumOff;
+template <class Desc>
+class NumOn;
+template <class Desc>
+class NumBlink;
+
+// Shared by a runtime and a compile time description below.
+struct KeyIds
+{
+    enum class StateId
+    {
+        off,
+        on,
+        capsOff,
+        capsOn,
+        numOff,
+        numOn,
+        numBlink,
+        stateIdNo // Keep this last. Gives the number of states.
+    };
+    using Event = Key;
+};
+
+struct RuntimeDesc : KeyIds
+{
+    using Fsm = KeyFsm<RuntimeDesc>;
+    static void setupStates(FsmSetup<RuntimeDesc>& sc)
+    {
+        sc.addState<Off<RuntimeDesc>>();
+        sc.addState<On<RuntimeDesc>>();
+        sc.addState<CapsOff<RuntimeDesc>, On<RuntimeDesc>>(0);
+        sc.addState<CapsOn<RuntimeDesc>, On<RuntimeDesc>>(0);
+        sc.addState<NumOff<RuntimeDesc>, On<RuntimeDesc>>(1);
+        sc.addState<NumOn<RuntimeDesc>, On<RuntimeDesc>>(1);
+        sc.addState<NumBlink<RuntimeDesc>, NumOn<RuntimeDesc>>();
+    }
+};
+
+struct ConstDesc : KeyIds
+{
+    using Fsm = KeyFsm<ConstDesc>;
+    using States =
+        StateList<StateDef<Off<ConstDesc>>, StateDef<On<ConstDesc>>,
+                  StateDef<CapsOff<ConstDesc>, On<ConstDesc>, 0>,
+                  StateDef<CapsOn<ConstDesc>, On<ConstDesc>, 0>,
+                  StateDef<NumOff<ConstDesc>, On<ConstDesc>, 1>,
+                  StateDef<NumOn<ConstDesc>, On<ConstDesc>, 1>,
+                  StateDef<NumBlink<ConstDesc>, NumOn<ConstDesc>>>;
+};
+
+// The log outlives the FSM, so the final exits are logged too.
+template <class Desc>
+class KeyFsm : public FsmBase<Desc>
+{
+  public:
+    explicit KeyFsm(std::string& log) : log(log) {}
+    std::string& log;
+};
+
+// Log entry and exit.
+template <class Desc, typename Desc::StateId id>
+class LogState : public StateBase<Desc, id>
+{
+  public:
+    LogState(StateArgs& args, const char* name)
+        : StateBase<Desc, id>(args), m_name(name)
+    {
+        this->fsm().log += std::string("+") + m_name;
+    }
+    ~LogState()
+    {
+        this->fsm().log += std::string("-") + m_name;
+    }
+    const char* m_name;
+};
+
+template <class Desc>
+class Off : public LogState<Desc, Desc::StateId::off>
+{
+  public:
+    explicit Off(StateArgs& args)
+        : LogState<Desc, Desc::StateId::off>(args, "off")
+    {
+    }
+    bool event(Key key)
+    {
+        if (key == Key::power)
+            this->template transition<On<Desc>>();
+        return true;
+    }
+};
+
+template <class Desc>
+class On : public LogState<Desc, Desc::StateId::on>
+{
+  public:
+    explicit On(StateArgs& args)
+        : LogState<Desc, Desc::StateId::on>(args, "on")
+    {
+    }
+    bool event(Key key)
+    {
+        this->fsm().log += "!on";
+        if (key == Key::power)
+            this->template transition<Off<Desc>>();
+        else if (key == Key::reset)
+            this->template transition<On<Desc>>();
+        return true;
+    }
+    int presses = 0;
+};
+
+template <class Desc>
+class CapsOff : public LogState<Desc, Desc::StateId::capsOff>
+{
+  public:
+    explicit CapsOff(StateArgs& args)
+        : LogState<Desc, Desc::StateId::capsOff>(args, "capsOff")
+    {
+    }
+    bool event(Key key)
+    {
+        if (key == Key::crash)
+            this->template transition<Off<Desc>>();
+        if (key != Key::caps && key != Key::both)
+            return key == Key::crash;
+        this->template parent<On<Desc>>().presses++;
+        this->template transition<CapsOn<Desc>>();
+        return true;
+    }
+};
+
+template <class Desc>
+class CapsOn : public LogState<Desc, Desc::StateId::capsOn>
+{
+  public:
+    explicit CapsOn(StateArgs& args)
+        : LogState<Desc, Desc::StateId::capsOn>(args, "capsOn")
+    {
+    }
+    bool event(Key key)
+    {
+        if (key != Key::caps && key != Key::both)
+            return false;
+        this->template transition<CapsOff<Desc>>();
+        return true;
+    }
+};
+
+template <class Desc>
+class NumOff : public LogState<Desc, Desc::StateId::numOff>
+{
+  public:
+    explicit NumOff(StateArgs& args)
+        : LogState<Desc, Desc::StateId::numOff>(args, "numOff")
+    {
+    }
+    bool event(Key key)
+    {
+        if (key != Key::num && key != Key::both && key != Key::crash)
+            return false;
+        this->template parent<On<Desc>>().presses++;
+        this->template transition<NumOn<Desc>>();
+        return true;
+    }
+};
+
+template <class Desc>
+class NumOn : public LogState<Desc, Desc::StateId::numOn>
+{
+  public:
+    explicit NumOn(StateArgs& args)
+        : LogState<Desc, Desc::StateId::numOn>(args, "numOn")
+    {
+    }
+    bool event(Key key)
+    {
+        if (key == Key::blink)
+            this->template transition<NumBlink<Desc>>();
+        else if (key == Key::blinkLocal)
+            this->template localTransition<NumBlink<Desc>>();
+        else if (key == Key::num || key == Key::both)
+            this->template transition<NumOff<Desc>>();
+        else
+            return false;
+        return true;
+    }
+};
+
+template <class Desc>
+class NumBlink : public LogState<Desc, Desc::StateId::numBlink>
+{
+  public:
+    explicit NumBlink(StateArgs& args)
+        : LogState<Desc, Desc::StateId::numBlink>(args, "numBlink")
+    {
+    }
+    // No event function. Bubbles to NumOn.
+};
+
+template <class Desc>
+class Regions : public ::testing::Test
+{
+  protected:
+    // Return the log and clear it.
+    std::string take()
+    {
+        std::string taken = log;
+        log.clear();
+        return taken;
+    }
+
+    std::string log;
+    KeyFsm<Desc> fsm{log};
+};
+
+using Descs = ::testing::Types<RuntimeDesc, ConstDesc>;
+TYPED_TEST_SUITE(Regions, Descs);
+
+TYPED_TEST(Regions, layout)
+{
+    using StateId = KeyIds::StateId;
+    const FsmStaticData& data = FsmStaticInstance<TypeParam>::get();
+    EXPECT_EQ(data.levelNo(), 3);
+    EXPECT_EQ(data.frameNo(), 4);
+    EXPECT_EQ(data.orthogonalNo(), 2);
+
+    // The regions follow each other, sub states of one region share.
+    const auto* on = data.findState(int(StateId::on));
+    const auto* capsOn = data.findState(int(StateId::capsOn));
+    const auto* numOff = data.findState(int(StateId::numOff));
+    const auto* numOn = data.findState(int(StateId::numOn));
+    const auto* numBlink = data.findState(int(StateId::numBlink));
+    EXPECT_EQ(capsOn->m_frame, 1);
+    EXPECT_EQ(numOn->m_frame, 2);
+    EXPECT_EQ(numBlink->m_frame, 3);
+    EXPECT_EQ(numOff->m_offset, numOn->m_offset);
+    EXPECT_GE(numOn->m_offset,
+              capsOn->m_offset + FsmStaticData::alignUp(capsOn->m_size));
+    EXPECT_EQ(numBlink->m_offset,
+              numOn->m_offset + FsmStaticData::alignUp(numOn->m_size));
+    EXPECT_EQ(data.region(on, 1).m_initial, int(StateId::numOff));
+}
+
+TYPED_TEST(Regions, enter_and_dispatch)
+{
+    using StateId = KeyIds::StateId;
+    auto& fsm = this->fsm;
+    fsm.setStartState(StateId::off);
+    EXPECT_EQ(this->take(), "+off");
+    fsm.postEvent(Key::power);
+    EXPECT_EQ(this->take(), "-off+on+capsOff+numOff");
+    EXPECT_EQ(fsm.currentStateId(), StateId::capsOff);
+    EXPECT_TRUE(fsm.template activeState<NumOff<TypeParam>>());
+    EXPECT_TRUE(fsm.template activeState<On<TypeParam>>());
+    EXPECT_FALSE(fsm.template activeState<Off<TypeParam>>());
+    EXPECT_TRUE(fsm.isIn(StateId::numOff));
+    EXPECT_TRUE(fsm.isInAll(FsmStateSet<TypeParam>{
+        StateId::on, StateId::capsOff, StateId::numOff}));
+
+    // Only the region handling the event changes.
+    fsm.postEvent(Key::caps);
+    EXPECT_EQ(this->take(), "-capsOff+capsOn");
+    EXPECT_EQ(fsm.currentStateId(), StateId::capsOn);
+    fsm.postEvent(Key::num);
+    EXPECT_EQ(this->take(), "-numOff+numOn");
+    EXPECT_EQ(fsm.template activeState<On<TypeParam>>()->presses, 2);
+
+    // Both regions get the event and both transitions are applied.
+    fsm.postEvent(Key::both);
+    EXPECT_EQ(this->take(), "-capsOn+capsOff-numOn+numOff");
+
+    // Not handled by any region, bubbles to the composite state.
+    fsm.postEvent(Key::unknown);
+    EXPECT_EQ(this->take(), "!on");
+
+    // Plain sub state in a region, bubbling within the region.
+    fsm.postEvent(Key::num);
+    fsm.postEvent(Key::blink);
+    EXPECT_EQ(this->take(), "-numOff+numOn+numBlink");
+    fsm.postEvent(Key::num);
+    EXPECT_EQ(this->take(), "-numBlink-numOn+numOff");
+
+    // Leaving the composite state exits all regions, last region first.
+    fsm.postEvent(Key::power);
+    EXPECT_EQ(this->take(), "!on-numOff-capsOff-on+off");
+    EXPECT_EQ(fsm.currentStateId(), StateId::off);
+    EXPECT_FALSE(fsm.isInAny(FsmStateSet<TypeParam>{
+        StateId::on, StateId::capsOff, StateId::numOff}));
+}
+
+TYPED_TEST(Regions, local_transition)
+{
+    auto& fsm = this->fsm;
+    fsm.setStartState(KeyIds::StateId::numOn);
+    this->take();
+
+    // Entered below the active source state.
+    fsm.postEvent(Key::blinkLocal);
+    EXPECT_EQ(this->take(), "+numBlink");
+
+    // The active target is kept, unlike with a plain transition.
+    fsm.postEvent(Key::blinkLocal);
+    EXPECT_EQ(this->take(), "");
+    fsm.postEvent(Key::blink);
+    EXPECT_EQ(this->take(), "-numBlink+numBlink");
+    EXPECT_TRUE(fsm.isIn(KeyIds::StateId::numBlink));
+}
+
+TYPED_TEST(Regions, transitions)
+{
+    using StateId = KeyIds::StateId;
+    auto& fsm = this->fsm;
+
+    // A deep target enters the other regions at their initial state.
+    fsm.setStartState(StateId::numBlink);
+    EXPECT_EQ(this->take(), "+on+capsOff+numOn+numBlink");
+    EXPECT_EQ(fsm.currentStateId(), StateId::capsOff);
+
+    // Transition to the active composite state keeps it, and enters the
+    // initial states again.
+    fsm.postEvent(Key::caps);
+    this->take();
+    fsm.postEvent(Key::reset);
+    EXPECT_EQ(this->take(), "!on-numBlink-numOn-capsOn+capsOff+numOff");
+    EXPECT_EQ(fsm.template activeState<On<TypeParam>>()->presses, 1);
+
+    // The caps region leaves 'On'. The transition of the num region is
+    // dropped since its state is no longer active.
+    fsm.postEvent(Key::crash);
+    EXPECT_EQ(this->take(), "-numOff-capsOff-on+off");
+    EXPECT_EQ(fsm.currentStateId(), StateId::off);
+}
+
+// Plain sub states next to regions are a setup error.
+TEST(RegionSetup, mixed_regions)
+{
+    FsmStaticBuilder builder(3);
+    const FsmStaticData::StateInfo info;
+    builder.addStateBase(0, 0, info);
+    builder.addStateBase(1, 0, info, 0);
+    builder.addStateBase(2, 0, info);
+#ifdef STATECHART_NO_EXCEPTIONS
+    EXPECT_DEATH(builder.finalize(), "Mixed or empty regions");
+#else
+    EXPECT_THROW(builder.finalize(), std::runtime_error);
+#endif
+}
+
+TYPED_TEST(Regions, restart)
+{
+    auto& fsm = this->fsm;
+    fsm.setStartState(KeyIds::StateId::numBlink);
+    this->take();
+    fsm.setStartState(KeyIds::StateId::capsOn);
+    EXPECT_EQ(this->take(), "-numBlink-numOn-capsOff-on+on+capsOn+numOff");
+    EXPECT_EQ(fsm.currentStateId(), KeyIds::StateId::capsOn);
+}
+} // namespace
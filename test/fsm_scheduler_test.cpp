@@ -0,0 +1,150 @@
+/*
+ * fsm_scheduler_test.cpp
+ *
+ *  Created on: 15 okt. 2026
+ *      Author: mikaelr
+ */
+
+#include "FsmScheduler.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace
+{ // Make sure no other names interfere with testing.
+
+class ActorFsm;
+class Receiving;
+
+// Events encode producer number and sequence number. Positive 'hops' are
+// forwarded to the next actor.
+struct ActorEv
+{
+    int producer;
+    int seq;
+    int hops;
+};
+
+struct ActorFsmDesc
+{
+    enum class StateId
+    {
+        receiving,
+        stateIdNo // Keep this last. Gives the number of states.
+    };
+    using Event = ActorEv;
+    using Fsm = ActorFsm;
+    using Queue = MpscQueue<ActorEv>;
+    using States = StateList<StateDef<Receiving>>;
+};
+
+const int producerNo = 4;
+
+class ActorFsm : public FsmActor<ActorFsmDesc>
+{
+  public:
+    ActorFsm()
+    {
+        setStartState(ActorFsmDesc::StateId::receiving);
+    }
+
+    FsmScheduler* scheduler = nullptr;
+    ActorFsm* next = nullptr;
+    std::atomic<int>* done = nullptr;
+
+    std::vector<int> lastSeq = std::vector<int>(producerNo, -1);
+    std::atomic<bool> running{false};
+    bool inOrder = true;
+    bool overlapped = false;
+    int handled = 0;
+};
+
+class Receiving
+    : public StateBase<ActorFsmDesc, ActorFsmDesc::StateId::receiving>
+{
+  public:
+    explicit Receiving(StateArgs& args) : StateBase(args) {}
+
+    bool event(const ActorEv& ev)
+    {
+        auto& f = fsm();
+        if (f.running.exchange(true))
+            f.overlapped = true;
+        if (ev.seq <= f.lastSeq[ev.producer])
+            f.inOrder = false;
+        f.lastSeq[ev.producer] = ev.seq;
+        f.handled++;
+        if (ev.hops > 0)
+            f.scheduler->post(*f.next,
+                              ActorEv{ev.producer, ev.seq, ev.hops - 1});
+        else if (f.done)
+            (*f.done)++;
+        f.running = false;
+        return true;
+    }
+};
+
+TEST(StateChartScheduler, order_and_exclusion)
+{
+    const int actorNo = 8;
+    const int eventNo = 5000;
+    std::vector<std::unique_ptr<ActorFsm>> actors;
+    for (int i = 0; i < actorNo; i++)
+        actors.emplace_back(new ActorFsm);
+
+    FsmScheduler scheduler(4);
+    std::vector<std::thread> producers;
+    for (int p = 0; p < producerNo; p++)
+        producers.emplace_back([&, p] {
+            for (int seq = 0; seq < eventNo; seq++)
+                scheduler.post(*actors[seq % actorNo], ActorEv{p, seq, 0});
+        });
+    for (auto& t : producers)
+        t.join();
+    scheduler.waitIdle();
+
+    for (auto& actor : actors)
+    {
+        EXPECT_EQ(actor->handled, producerNo * eventNo / actorNo);
+        EXPECT_TRUE(actor->inOrder);
+        EXPECT_FALSE(actor->overlapped);
+    }
+}
+
+TEST(StateChartScheduler, post_from_handler)
+{
+    const int actorNo = 16;
+    const int tokenNo = 32;
+    const int hops = 1000;
+    std::atomic<int> done{0};
+    FsmScheduler scheduler(3);
+
+    std::vector<std::unique_ptr<ActorFsm>> actors;
+    for (int i = 0; i < actorNo; i++)
+        actors.emplace_back(new ActorFsm);
+    for (int i = 0; i < actorNo; i++)
+    {
+        actors[i]->scheduler = &scheduler;
+        actors[i]->next = actors[(i + 1) % actorNo].get();
+        actors[i]->done = &done;
+    }
+
+    // Each token is passed 'hops' times around the ring.
+    for (int token = 0; token < tokenNo; token++)
+        scheduler.post(*actors[token % actorNo], ActorEv{0, 0, hops});
+    scheduler.waitIdle();
+
+    EXPECT_EQ(done, tokenNo);
+    int handled = 0;
+    for (auto& actor : actors)
+    {
+        handled += actor->handled;
+        EXPECT_FALSE(actor->overlapped);
+    }
+    EXPECT_EQ(handled, tokenNo * (hops + 1));
+}
+} // namespace
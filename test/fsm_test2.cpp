@@ -9,6 +9,7 @@
 
 #include <gtest/gtest.h>
 
+#include <stdexcept>
 #include <string>
 
 using std::cout;
@@ -101,6 +102,14 @@ class State1 : public StateBase<UserFsmDesc, StateId::state1>
     bool event(int ev)
     {
         fsm().td.evCnt++;
+        if (ev == 4)
+            transition(StateId::state3);
+        if (ev == 5)
+        {
+            // Post more events than the initial queue capacity.
+            for (int i = 0; i < 40; i++)
+                fsm().postEvent(0);
+        }
         return false;
     }
 
@@ -170,6 +179,15 @@ class State3 : public UserBase<StateId::state3>
         if (ev == 2)
             transition<State1>();
 
+        if (ev == 3)
+            transition(StateId::state2);
+
+        if (ev == 6)
+            localTransition<State3>();
+
+        if (ev == 7)
+            localTransition(StateId::state2);
+
         return false;
     }
     const int state3Var = 3;
@@ -295,4 +313,125 @@ TEST(StateChart, test_event_count1)
     EXPECT_EQ(fsm.currentStateId(), UserFsm::StateId::state1);
     fsm.td.equal(0, 2, 3);
 }
+TEST(StateChart, test_transition_common_ancestor)
+{
+    UserFsm fsm;
+
+    fsm.setStartState(UserFsm::StateId::state3);
+
+    // Transition to the parent state. Only state3 is exited.
+    fsm.td = TD{};
+    fsm.postEvent(3);
+    EXPECT_EQ(fsm.currentStateId(), UserFsm::StateId::state2);
+    EXPECT_TRUE(fsm.td.equal(0, 1, 3));
+
+    // Transition from a parent handler down to a sub state. State2 is
+    // the common ancestor and is kept, only state3 is entered.
+    fsm.td = TD{};
+    fsm.postEvent(4);
+    EXPECT_EQ(fsm.currentStateId(), UserFsm::StateId::state3);
+    EXPECT_TRUE(fsm.td.equal(1, 0, 2));
+
+    // Transition to self gives exit and entry of the state.
+    fsm.td = TD{};
+    fsm.postEvent(4);
+    EXPECT_EQ(fsm.currentStateId(), UserFsm::StateId::state3);
+    EXPECT_TRUE(fsm.td.equal(1, 1, 3));
+    EXPECT_TRUE(fsm.activeState<State1>());
+    EXPECT_TRUE(fsm.activeState<State2>());
+}
+TEST(StateChart, test_common_ancestor_deep_chain)
+{
+    // A chain 140 deep with two leaves. Deeper than the levels kept in
+    // the common ancestor table.
+    const int depth = 140;
+    FsmStaticBuilder builder(depth + 2);
+    const FsmStaticData::StateInfo info;
+    builder.addStateBase(0, 0, info);
+    for (int id = 1; id <= depth; id++)
+        builder.addStateBase(id, id - 1, info);
+    builder.addStateBase(depth + 1, depth - 1, info);
+
+    const FsmStaticData data = builder.finalize();
+    EXPECT_EQ(data.commonLevel(data.findState(depth),
+                               data.findState(depth + 1)),
+              depth - 1);
+    EXPECT_EQ(data.commonLevel(data.findState(depth), data.findState(0)), 0);
+}
+TEST(StateChart, test_parent_added_after_sub_state)
+{
+    FsmStaticBuilder builder(3);
+    const FsmStaticData::StateInfo info;
+    builder.addStateBase(0, 0, info);
+#ifdef STATECHART_NO_EXCEPTIONS
+    EXPECT_DEATH(builder.addStateBase(1, 2, info), "Parent state not added");
+    EXPECT_DEATH(builder.addStateBase(1, 3, info), "Parent state not added");
+#else
+    EXPECT_THROW(builder.addStateBase(1, 2, info), std::runtime_error);
+    EXPECT_THROW(builder.addStateBase(1, 3, info), std::runtime_error);
+#endif
+}
+TEST(StateChart, test_local_transition)
+{
+    UserFsm fsm;
+
+    fsm.setStartState(UserFsm::StateId::state3);
+    const State3* state3 = fsm.currentState<State3>();
+
+    // Local transition to self keeps the state object.
+    fsm.td = TD{};
+    fsm.postEvent(6);
+    EXPECT_EQ(fsm.currentState<State3>(), state3);
+    EXPECT_TRUE(fsm.td.equal(0, 0, 3));
+
+    // Local transition to the parent exits the sub state only.
+    fsm.td = TD{};
+    fsm.postEvent(7);
+    EXPECT_EQ(fsm.currentStateId(), UserFsm::StateId::state2);
+    EXPECT_TRUE(fsm.td.equal(0, 1, 3));
+}
+TEST(StateChart, test_queue_growth)
+{
+    UserFsm fsm;
+    fsm.setStartState(UserFsm::StateId::state1);
+
+    // Events posted from the handler are queued and run after it returns.
+    fsm.td = TD{};
+    fsm.postEvent(5);
+    EXPECT_TRUE(fsm.td.equal(0, 0, 41));
+
+    // Still works once the queue has moved out of the initial storage.
+    fsm.td = TD{};
+    fsm.postEvent(5);
+    EXPECT_TRUE(fsm.td.equal(0, 0, 41));
+}
+
+TEST(StateChart, test_restart)
+{
+    UserFsm fsm;
+    fsm.setStartState(UserFsm::StateId::state3);
+    EXPECT_TRUE(fsm.td.equal(3, 0, 0));
+
+    // Starting again exits the active states first.
+    fsm.setStartState(UserFsm::StateId::state2);
+    EXPECT_EQ(fsm.currentStateId(), UserFsm::StateId::state2);
+    EXPECT_TRUE(fsm.td.equal(5, 3, 0));
+}
+TEST(StateChart, test_post_order)
+{
+    UserFsm fsm;
+    fsm.setStartState(UserFsm::StateId::state3);
+
+    // Added events are not processed, and later posts queue behind them.
+    fsm.td = TD{};
+    fsm.addEvent(3);
+    fsm.postEvent(4);
+    EXPECT_EQ(fsm.currentStateId(), UserFsm::StateId::state3);
+    EXPECT_TRUE(fsm.td.equal(0, 0, 0));
+
+    // Event 3 moves to state2 first, then event 4 goes back to state3.
+    fsm.processQueue();
+    EXPECT_EQ(fsm.currentStateId(), UserFsm::StateId::state3);
+    EXPECT_TRUE(fsm.td.equal(1, 1, 5));
+}
 } // namespace
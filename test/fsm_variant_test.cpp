@@ -0,0 +1,263 @@
+/*
+ * fsm_variant_test.cpp
+ *
+ *  Created on: 16 okt. 2026
+ *      Author: mikaelr
+ */
+
+#include "StateChart.h"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace
+{ // Make sure no other names interfere with testing.
+
+// Count the live objects of a type.
+struct Tracked
+{
+    static int alive;
+    Tracked()
+    {
+        alive++;
+    }
+    Tracked(const Tracked&)
+    {
+        alive++;
+    }
+    ~Tracked()
+    {
+        alive--;
+    }
+};
+int Tracked::alive = 0;
+
+TEST(EventVariant, alternatives)
+{
+    using Ev = EventVariant<char, double, std::string>;
+    static_assert(Ev::size == 3, "");
+    static_assert(sizeof(EventVariant<char, double>) == 2 * sizeof(double),
+                  "");
+
+    Ev ev = 2.5;
+    EXPECT_EQ(ev.index(), 1);
+    EXPECT_TRUE(ev.holds<double>());
+    EXPECT_EQ(ev.get<double>(), 2.5);
+
+    ev = std::string("text");
+    EXPECT_EQ(ev.index(), 2);
+    Ev moved(std::move(ev));
+    EXPECT_EQ(moved.get<std::string>(), "text");
+    Ev copied(moved);
+    EXPECT_EQ(copied.get<std::string>(), "text");
+    EXPECT_EQ(moved.get<std::string>(), "text");
+}
+
+TEST(EventVariant, destroys_alternative)
+{
+    {
+        EventVariant<int, Tracked> ev = Tracked();
+        EventVariant<int, Tracked> copy(ev);
+        EXPECT_EQ(Tracked::alive, 2);
+        copy = 1;
+        EXPECT_EQ(Tracked::alive, 1);
+    }
+    EXPECT_EQ(Tracked::alive, 0);
+}
+
+// A move that may throw.
+struct ThrowingMove
+{
+    ThrowingMove() = default;
+    ThrowingMove(const ThrowingMove&) = default;
+    ThrowingMove(ThrowingMove&&) noexcept(false) {}
+};
+
+// Move is noexcept if all alternatives move without throwing, so a vector
+// of variants moves them when it grows.
+static_assert(
+    std::is_nothrow_move_constructible<EventVariant<int, std::string>>::value,
+    "");
+static_assert(
+    !std::is_nothrow_move_constructible<EventVariant<int, ThrowingMove>>::value,
+    "");
+
+// Copy only with copyable alternatives.
+using MoveOnlyEv = EventVariant<int, std::unique_ptr<int>>;
+static_assert(!std::is_copy_constructible<MoveOnlyEv>::value, "");
+static_assert(!std::is_copy_assignable<MoveOnlyEv>::value, "");
+static_assert(std::is_move_assignable<MoveOnlyEv>::value, "");
+static_assert(std::is_copy_constructible<EventVariant<int, Tracked>>::value,
+              "");
+
+TEST(EventVariant, move_only)
+{
+    std::vector<MoveOnlyEv> events;
+    for (int i = 0; i < 20; i++)
+        events.emplace_back(std::unique_ptr<int>(new int(i)));
+    events.emplace_back(1);
+    EXPECT_EQ(*events[19].get<std::unique_ptr<int>>(), 19);
+
+    MoveOnlyEv moved = std::move(events[0]);
+    EXPECT_EQ(*moved.get<std::unique_ptr<int>>(), 0);
+    moved = std::move(events[20]);
+    EXPECT_EQ(moved.get<int>(), 1);
+}
+
+#ifndef STATECHART_NO_EXCEPTIONS
+// A copy that throws when asked to.
+struct ThrowingCopy
+{
+    explicit ThrowingCopy(bool fail) : fail(fail) {}
+    ThrowingCopy(const ThrowingCopy& other) : fail(other.fail)
+    {
+        if (fail)
+            throw std::runtime_error("copy");
+    }
+    bool fail;
+};
+
+TEST(EventVariant, throwing_copy_assignment)
+{
+    using Ev = EventVariant<std::string, ThrowingCopy>;
+    Ev ev = std::string("kept");
+    Ev failing = ThrowingCopy(false);
+    failing.get<ThrowingCopy>().fail = true;
+    EXPECT_THROW(ev = failing, std::runtime_error);
+    EXPECT_EQ(ev.get<std::string>(), "kept");
+}
+#endif
+
+/**
+ * An editor taking key presses, pointer moves and text. 'Insert' handles
+ * presses and text, its parent 'Edit' takes all events.
+ */
+struct Press
+{
+    int key;
+};
+
+struct Move
+{
+    int x;
+    int y;
+};
+
+struct Text
+{
+    std::string text;
+};
+
+class EditorFsm;
+
+struct EditorDesc
+{
+    enum class StateId
+    {
+        edit,
+        insert,
+        stateIdNo // Keep this last. Gives the number of states.
+    };
+    using Event = EventVariant<Press, Move, Text>;
+    using Fsm = EditorFsm;
+    static void setupStates(FsmSetup<EditorDesc>& sc);
+};
+
+class EditorFsm : public FsmBase<EditorDesc>
+{
+  public:
+    std::string log;
+};
+
+using StateId = EditorDesc::StateId;
+
+class Edit : public StateBase<EditorDesc, StateId::edit>
+{
+  public:
+    explicit Edit(StateArgs& args) : StateBase(args) {}
+
+    // All alternatives not handled below.
+    bool event(const EditorDesc::Event& ev)
+    {
+        fsm().log += "e" + std::to_string(ev.index());
+        return true;
+    }
+};
+
+class Insert : public StateBase<EditorDesc, StateId::insert>
+{
+  public:
+    explicit Insert(StateArgs& args) : StateBase(args) {}
+
+    bool on(const Press& press)
+    {
+        fsm().log += "p" + std::to_string(press.key);
+        if (press.key == 0)
+        {
+            // Posted from the handler, so queued.
+            fsm().postEvent(Text{"queued"});
+        }
+        return press.key != 1;
+    }
+
+    bool on(const Text& text)
+    {
+        fsm().log += "t" + text.text;
+        return true;
+    }
+};
+
+void
+EditorDesc::setupStates(FsmSetup<EditorDesc>& sc)
+{
+    sc.addState<Edit>();
+    sc.addState<Insert, Edit>();
+}
+
+// The variant index is the event id, and the 'on' overloads give the
+// events passed to each state.
+static_assert(FsmEventIds<EditorDesc>::eventIdNo == 3, "");
+static_assert(StateEventMask<EditorDesc, Insert>::mask.handled[0], "");
+static_assert(!StateEventMask<EditorDesc, Insert>::mask.handled[1], "");
+static_assert(StateEventMask<EditorDesc, Insert>::mask.handled[2], "");
+static_assert(StateEventMask<EditorDesc, Edit>::mask.handled[1], "");
+
+// The alternatives take priority over ids from the description.
+struct BothIdsDesc : EditorDesc
+{
+    static const constexpr int eventIdNo = 8;
+    static int eventId(const Event&)
+    {
+        return 7;
+    }
+};
+static_assert(FsmEventIds<BothIdsDesc>::eventIdNo == 3, "");
+
+TEST(VariantEvents, typed_handlers)
+{
+    EditorFsm fsm;
+    fsm.setStartState(StateId::insert);
+
+    fsm.postEvent(Press{5});
+    EXPECT_EQ(fsm.log, "p5");
+
+    // No 'on' for Move, goes straight to the parent.
+    fsm.log.clear();
+    fsm.postEvent(Move{1, 2});
+    EXPECT_EQ(fsm.log, "e1");
+
+    // Not consumed, bubbles.
+    fsm.log.clear();
+    fsm.postEvent(Press{1});
+    EXPECT_EQ(fsm.log, "p1e0");
+
+    fsm.log.clear();
+    fsm.postEvent(Press{0});
+    EXPECT_EQ(fsm.log, "p0tqueued");
+}
+} // namespace
@@ -0,0 +1,71 @@
+/*
+ * ring_queue_test.cpp
+ *
+ *  Created on: 15 okt. 2026
+ *      Author: mikaelr
+ */
+
+#include "RingQueue.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+TEST(RingQueue, wrap_around)
+{
+    RingQueue<int> q(4);
+    EXPECT_TRUE(q.empty());
+    EXPECT_EQ(q.capacity(), 4u);
+
+    // Keep 3 elements in flight for a while. No growth needed.
+    int next = 0;
+    int expected = 0;
+    for (int i = 0; i < 3; i++)
+        q.push(next++);
+    for (int i = 0; i < 100; i++)
+    {
+        EXPECT_EQ(q.front(), expected++);
+        q.pop();
+        q.push(next++);
+    }
+    EXPECT_EQ(q.size(), 3u);
+    EXPECT_EQ(q.capacity(), 4u);
+}
+
+TEST(RingQueue, growth_from_buffer)
+{
+    typename std::aligned_storage<sizeof(std::string),
+                                  alignof(std::string)>::type buffer[4];
+    RingQueue<std::string> q(reinterpret_cast<std::string*>(buffer), 3);
+    EXPECT_EQ(q.capacity(), 4u);
+
+    // Start in the middle of the buffer to test growth of a wrapped queue.
+    q.push("a");
+    q.push("b");
+    q.pop();
+    q.pop();
+    for (int i = 0; i < 10; i++)
+        q.push(std::string(20, char('a' + i)));
+
+    EXPECT_EQ(q.size(), 10u);
+    EXPECT_EQ(q.capacity(), 16u);
+    for (int i = 0; i < 10; i++)
+    {
+        EXPECT_EQ(q.front(), std::string(20, char('a' + i)));
+        q.pop();
+    }
+    EXPECT_TRUE(q.empty());
+
+    // Remaining elements are destroyed with the queue.
+    q.push("left");
+}
+
+TEST(RingQueue, empty_start)
+{
+    RingQueue<int> q;
+    EXPECT_EQ(q.capacity(), 0u);
+    q.push(1);
+    EXPECT_EQ(q.front(), 1);
+    EXPECT_EQ(RingQueue<int>::bufferBytes(5), 8 * sizeof(int));
+    EXPECT_EQ(RingQueue<int>::bufferBytes(0), 0u);
+}
@@ -0,0 +1,237 @@
+/*
+ * shard_runtime_test.cpp
+ *
+ *  Created on: 15 okt. 2026
+ *      Author: mikaelr
+ */
+
+#include "ShardRuntime.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace
+{ // Make sure no other names interfere with testing.
+
+class ShardFsm;
+class Forwarding;
+
+// 'hops' > 0 is forwarded to the next FSM, which may be on any shard.
+struct ShardEv
+{
+    int sender;
+    int seq;
+    int hops;
+};
+
+struct ShardFsmDesc
+{
+    enum class StateId
+    {
+        forwarding,
+        stateIdNo // Keep this last. Gives the number of states.
+    };
+    using Event = ShardEv;
+    using Fsm = ShardFsm;
+    using States = StateList<StateDef<Forwarding>>;
+};
+
+using Runtime = ShardRuntime<ShardEv>;
+
+const int senderNo = 3;
+
+class ShardFsm : public FsmBase<ShardFsmDesc>
+{
+  public:
+    ShardFsm()
+    {
+        setStartState(ShardFsmDesc::StateId::forwarding);
+    }
+
+    Runtime* runtime = nullptr;
+    Runtime::Address next = {0, 0};
+    int shard = 0;
+    std::atomic<int>* done = nullptr;
+
+    std::vector<int> lastSeq = std::vector<int>(senderNo, -1);
+    bool inOrder = true;
+    bool wrongShard = false;
+    int handled = 0;
+};
+
+class Forwarding
+    : public StateBase<ShardFsmDesc, ShardFsmDesc::StateId::forwarding>
+{
+  public:
+    explicit Forwarding(StateArgs& args) : StateBase(args) {}
+
+    bool event(const ShardEv& ev)
+    {
+        auto& f = fsm();
+        if (Runtime::currentShardId() != f.shard)
+            f.wrongShard = true;
+        f.handled++;
+        if (ev.hops < 0)
+        {
+            // A burst of -hops events, sent once the other shards are
+            // idle. More than a ring holds.
+            std::this_thread::sleep_for(Runtime::parkTimeout() / 2);
+            for (int seq = 0; seq < -ev.hops; seq++)
+                f.runtime->send(f.next, ShardEv{ev.sender, seq, 0});
+            return true;
+        }
+        if (ev.hops > 0)
+        {
+            f.runtime->send(f.next, ShardEv{ev.sender, ev.seq, ev.hops - 1});
+            return true;
+        }
+        if (ev.seq <= f.lastSeq[ev.sender])
+            f.inOrder = false;
+        f.lastSeq[ev.sender] = ev.seq;
+        (*f.done)++;
+        return true;
+    }
+};
+
+void
+waitFor(const std::atomic<int>& count, int expected)
+{
+    auto until = std::chrono::steady_clock::now() + std::chrono::seconds(20);
+    while (count < expected && std::chrono::steady_clock::now() < until)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+TEST(StateChartShards, ordered_delivery_across_shards)
+{
+    const int shardNo = 3;
+    const int fsmNo = 6;
+    const int eventNo = 1998; // Multiple of fsmNo.
+    std::atomic<int> done{0};
+
+    // Small rings, so senders also have to wait for space.
+    Runtime runtime(shardNo, false, 4);
+    std::vector<std::unique_ptr<ShardFsm>> fsms;
+    std::vector<Runtime::Address> addresses;
+    for (int i = 0; i < fsmNo; i++)
+    {
+        fsms.emplace_back(new ShardFsm);
+        fsms[i]->shard = i % shardNo;
+        addresses.push_back(runtime.add(i % shardNo, *fsms[i]));
+    }
+    for (int i = 0; i < fsmNo; i++)
+    {
+        fsms[i]->runtime = &runtime;
+        fsms[i]->next = addresses[(i + 1) % fsmNo];
+        fsms[i]->done = &done;
+    }
+    runtime.start();
+
+    // Every event is forwarded once, to the FSM on the next shard.
+    std::vector<std::thread> senders;
+    for (int s = 0; s < senderNo; s++)
+        senders.emplace_back([&, s] {
+            for (int seq = 0; seq < eventNo; seq++)
+                runtime.send(addresses[seq % fsmNo], ShardEv{s, seq, 1});
+        });
+    for (auto& t : senders)
+        t.join();
+
+    waitFor(done, senderNo * eventNo);
+    runtime.stop();
+
+    EXPECT_EQ(done, senderNo * eventNo);
+    for (auto& fsm : fsms)
+    {
+        EXPECT_EQ(fsm->handled, 2 * senderNo * eventNo / fsmNo);
+        EXPECT_TRUE(fsm->inOrder);
+        EXPECT_FALSE(fsm->wrongShard);
+    }
+}
+
+TEST(StateChartShards, same_shard_forwarding)
+{
+    std::atomic<int> done{0};
+    Runtime runtime(1, false);
+    ShardFsm a;
+    ShardFsm b;
+    auto addrA = runtime.add(0, a);
+    auto addrB = runtime.add(0, b);
+    a.runtime = b.runtime = &runtime;
+    a.next = addrB;
+    b.next = addrA;
+    a.done = b.done = &done;
+    runtime.start();
+
+    runtime.send(addrA, ShardEv{0, 0, 101});
+    waitFor(done, 1);
+    runtime.stop();
+
+    EXPECT_EQ(done, 1);
+    EXPECT_EQ(a.handled, 51);
+    EXPECT_EQ(b.handled, 51);
+}
+
+TEST(StateChartShards, stop_waits_for_peers)
+{
+    const int eventNo = 3000;
+    std::atomic<int> done{0};
+    Runtime runtime(2, false, 1024);
+    ShardFsm a;
+    ShardFsm b;
+    a.shard = 0;
+    b.shard = 1;
+    auto addrA = runtime.add(0, a);
+    auto addrB = runtime.add(1, b);
+    a.runtime = b.runtime = &runtime;
+    a.next = addrB;
+    a.done = b.done = &done;
+    runtime.start();
+
+    // Shard 1 is idle when the burst from shard 0 starts.
+    runtime.send(addrA, ShardEv{0, 0, -eventNo});
+    runtime.stop();
+
+    EXPECT_EQ(done, eventNo);
+    EXPECT_EQ(b.handled, eventNo);
+    EXPECT_TRUE(b.inOrder);
+}
+
+TEST(StateChartShards, idle_shards_park)
+{
+    using Clock = std::chrono::steady_clock;
+    std::atomic<int> done{0};
+    Runtime runtime(2, false);
+    ShardFsm a;
+    ShardFsm b;
+    a.shard = 0;
+    b.shard = 1;
+    auto addrA = runtime.add(0, a);
+    auto addrB = runtime.add(1, b);
+    a.runtime = b.runtime = &runtime;
+    a.next = addrB;
+    a.done = b.done = &done;
+    runtime.start();
+
+    // Spinning shards would use about all of the time.
+    const std::clock_t cpuStart = std::clock();
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    const double cpuMs = 1000.0 * (std::clock() - cpuStart) / CLOCKS_PER_SEC;
+    EXPECT_LT(cpuMs, 100.0);
+
+    // Both shards are parked, and woken by the sends, not the timeout.
+    const auto sent = Clock::now();
+    runtime.send(addrA, ShardEv{0, 0, 1});
+    waitFor(done, 1);
+    EXPECT_LT(Clock::now() - sent, Runtime::parkTimeout() / 2);
+    runtime.stop();
+
+    EXPECT_EQ(done, 1);
+    EXPECT_EQ(b.handled, 1);
+}
+} // namespace
@@ -0,0 +1,390 @@
+/*
+ * timer_wheel_test.cpp
+ *
+ *  Created on: 15 okt. 2026
+ *      Author: mikaelr
+ */
+
+#include "StateChart.h"
+#include "TimerWheel.h"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <vector>
+
+namespace
+{ // Make sure no other names interfere with testing.
+
+// Record the tick each timer fires at.
+struct TestTimer : public TimerWheel::Timer
+{
+    TestTimer(TimerWheel& wheel, std::vector<TimerWheel::Tick>& fired)
+        : Timer(&TestTimer::fire), wheel(wheel), fired(fired)
+    {
+    }
+
+    static void fire(Timer* timer)
+    {
+        auto self = static_cast<TestTimer*>(timer);
+        self->fired.push_back(self->wheel.now());
+    }
+
+    TimerWheel& wheel;
+    std::vector<TimerWheel::Tick>& fired;
+};
+
+TEST(TimerWheel, fires_at_expiry)
+{
+    const std::vector<TimerWheel::Tick> expiries = {
+        1, 2, 255, 256, 257, 300, 16383, 16384, 20000, 1 << 20, 5000000};
+    std::vector<TimerWheel::Tick> fired;
+    TimerWheel wheel(100);
+    std::vector<std::unique_ptr<TestTimer>> timers;
+    for (auto e : expiries)
+    {
+        timers.emplace_back(new TestTimer(wheel, fired));
+        wheel.arm(*timers.back(), 100 + e);
+    }
+    EXPECT_EQ(wheel.size(), static_cast<int>(expiries.size()));
+
+    // Advance in uneven steps, checking the expiry bound on the way.
+    TimerWheel::Tick now = 100;
+    while (wheel.size() > 0)
+    {
+        auto next = wheel.nextExpiry();
+        ASSERT_GT(next, now);
+        for (size_t i = 0; i < expiries.size(); i++)
+        {
+            if (timers[i]->armed())
+            {
+                EXPECT_LE(next, 100 + expiries[i]);
+            }
+        }
+        now = next + now % 3;
+        wheel.advance(now);
+    }
+
+    ASSERT_EQ(fired.size(), expiries.size());
+    for (size_t i = 0; i < expiries.size(); i++)
+        EXPECT_EQ(fired[i], 100 + expiries[i]);
+    EXPECT_EQ(wheel.nextExpiry(), TimerWheel::never);
+}
+
+TEST(TimerWheel, cancel)
+{
+    std::vector<TimerWheel::Tick> fired;
+    TimerWheel wheel;
+    TestTimer a(wheel, fired);
+    TestTimer b(wheel, fired);
+    wheel.arm(a, 10);
+    wheel.arm(b, 1000);
+    {
+        TestTimer c(wheel, fired);
+        wheel.arm(c, 10);
+    } // Cancelled by the destructor.
+    a.cancel();
+    EXPECT_FALSE(a.armed());
+    EXPECT_EQ(wheel.size(), 1);
+
+    // Rearm replaces the earlier arm.
+    wheel.arm(b, 20);
+    wheel.advance(2000);
+    EXPECT_EQ(fired, (std::vector<TimerWheel::Tick>{20}));
+}
+
+/**
+ * A state arming a timeout in its constructor. The timeout is cancelled
+ * when the state is exited.
+ */
+class TimeoutFsm;
+class Waiting;
+class Done;
+
+enum class TimeoutEv
+{
+    timeout,
+    leave,
+};
+
+struct TimeoutDesc
+{
+    enum class StateId
+    {
+        waiting,
+        done,
+        stateIdNo // Keep this last. Gives the number of states.
+    };
+    using Event = TimeoutEv;
+    using Fsm = TimeoutFsm;
+    using States = StateList<StateDef<Waiting>, StateDef<Done>>;
+};
+
+class TimeoutFsm : public FsmBase<TimeoutDesc>
+{
+  public:
+    TimerService timers;
+    int timeouts = 0;
+};
+
+class Waiting : public StateBase<TimeoutDesc, TimeoutDesc::StateId::waiting>
+{
+  public:
+    explicit Waiting(StateArgs& args)
+        : StateBase(args),
+          m_timeout(fsm().timers, fsm(), std::chrono::milliseconds(100),
+                    TimeoutEv::timeout)
+    {
+    }
+
+    bool event(TimeoutEv ev)
+    {
+        if (ev == TimeoutEv::timeout)
+            fsm().timeouts++;
+        transition<Done>();
+        return true;
+    }
+
+    FsmTimeout<TimeoutFsm> m_timeout;
+};
+
+class Done : public StateBase<TimeoutDesc, TimeoutDesc::StateId::done>
+{
+  public:
+    explicit Done(StateArgs& args) : StateBase(args) {}
+    bool event(TimeoutEv)
+    {
+        transition<Waiting>();
+        return true;
+    }
+};
+
+TEST(TimerWheel, state_timeout)
+{
+    using namespace std::chrono;
+    TimeoutFsm fsm;
+    fsm.setStartState(TimeoutDesc::StateId::waiting);
+    EXPECT_EQ(fsm.timers.wheel().size(), 1);
+    EXPECT_LE(fsm.timers.timeUntilNext(), milliseconds(101));
+
+    // Not yet expired.
+    fsm.timers.advance(TimerService::Clock::now() + milliseconds(50));
+    EXPECT_EQ(fsm.timeouts, 0);
+
+    // Expires, posting the event which exits the state.
+    fsm.timers.advance(TimerService::Clock::now() + milliseconds(110));
+    EXPECT_EQ(fsm.timeouts, 1);
+    EXPECT_EQ(fsm.currentStateId(), TimeoutDesc::StateId::done);
+    EXPECT_EQ(fsm.timers.wheel().size(), 0);
+    EXPECT_EQ(fsm.timers.timeUntilNext(), TimerService::Duration::max());
+
+    // Leaving before expiry cancels the timeout.
+    fsm.postEvent(TimeoutEv::leave);
+    EXPECT_EQ(fsm.timers.wheel().size(), 1);
+    fsm.postEvent(TimeoutEv::leave);
+    EXPECT_EQ(fsm.timers.wheel().size(), 0);
+    fsm.timers.advance(TimerService::Clock::now() + seconds(1));
+    EXPECT_EQ(fsm.timeouts, 1);
+}
+
+// Periodic timeouts stay in phase with the first expiry.
+class PeriodicFsm;
+class Ticking;
+
+struct PeriodicFsmDesc
+{
+    enum class StateId
+    {
+        ticking,
+        stateIdNo // Keep this last. Gives the number of states.
+    };
+    using Event = int;
+    using Fsm = PeriodicFsm;
+    using States = StateList<StateDef<Ticking>>;
+};
+
+class PeriodicFsm : public FsmBase<PeriodicFsmDesc>
+{
+  public:
+    explicit PeriodicFsm(TimerService::Clock::time_point start)
+        : timers(std::chrono::milliseconds(1), start)
+    {
+    }
+    TimerService timers;
+    int ticks = 0;
+};
+
+class Ticking
+    : public StateBase<PeriodicFsmDesc, PeriodicFsmDesc::StateId::ticking>
+{
+  public:
+    explicit Ticking(StateArgs& args)
+        : StateBase(args),
+          m_tick(fsm().timers, fsm(), std::chrono::milliseconds(10), 1,
+                 std::chrono::milliseconds(10))
+    {
+    }
+    bool event(int)
+    {
+        fsm().ticks++;
+        return true;
+    }
+    FsmTimeout<PeriodicFsm> m_tick;
+};
+
+TEST(TimerWheel, periodic_timeout)
+{
+    using namespace std::chrono;
+    auto start = TimerService::Clock::now();
+    PeriodicFsm fsm(start);
+    fsm.setStartState(PeriodicFsmDesc::StateId::ticking);
+    auto first = fsm.currentState<Ticking>()->m_tick.expiry();
+
+    fsm.timers.advance(start + milliseconds(first + 35));
+    EXPECT_EQ(fsm.ticks, 4);
+    EXPECT_EQ(fsm.currentState<Ticking>()->m_tick.expiry(), first + 40);
+}
+
+/**
+ * Timeouts owned by states through FsmTimeouts. 'Session' arms one when
+ * entered, 'Polling' arms one per 'arm' event.
+ */
+class SessionFsm;
+class Session;
+class Polling;
+class Paused;
+
+enum class SessionEv
+{
+    arm,
+    cancel,
+    pause,
+    resume,
+    pollTimeout,
+    sessionTimeout,
+};
+
+struct SessionDesc
+{
+    enum class StateId
+    {
+        session,
+        polling,
+        paused,
+        stateIdNo // Keep this last. Gives the number of states.
+    };
+    using Event = SessionEv;
+    using Fsm = SessionFsm;
+    using States = StateList<StateDef<Session>, StateDef<Polling, Session>,
+                             StateDef<Paused, Session>>;
+};
+
+class SessionFsm : public FsmBase<SessionDesc>
+{
+  public:
+    TimerService timers;
+    FsmTimeouts<SessionFsm> timeouts{timers, *this};
+    int pollTimeouts = 0;
+    int sessionTimeouts = 0;
+};
+
+class Session : public StateBase<SessionDesc, SessionDesc::StateId::session>
+{
+  public:
+    explicit Session(StateArgs& args) : StateBase(args)
+    {
+        fsm().timeouts.start(*this, std::chrono::milliseconds(200),
+                             SessionEv::sessionTimeout);
+    }
+    bool event(SessionEv ev)
+    {
+        if (ev == SessionEv::pollTimeout)
+            fsm().pollTimeouts++;
+        else if (ev == SessionEv::sessionTimeout)
+            fsm().sessionTimeouts++;
+        return true;
+    }
+};
+
+class Polling : public StateBase<SessionDesc, SessionDesc::StateId::polling>
+{
+  public:
+    explicit Polling(StateArgs& args) : StateBase(args) {}
+    bool event(SessionEv ev)
+    {
+        switch (ev)
+        {
+        case SessionEv::arm:
+            fsm().timeouts.start(*this, std::chrono::milliseconds(100),
+                                 SessionEv::pollTimeout);
+            return true;
+        case SessionEv::cancel:
+            fsm().timeouts.cancel(*this);
+            return true;
+        case SessionEv::pause:
+            transition<Paused>();
+            return true;
+        default:
+            return false;
+        }
+    }
+};
+
+class Paused : public StateBase<SessionDesc, SessionDesc::StateId::paused>
+{
+  public:
+    explicit Paused(StateArgs& args) : StateBase(args) {}
+    bool event(SessionEv ev)
+    {
+        if (ev != SessionEv::resume)
+            return false;
+        transition<Polling>();
+        return true;
+    }
+};
+
+TEST(TimerWheel, state_owned_timeouts)
+{
+    using namespace std::chrono;
+    using Clock = TimerService::Clock;
+    SessionFsm fsm;
+    fsm.setStartState(SessionDesc::StateId::polling);
+    EXPECT_EQ(fsm.timeouts.armedNo(), 1);
+
+    // Armed in a handler, cancelled when its state is exited.
+    fsm.postEvent(SessionEv::arm);
+    EXPECT_EQ(fsm.timeouts.armedNo(), 2);
+    fsm.postEvent(SessionEv::pause);
+    EXPECT_EQ(fsm.timeouts.armedNo(), 1);
+    EXPECT_EQ(fsm.timers.wheel().size(), 1);
+    fsm.timers.advance(Clock::now() + milliseconds(150));
+    EXPECT_EQ(fsm.pollTimeouts, 0);
+    EXPECT_EQ(fsm.sessionTimeouts, 0);
+
+    // The timeout of the parent is kept.
+    fsm.timers.advance(Clock::now() + milliseconds(250));
+    EXPECT_EQ(fsm.pollTimeouts, 0);
+    EXPECT_EQ(fsm.sessionTimeouts, 1);
+    EXPECT_EQ(fsm.timeouts.armedNo(), 0);
+
+    // Cancelled by the state.
+    fsm.postEvent(SessionEv::resume);
+    fsm.postEvent(SessionEv::arm);
+    fsm.postEvent(SessionEv::arm);
+    EXPECT_EQ(fsm.timeouts.armedNo(), 2);
+    fsm.postEvent(SessionEv::cancel);
+    EXPECT_EQ(fsm.timeouts.armedNo(), 0);
+    EXPECT_EQ(fsm.timers.wheel().size(), 0);
+
+    // Fires while the state is active. Time has already been advanced
+    // by 250 ms.
+    fsm.postEvent(SessionEv::arm);
+    fsm.timers.advance(Clock::now() + milliseconds(400));
+    EXPECT_EQ(fsm.pollTimeouts, 1);
+    EXPECT_EQ(fsm.timeouts.armedNo(), 0);
+
+    // Left armed, cancelled when the FSM is destroyed.
+    fsm.postEvent(SessionEv::arm);
+    EXPECT_EQ(fsm.timers.wheel().size(), 1);
+}
+} // namespace